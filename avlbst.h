@@ -6,6 +6,8 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <atomic>
 #include "bst.h"
 
 struct KeyError { };
@@ -21,19 +23,21 @@ class AVLNode : public Node<Key, Value>
 public:
     // Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    template<typename... Args>
+    AVLNode(AVLNode<Key, Value>* parent, Args&&... args);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
-    // Getters for parent, left, and right. These need to be redefined since they
+    // Getters for parent, left, and right. These hide the Node versions since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
@@ -55,6 +59,17 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 
 }
 
+/**
+* Constructs the item in place from args; see the matching Node constructor.
+*/
+template<class Key, class Value>
+template<typename... Args>
+AVLNode<Key, Value>::AVLNode(AVLNode<Key, Value>* parent, Args&&... args) :
+    Node<Key, Value>(parent, std::forward<Args>(args)...), balance_(0)
+{
+
+}
+
 /**
 * A destructor which does nothing.
 */
@@ -92,8 +107,8 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the parent which hides Node::getParent, since a static_cast is necessary
+* to make sure that our node is a AVLNode.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
@@ -102,7 +117,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
@@ -111,7 +126,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
@@ -127,72 +142,308 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = NodePool>
+class AVLTree : public BinarySearchTree<Key, Value, Compare, Alloc>
 {
 public:
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    template<typename Iter>
+    AVLTree(Iter first, Iter last, const Compare& comp = Compare());
+    AVLTree(const AVLTree& other);
+    AVLTree(AVLTree&& other);
+    virtual ~AVLTree();
+    AVLTree& operator=(const AVLTree& other);
+    AVLTree& operator=(AVLTree&& other);
+    template<typename Iter>
+    void assign(Iter first, Iter last);
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    using BinarySearchTree<Key, Value, Compare, Alloc>::insert;
     virtual void remove(const Key& key);  // TODO
+    void split(const Key& key, AVLTree& greater);
+    void join(AVLTree& greater);
+    template<typename Pool, typename Iter>
+    void parallel_assign(Pool& pool, Iter first, Iter last);
+    template<typename Pool, typename F>
+    void parallel_for_each(Pool& pool, F f) const;
+    template<typename Pool, typename T, typename Map, typename Combine>
+    T parallel_reduce(Pool& pool, T identity, Map map, Combine combine) const;
+    template<typename Pool>
+    void set_union(Pool& pool, AVLTree& other);
+    template<typename Pool>
+    void set_intersection(Pool& pool, AVLTree& other);
+    template<typename Pool>
+    void set_difference(Pool& pool, AVLTree& other);
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
     // Add helper functions here
     void leftRotate(AVLNode<Key, Value>* node);
     void rightRotate(AVLNode<Key, Value>* node);
-    int getHeight(AVLNode<Key, Value>* node);
     void insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node);
     void removeFix(AVLNode<Key, Value>* node, int diff);
+    void unlinkNode(AVLNode<Key, Value>* node);
+    AVLNode<Key, Value>* rotateUnbalanced(AVLNode<Key, Value>* node, bool& shorter);
+    static int heightFromBalance(AVLNode<Key, Value>* node);
+    AVLNode<Key, Value>* joinAround(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* mid,
+                                    AVLNode<Key, Value>* right, int rightHeight, int& height);
+    void splitAt(AVLNode<Key, Value>* node, int height, const Key& key, AVLNode<Key, Value>*& less, int& lessHeight,
+                 AVLNode<Key, Value>*& match, AVLNode<Key, Value>*& greater, int& greaterHeight);
+    virtual Node<Key, Value>* createLeaf(Node<Key, Value>* parent, const std::pair<const Key, Value>& item);
+    virtual Node<Key, Value>* createLeaf(Node<Key, Value>* parent, std::pair<Key, Value>&& item);
+    virtual void balanceAfterInsert(Node<Key, Value>* leaf);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual Node<Key, Value>* copyNodes(const Node<Key, Value>* root);
+    virtual bool checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    template<typename Pool, typename Iter>
+    void buildParallel(Pool& pool, Iter begin, Iter first, std::size_t size, std::atomic<bool>& sorted);
+    template<typename Pool, typename F>
+    void forEachParallel(Pool& pool, Node<Key, Value>* node, F& f) const;
+    template<typename Pool, typename T, typename Map, typename Combine>
+    T reduceParallel(Pool& pool, Node<Key, Value>* node, const T& identity, Map& map, Combine& combine) const;
+
+    /**
+    * The largest piece of work the parallel operations hand to one task:
+    * items built into one subtree, or visited in one serial walk.
+    */
+    static const std::size_t parallelGrain = 16384;
+
+    enum SetOperation { setUnion, setIntersection, setDifference };
+
+    /**
+    * The detached subtrees a set operation drops, chained through their
+    * roots' parent links so each thread can collect its own and destroy
+    * them once the threads are done: the allocator is not shared safely.
+    */
+    struct DroppedNodes
+    {
+        DroppedNodes() : head(nullptr), tail(nullptr) { }
+        void add(AVLNode<Key, Value>* root)
+        {
+            if (root == nullptr) return;
+            root->setParent(nullptr);
+            if (tail == nullptr) head = root;
+            else tail->setParent(root);
+            tail = root;
+        }
+        void append(DroppedNodes& other)
+        {
+            if (other.head == nullptr) return;
+            if (tail == nullptr) head = other.head;
+            else tail->setParent(other.head);
+            tail = other.tail;
+        }
+
+        AVLNode<Key, Value>* head;
+        AVLNode<Key, Value>* tail;
+    };
+
+    template<typename Pool>
+    void setOperation(Pool& pool, AVLTree& other, SetOperation op);
+    template<typename Pool>
+    void setOperationAt(Pool& pool, SetOperation op, AVLNode<Key, Value>* a, int aHeight, AVLNode<Key, Value>* b, int bHeight,
+                        AVLNode<Key, Value>*& result, int& resultHeight, DroppedNodes& dropped);
+    void joinPair(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* right, int rightHeight,
+                  AVLNode<Key, Value>*& result, int& resultHeight);
 };
 
+/**
+* The balance callback for buildSorted and cloneTree, which records each
+* node's balance.
+*/
+struct SetBalance
+{
+    template<typename NodeType>
+    void operator()(NodeType* node, int balance) const { node->setBalance(balance); }
+    template<typename NodeType>
+    void operator()(NodeType* node, const NodeType* from) const { node->setBalance(from->getBalance()); }
+};
+
+/**
+* Default constructor for an empty AVLTree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree()
+{
+
+}
+
+/**
+* Constructs an empty AVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+
+}
+
+/**
+* Constructs the tree from the items in [first, last), in O(n) when the
+* keys are strictly increasing. See assign().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Iter>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(Iter first, Iter last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp)
+{
+    assign(first, last);
+}
+
+/**
+* Copy constructor. The other tree is cloned node by node in O(n) with
+* every balance_ carried over, so no rotations are done.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(const AVLTree& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(other.comp_)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ =
+        this->template cloneTree<AVLNode<Key, Value> >(
+            static_cast<AVLNode<Key, Value>*>(other.root_), SetBalance());
+    this->resetEnds();
+}
+
+/**
+* Move constructor. Takes over the other tree's nodes in O(1).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::AVLTree(AVLTree&& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+/**
+* Copy assignment; see BinarySearchTree::operator=.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>& AVLTree<Key, Value, Compare, Alloc>::operator=(const AVLTree& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(other);
+    return *this;
+}
+
+/**
+* Move assignment; see BinarySearchTree::operator=.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>& AVLTree<Key, Value, Compare, Alloc>::operator=(AVLTree&& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/**
+* Exchanges the contents of two AVL trees in O(1), as lhs.swap(rhs).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void swap(AVLTree<Key, Value, Compare, Alloc>& lhs, AVLTree<Key, Value, Compare, Alloc>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/**
+* Replaces the contents of the tree with the items in [first, last).
+* Strictly increasing input is built directly in perfectly balanced shape
+* with every balance_ set as the nodes are linked, so no rotations are done.
+* Anything else falls back to one insert() per item. See
+* BinarySearchTree::assign for when std::length_error is thrown.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Iter>
+void AVLTree<Key, Value, Compare, Alloc>::assign(Iter first, Iter last)
+{
+    std::size_t size = 0;
+    bool sorted = BinarySearchTree<Key, Value, Compare, Alloc>::sortedRange(first, last, size);
+    if (sorted && size > this->maxSize) throw std::length_error("AVLTree: too many items");
+    this->clear();
+    if (sorted){
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ =
+            this->template buildSorted<AVLNode<Key, Value> >(first, size, SetBalance());
+        this->resetEnds();
+    } else {
+        for (; first != last; ++first){
+            insert(*first);
+        }
+    }
+}
+
+/**
+* Clears the tree here rather than in the base destructor so that every
+* node is torn down as an AVLNode.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLTree<Key, Value, Compare, Alloc>::~AVLTree()
+{
+    this->clear();
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::insert (const std::pair<const Key, Value> &new_item)
 {
     // TODO
-    if (BinarySearchTree<Key, Value>::empty()){
-        BinarySearchTree<Key, Value>::root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-        return;
-    }
-    AVLNode<Key, Value>* currNode = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::root_);
-    while (currNode != nullptr){
-        if (new_item.first == currNode->getKey()){ /* No duplicate keys in a BST. */
-            currNode->setValue(new_item.second);
-            return;
-        } else if (new_item.first < currNode->getKey()){ /* key must go in left subtree */
-            if (currNode->getLeft() == nullptr){
-                AVLNode<Key, Value>* newLChild = new AVLNode<Key, Value>(new_item.first, new_item.second, currNode);
-                currNode->setLeft(newLChild);
-                currNode = newLChild;
-                break;
-            } else {
-                currNode = currNode->getLeft();
-            }
-        } else { /* key must go in right subtree */
-            if (currNode->getRight() == nullptr){
-                AVLNode<Key, Value>* newRChild = new AVLNode<Key, Value>(new_item.first, new_item.second, currNode);
-                currNode->setRight(newRChild);
-                currNode = newRChild;
-                break;
-            } else {
-                currNode = currNode->getRight();
-            }
-        }
-    }
-    if (currNode->getParent()->getBalance() == -1 || currNode->getParent()->getBalance() == 1) {
-        currNode->getParent()->setBalance(0);
-        return;
+    this->insertFrom(BinarySearchTree<Key, Value, Compare, Alloc>::root_, new_item);
+}
+
+/**
+* Clones a subtree as AVLNodes, keeping each balance_.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::copyNodes(const Node<Key, Value>* root)
+{
+    return this->template cloneTree<AVLNode<Key, Value> >(
+        static_cast<const AVLNode<Key, Value>*>(root), SetBalance());
+}
+
+/**
+* Creates an AVLNode for a new leaf below parent, holding a copy of item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::createLeaf(Node<Key, Value>* parent, const std::pair<const Key, Value>& item)
+{
+    return this->template createNode<AVLNode<Key, Value> >(static_cast<AVLNode<Key, Value>*>(parent), item);
+}
+
+/**
+* Creates an AVLNode for a new leaf below parent, moving item into it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::createLeaf(Node<Key, Value>* parent, std::pair<Key, Value>&& item)
+{
+    return this->template createNode<AVLNode<Key, Value> >(static_cast<AVLNode<Key, Value>*>(parent), std::move(item));
+}
+
+/**
+* Rebalances after a leaf has been linked in, so every way of inserting
+* (insert, insert_batch, emplace, try_emplace) shares the same fix-up.
+* Rotations move nodes but never change which node holds a key, so the
+* leaf stays valid for BinarySearchTree::insert_batch.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::balanceAfterInsert(Node<Key, Value>* newLeaf)
+{
+    AVLNode<Key, Value>* leaf = static_cast<AVLNode<Key, Value>*>(newLeaf);
+    // The new leaf either fills the parent's shorter side (balance returns to 0)
+    // or tips a balanced parent towards the side it was inserted on. Either way
+    // the new balance follows from the insertion direction alone.
+    AVLNode<Key, Value>* parent = leaf->getParent();
+    if (parent == nullptr) return;
+    if (parent->getBalance() == -1 || parent->getBalance() == 1) {
+        parent->setBalance(0);
     }
-    else if (currNode->getParent()->getBalance() == 0){
-        currNode->getParent()->setBalance(getHeight(currNode->getParent()->getRight()) - getHeight(currNode->getParent()->getLeft()));
-        AVLTree::insertFix(currNode->getParent(), currNode);
+    else if (parent->getBalance() == 0){
+        parent->setBalance(parent->getLeft() == leaf ? -1 : 1);
+        AVLTree::insertFix(parent, leaf);
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node)
 {
     if (parent != nullptr && parent->getParent() != nullptr){
         AVLNode<Key, Value>* grandParent = parent->getParent();
@@ -202,12 +453,12 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
             else if (grandParent->getBalance() == -1) insertFix(grandParent, parent);
             else if (grandParent->getBalance() == -2){
                 if ((grandParent->getLeft() == parent && parent->getLeft() == node) || (grandParent->getRight() == parent && parent->getRight() == node)){ // Zig-zig
-                    AVLTree<Key, Value>::rightRotate(grandParent);
+                    AVLTree<Key, Value, Compare, Alloc>::rightRotate(grandParent);
                     parent->setBalance(0);
                     grandParent->setBalance(0);
                 } else if ((grandParent->getLeft() == parent && parent->getRight() == node) || (grandParent->getRight() == parent && parent->getLeft() == node)) { // Zig-Zag
-                    AVLTree<Key, Value>::leftRotate(parent);
-                    AVLTree<Key, Value>::rightRotate(grandParent);
+                    AVLTree<Key, Value, Compare, Alloc>::leftRotate(parent);
+                    AVLTree<Key, Value, Compare, Alloc>::rightRotate(grandParent);
                     if (node->getBalance() == -1) {
                         parent->setBalance(0);
                         grandParent->setBalance(1);
@@ -229,12 +480,12 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
             else if (grandParent->getBalance() == 1) insertFix(grandParent, parent);
             else if (grandParent->getBalance() == 2){
                 if ((grandParent->getLeft() == parent && parent->getLeft() == node) || (grandParent->getRight() == parent && parent->getRight() == node)){ // Zig-zig
-                    AVLTree<Key, Value>::leftRotate(grandParent);
+                    AVLTree<Key, Value, Compare, Alloc>::leftRotate(grandParent);
                     parent->setBalance(0);
                     grandParent->setBalance(0);
                 } else if ((grandParent->getLeft() == parent && parent->getRight() == node) || (grandParent->getRight() == parent && parent->getLeft() == node)) { // Zig-Zag
-                    AVLTree<Key, Value>::rightRotate(parent);
-                    AVLTree<Key, Value>::leftRotate(grandParent);
+                    AVLTree<Key, Value, Compare, Alloc>::rightRotate(parent);
+                    AVLTree<Key, Value, Compare, Alloc>::leftRotate(grandParent);
                     if (node->getBalance() == 1) {
                         parent->setBalance(0);
                         grandParent->setBalance(-1);
@@ -259,15 +510,29 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>:: remove(const Key& key)
 {
     // TODO
-    AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::internalFind(key));
+    AVLNode<Key, Value>* nodeToRemove = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare, Alloc>::internalFind(key));
+    if (nodeToRemove != nullptr){
+        unlinkNode(nodeToRemove);
+        destroyNode(nodeToRemove);
+    }
+}
+
+/**
+* Takes a node out of the tree and rebalances, leaving the node itself
+* intact for the caller to destroy or reuse.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::unlinkNode(AVLNode<Key, Value>* nodeToRemove)
+{
     int diff = 0;
-    if (!BinarySearchTree<Key,Value>::empty() && nodeToRemove != nullptr){
+    if (!BinarySearchTree<Key, Value, Compare, Alloc>::empty() && nodeToRemove != nullptr){
+        this->updateEndsBeforeRemove(nodeToRemove);
         if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) { // Node has 2 children
-            nodeSwap(nodeToRemove, static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(nodeToRemove))); // Swap values
+            nodeSwap(nodeToRemove, static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(nodeToRemove))); // Swap values
         }
         if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() == nullptr) { // Node has left child only
             if (nodeToRemove->getParent() != nullptr){ // Node is not the root
@@ -280,7 +545,7 @@ void AVLTree<Key, Value>:: remove(const Key& key)
                     diff = -1;
                 }
             } else { // Node is the root
-                BinarySearchTree<Key,Value>::root_ = nodeToRemove->getLeft();
+                BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nodeToRemove->getLeft();
                 (nodeToRemove->getLeft())->setParent(nullptr);
             }
         } else if (nodeToRemove->getLeft() == nullptr && nodeToRemove->getRight() != nullptr) { // Node has right child only
@@ -294,13 +559,12 @@ void AVLTree<Key, Value>:: remove(const Key& key)
                     diff = -1;
                 }
             } else { // Node is the root
-                BinarySearchTree<Key,Value>::root_ = nodeToRemove->getRight();
+                BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nodeToRemove->getRight();
                 (nodeToRemove->getRight())->setParent(nullptr);
             }
         } else {
-            if (nodeToRemove == BinarySearchTree<Key,Value>::root_) {
-                delete nodeToRemove;
-                BinarySearchTree<Key,Value>::root_ = nullptr;
+            if (nodeToRemove == BinarySearchTree<Key, Value, Compare, Alloc>::root_) {
+                BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
                 return;
             } else if (nodeToRemove->getParent() != nullptr) {
                 if (nodeToRemove->getParent()->getLeft() == nodeToRemove) {
@@ -313,13 +577,13 @@ void AVLTree<Key, Value>:: remove(const Key& key)
             }
         }
         AVLNode<Key, Value>* parent = static_cast<AVLNode<Key, Value>*>(nodeToRemove->getParent());
-        delete nodeToRemove;
+        BinarySearchTree<Key, Value, Compare, Alloc>::updateSizes(parent, -1);
         AVLTree::removeFix(parent, diff);
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::removeFix(AVLNode<Key, Value>* node, int diff)
 {
     int ndiff = 0;
     if (node != nullptr){
@@ -414,8 +678,555 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
 }
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::leftRotate(AVLNode<Key, Value>* node)
+/**
+* Splits the tree at key in O(log n): keys less than key stay in this tree
+* and keys greater than or equal to it move to greater, replacing whatever
+* greater held. Nodes are relinked, never copied, and the two trees share
+* node memory from then on (see NodePool::merge).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::split(const Key& key, AVLTree& greater)
+{
+    if (&greater == this) return;
+    greater.clear();
+    greater.alloc_.merge(this->alloc_);
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare, Alloc>::root_);
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* notLess = nullptr;
+    int lessHeight = 0, notLessHeight = 0;
+    AVLNode<Key, Value>* match = nullptr;
+    splitAt(root, heightFromBalance(root), key, less, lessHeight, match, notLess, notLessHeight);
+    if (match != nullptr) notLess = joinAround(nullptr, 0, match, notLess, notLessHeight, notLessHeight);
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = less;
+    greater.root_ = notLess;
+    this->resetEnds();
+    greater.resetEnds();
+}
+
+/**
+* Moves every item of greater, whose keys must all be greater than this
+* tree's keys, onto the end of this tree in O(log n), leaving greater empty.
+* Throws std::invalid_argument if the key ranges overlap, and
+* std::length_error if the trees together hold more than max_size() items,
+* leaving both unchanged.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::join(AVLTree& greater)
+{
+    if (&greater == this || greater.empty()) return;
+    if (this->size() > this->maxSize - greater.size()) throw std::length_error("AVLTree::join: too many items");
+    if (!BinarySearchTree<Key, Value, Compare, Alloc>::empty() && !this->comp_(this->rightmost_->getKey(), greater.leftmost_->getKey())){
+        throw std::invalid_argument("AVLTree::join: key ranges overlap");
+    }
+    this->alloc_.merge(greater.alloc_);
+    Node<Key, Value>* last = greater.rightmost_;
+    if (BinarySearchTree<Key, Value, Compare, Alloc>::empty()){
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ = greater.root_;
+        this->leftmost_ = greater.leftmost_;
+        this->rightmost_ = last;
+        greater.root_ = nullptr;
+        greater.clear();
+        return;
+    }
+    AVLNode<Key, Value>* left = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare, Alloc>::root_);
+    AVLNode<Key, Value>* mid = static_cast<AVLNode<Key, Value>*>(greater.leftmost_);
+    // The smallest key of greater becomes the node joining the two trees.
+    greater.unlinkNode(mid);
+    AVLNode<Key, Value>* right = static_cast<AVLNode<Key, Value>*>(greater.root_);
+    greater.root_ = nullptr;
+    greater.clear();
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
+    int height = 0;
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ =
+        joinAround(left, heightFromBalance(left), mid, right, heightFromBalance(right), height);
+    this->rightmost_ = last;
+}
+
+/**
+* Returns the height of a subtree in O(log n) by following the taller child
+* at every level, as recorded in the balances.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+int AVLTree<Key, Value, Compare, Alloc>::heightFromBalance(AVLNode<Key, Value>* node)
+{
+    int height = 0;
+    while (node != nullptr){
+        ++height;
+        node = node->getBalance() < 0 ? node->getLeft() : node->getRight();
+    }
+    return height;
+}
+
+/**
+* Links two detached subtrees and a middle node, all keys of left < mid <
+* all keys of right, into one AVL subtree and returns its root. The taller
+* side is descended along its inner spine to a subtree at most one level
+* taller than the other side, mid is spliced in there, and balances are
+* repaired on the way back up, so the cost is O(|leftHeight - rightHeight|).
+* height receives the height of the result.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::joinAround(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* mid,
+                                                        AVLNode<Key, Value>* right, int rightHeight, int& height)
+{
+    mid->setParent(nullptr);
+    if (leftHeight <= rightHeight + 1 && rightHeight <= leftHeight + 1){
+        mid->setLeft(left);
+        mid->setRight(right);
+        if (left != nullptr) left->setParent(mid);
+        if (right != nullptr) right->setParent(mid);
+        mid->setBalance(rightHeight - leftHeight);
+        mid->setSize(BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(left) + BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(right) + 1);
+        height = std::max(leftHeight, rightHeight) + 1;
+        return mid;
+    }
+    bool leftTaller = leftHeight > rightHeight;
+    AVLNode<Key, Value>* top = leftTaller ? left : right;
+    AVLNode<Key, Value>* parent = nullptr;
+    AVLNode<Key, Value>* inner = top;
+    int innerHeight = leftTaller ? leftHeight : rightHeight;
+    int shortHeight = leftTaller ? rightHeight : leftHeight;
+    while (innerHeight > shortHeight + 1){
+        parent = inner;
+        if (leftTaller){
+            innerHeight -= inner->getBalance() >= 0 ? 1 : 2;
+            inner = inner->getRight();
+        } else {
+            innerHeight -= inner->getBalance() <= 0 ? 1 : 2;
+            inner = inner->getLeft();
+        }
+    }
+    if (leftTaller){
+        mid->setLeft(inner);
+        mid->setRight(right);
+        mid->setBalance(rightHeight - innerHeight);
+        parent->setRight(mid);
+    } else {
+        mid->setLeft(left);
+        mid->setRight(inner);
+        mid->setBalance(innerHeight - leftHeight);
+        parent->setLeft(mid);
+    }
+    if (mid->getLeft() != nullptr) mid->getLeft()->setParent(mid);
+    if (mid->getRight() != nullptr) mid->getRight()->setParent(mid);
+    mid->setParent(parent);
+    mid->setSize(BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(mid->getLeft()) + BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(mid->getRight()) + 1);
+    // Every node on the spine above mid gained the shorter side and mid.
+    BinarySearchTree<Key, Value, Compare, Alloc>::updateSizes(parent, BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(leftTaller ? right : left) + 1);
+
+    // mid's subtree is one level taller than the subtree it replaced.
+    height = std::max(leftHeight, rightHeight);
+    AVLNode<Key, Value>* child = mid;
+    while (parent != nullptr){
+        parent->updateBalance(parent->getLeft() == child ? -1 : 1);
+        if (parent->getBalance() == 0) return top;
+        if (parent->getBalance() == 2 || parent->getBalance() == -2){
+            bool shorter = false;
+            AVLNode<Key, Value>* subtree = rotateUnbalanced(parent, shorter);
+            if (parent == top) top = subtree;
+            if (shorter) return top;
+            child = subtree;
+        } else {
+            child = parent;
+        }
+        parent = child->getParent();
+    }
+    ++height;
+    return top;
+}
+
+/**
+* Recursively splits a detached subtree of the given height into detached
+* subtrees of keys less than key and keys greater than it. The node equal to
+* key, if any, is detached on its own into match, else match is set to
+* nullptr. Every level rejoins one side with joinAround, and the height
+* differences telescope, so the whole split is O(log n).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::splitAt(AVLNode<Key, Value>* node, int height, const Key& key, AVLNode<Key, Value>*& less, int& lessHeight,
+                                         AVLNode<Key, Value>*& match, AVLNode<Key, Value>*& greater, int& greaterHeight)
+{
+    if (node == nullptr){
+        less = match = greater = nullptr;
+        lessHeight = greaterHeight = 0;
+        return;
+    }
+    AVLNode<Key, Value>* left = node->getLeft();
+    AVLNode<Key, Value>* right = node->getRight();
+    int leftHeight = node->getBalance() <= 0 ? height - 1 : height - 2;
+    int rightHeight = node->getBalance() >= 0 ? height - 1 : height - 2;
+    if (left != nullptr) left->setParent(nullptr);
+    if (right != nullptr) right->setParent(nullptr);
+    if (this->comp_(node->getKey(), key)){ // node and its left subtree are all less
+        AVLNode<Key, Value>* rightLess = nullptr;
+        int rightLessHeight = 0;
+        splitAt(right, rightHeight, key, rightLess, rightLessHeight, match, greater, greaterHeight);
+        less = joinAround(left, leftHeight, node, rightLess, rightLessHeight, lessHeight);
+    } else if (this->comp_(key, node->getKey())){ // node and its right subtree are all greater
+        AVLNode<Key, Value>* leftGreater = nullptr;
+        int leftGreaterHeight = 0;
+        splitAt(left, leftHeight, key, less, lessHeight, match, leftGreater, leftGreaterHeight);
+        greater = joinAround(leftGreater, leftGreaterHeight, node, right, rightHeight, greaterHeight);
+    } else {
+        less = left;
+        lessHeight = leftHeight;
+        greater = right;
+        greaterHeight = rightHeight;
+        node->setLeft(nullptr);
+        node->setRight(nullptr);
+        match = node;
+    }
+}
+
+/**
+* Replaces the contents of the tree with the items in [first, last), as
+* assign() does, building on pool's threads when the keys are strictly
+* increasing. Iter must be random access. The range is halved until the
+* pieces are parallelGrain items or fewer. Each piece is built in perfectly
+* balanced shape into a tree of its own, and the halves are joined on the
+* way back up, so each thread allocates from its own pool and the join
+* merges the pools (see NodePool::merge). The joins cost
+* O((n / parallelGrain) log n) in all. The pieces check their own order,
+* and unsorted input falls back to assign(). More than max_size() items
+* throw std::length_error before the tree is cleared.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename Iter>
+void AVLTree<Key, Value, Compare, Alloc>::parallel_assign(Pool& pool, Iter first, Iter last)
+{
+    if (static_cast<std::size_t>(last - first) > this->maxSize) throw std::length_error("AVLTree: too many items");
+    this->clear();
+    std::atomic<bool> sorted(true);
+    buildParallel(pool, first, first, static_cast<std::size_t>(last - first), sorted);
+    if (!sorted.load()) assign(first, last);
+}
+
+/**
+* Calls f(item) once for every item, on pool's threads. The tree is cut
+* into subtrees of at most parallelGrain items, and each is walked in order
+* by a single thread, but different subtrees are visited concurrently and
+* in no particular order. f is shared by every thread, so it must be safe
+* to call concurrently. The tree must not change meanwhile.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename F>
+void AVLTree<Key, Value, Compare, Alloc>::parallel_for_each(Pool& pool, F f) const
+{
+    forEachParallel(pool, BinarySearchTree<Key, Value, Compare, Alloc>::root_, f);
+}
+
+/**
+* Returns identity combined with map(item) for every item in key order,
+* computed on pool's threads. Subtrees are reduced separately and combined
+* left to right, so combine must be associative but need not be
+* commutative, and identity must be its identity. map and combine are
+* shared by every thread and must be safe to call concurrently.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename T, typename Map, typename Combine>
+T AVLTree<Key, Value, Compare, Alloc>::parallel_reduce(Pool& pool, T identity, Map map, Combine combine) const
+{
+    return reduceParallel(pool, BinarySearchTree<Key, Value, Compare, Alloc>::root_, identity, map, combine);
+}
+
+/**
+* Builds the next size items from first into this empty tree for
+* parallel_assign(). Clears sorted, and stops building, if the items and
+* the one before them (unless first is begin) are not strictly increasing.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename Iter>
+void AVLTree<Key, Value, Compare, Alloc>::buildParallel(Pool& pool, Iter begin, Iter first, std::size_t size, std::atomic<bool>& sorted)
+{
+    if (size <= parallelGrain){
+        std::size_t count = 0;
+        Iter from = first == begin ? first : first - 1;
+        if (!BinarySearchTree<Key, Value, Compare, Alloc>::sortedRange(from, first + size, count)){
+            sorted.store(false);
+            return;
+        }
+        BinarySearchTree<Key, Value, Compare, Alloc>::root_ =
+            this->template buildSorted<AVLNode<Key, Value> >(first, size, SetBalance());
+        this->resetEnds();
+        return;
+    }
+    std::size_t leftSize = size / 2;
+    AVLTree greater(this->comp_);
+    pool.invoke([&]() { buildParallel(pool, begin, first, leftSize, sorted); },
+                [&]() { greater.buildParallel(pool, begin, first + leftSize, size - leftSize, sorted); });
+    if (sorted.load()) join(greater);
+}
+
+/**
+* Visits the subtree at node for parallel_for_each(): serially in order
+* once it is small enough, else the two children in parallel.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename F>
+void AVLTree<Key, Value, Compare, Alloc>::forEachParallel(Pool& pool, Node<Key, Value>* node, F& f) const
+{
+    if (node == nullptr) return;
+    if (node->getSize() <= parallelGrain){
+        Node<Key, Value>* current = node;
+        while (current->getLeft() != nullptr){
+            current = current->getLeft();
+        }
+        for (std::size_t i = node->getSize(); i != 0; --i){
+            f(current->getItem());
+            current = BinarySearchTree<Key, Value, Compare, Alloc>::successor(current);
+        }
+        return;
+    }
+    pool.invoke([&]() { forEachParallel(pool, node->getLeft(), f); },
+                [&]() {
+                    f(node->getItem());
+                    forEachParallel(pool, node->getRight(), f);
+                });
+}
+
+/**
+* Reduces the subtree at node for parallel_reduce(): serially in order
+* once it is small enough, else the two children in parallel, combined
+* around the node's own item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool, typename T, typename Map, typename Combine>
+T AVLTree<Key, Value, Compare, Alloc>::reduceParallel(Pool& pool, Node<Key, Value>* node, const T& identity, Map& map, Combine& combine) const
+{
+    if (node == nullptr) return identity;
+    if (node->getSize() <= parallelGrain){
+        Node<Key, Value>* current = node;
+        while (current->getLeft() != nullptr){
+            current = current->getLeft();
+        }
+        T result = identity;
+        for (std::size_t i = node->getSize(); i != 0; --i){
+            result = combine(result, map(current->getItem()));
+            current = BinarySearchTree<Key, Value, Compare, Alloc>::successor(current);
+        }
+        return result;
+    }
+    T left = identity;
+    T right = identity;
+    pool.invoke([&]() { left = reduceParallel(pool, node->getLeft(), identity, map, combine); },
+                [&]() { right = reduceParallel(pool, node->getRight(), identity, map, combine); });
+    return combine(combine(left, map(node->getItem())), right);
+}
+
+/**
+* Adds every item of other to this tree, leaving other empty. Where both
+* hold a key, other's item replaces this tree's, as if each were insert()ed.
+* Nodes are relinked, never copied, and the trees' pools are merged as in
+* join(). See setOperationAt() for the algorithm and its cost. Throws
+* std::length_error, leaving both trees unchanged, if together they hold
+* more than max_size() items, even when shared keys would keep the union
+* within it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool>
+void AVLTree<Key, Value, Compare, Alloc>::set_union(Pool& pool, AVLTree& other)
+{
+    setOperation(pool, other, setUnion);
+}
+
+/**
+* Keeps only this tree's items whose keys other also holds, leaving other
+* empty. See set_union().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool>
+void AVLTree<Key, Value, Compare, Alloc>::set_intersection(Pool& pool, AVLTree& other)
+{
+    setOperation(pool, other, setIntersection);
+}
+
+/**
+* Removes this tree's items whose keys other holds, leaving other empty.
+* See set_union().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool>
+void AVLTree<Key, Value, Compare, Alloc>::set_difference(Pool& pool, AVLTree& other)
+{
+    setOperation(pool, other, setDifference);
+}
+
+/**
+* Detaches both trees' nodes, combines them on pool's threads, and then
+* destroys the dropped nodes on the calling thread. Neither root_ is set
+* meanwhile, so the rotations the threads do never touch them.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool>
+void AVLTree<Key, Value, Compare, Alloc>::setOperation(Pool& pool, AVLTree& other, SetOperation op)
+{
+    if (&other == this){
+        if (op == setDifference) this->clear();
+        return;
+    }
+    if (op == setUnion && this->size() > this->maxSize - other.size()){
+        throw std::length_error("AVLTree::set_union: too many items");
+    }
+    this->alloc_.merge(other.alloc_);
+    AVLNode<Key, Value>* a = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare, Alloc>::root_);
+    AVLNode<Key, Value>* b = static_cast<AVLNode<Key, Value>*>(other.root_);
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = nullptr;
+    other.root_ = nullptr;
+    other.clear();
+    AVLNode<Key, Value>* result = nullptr;
+    int height = 0;
+    DroppedNodes dropped;
+    setOperationAt(pool, op, a, heightFromBalance(a), b, heightFromBalance(b), result, height, dropped);
+    BinarySearchTree<Key, Value, Compare, Alloc>::root_ = result;
+    this->resetEnds();
+    for (AVLNode<Key, Value>* root = dropped.head; root != nullptr; ){
+        AVLNode<Key, Value>* next = root->getParent();
+        this->clearTree(root);
+        root = next;
+    }
+}
+
+/**
+* Combines the detached subtrees a (this tree's) and b (other's) into the
+* detached subtree result, collecting the nodes that are not kept in
+* dropped. a's root is taken out and b is split around its key, the
+* halves on either side are combined recursively, in parallel on pool
+* above parallelGrain items, and joined back around the root, or without
+* it when it is dropped. With m items in the smaller tree and n in the
+* larger, this is O(m log(n / m + 1)) work, against O(m log n) for
+* inserting items one at a time, and O(log^2 n) depth.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pool>
+void AVLTree<Key, Value, Compare, Alloc>::setOperationAt(Pool& pool, SetOperation op, AVLNode<Key, Value>* a, int aHeight,
+                                                         AVLNode<Key, Value>* b, int bHeight,
+                                                         AVLNode<Key, Value>*& result, int& resultHeight, DroppedNodes& dropped)
+{
+    if (a == nullptr || b == nullptr){
+        bool keepA = op != setIntersection;
+        bool keepB = op == setUnion;
+        result = a != nullptr ? (keepA ? a : nullptr) : (keepB ? b : nullptr);
+        resultHeight = result == a ? aHeight : result == b ? bHeight : 0;
+        if (result != a) dropped.add(a);
+        if (result != b) dropped.add(b);
+        return;
+    }
+    bool parallel = a->getSize() + b->getSize() > parallelGrain;
+    AVLNode<Key, Value>* left = a->getLeft();
+    AVLNode<Key, Value>* right = a->getRight();
+    int leftHeight = a->getBalance() <= 0 ? aHeight - 1 : aHeight - 2;
+    int rightHeight = a->getBalance() >= 0 ? aHeight - 1 : aHeight - 2;
+    if (left != nullptr) left->setParent(nullptr);
+    if (right != nullptr) right->setParent(nullptr);
+    a->setLeft(nullptr);
+    a->setRight(nullptr);
+
+    AVLNode<Key, Value>* bLess = nullptr;
+    AVLNode<Key, Value>* match = nullptr;
+    AVLNode<Key, Value>* bGreater = nullptr;
+    int bLessHeight = 0, bGreaterHeight = 0;
+    splitAt(b, bHeight, a->getKey(), bLess, bLessHeight, match, bGreater, bGreaterHeight);
+
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* greater = nullptr;
+    int lessHeight = 0, greaterHeight = 0;
+    DroppedNodes greaterDropped;
+    auto lessPart = [&]() { setOperationAt(pool, op, left, leftHeight, bLess, bLessHeight, less, lessHeight, dropped); };
+    auto greaterPart = [&]() { setOperationAt(pool, op, right, rightHeight, bGreater, bGreaterHeight, greater, greaterHeight, greaterDropped); };
+    if (parallel){
+        pool.invoke(lessPart, greaterPart);
+    } else {
+        lessPart();
+        greaterPart();
+    }
+    dropped.append(greaterDropped);
+
+    AVLNode<Key, Value>* mid = nullptr;
+    if (op == setUnion){
+        mid = match != nullptr ? match : a;
+    } else if ((op == setIntersection) == (match != nullptr)){
+        mid = a;
+    }
+    if (a != mid) dropped.add(a);
+    if (match != nullptr && match != mid) dropped.add(match);
+    if (mid != nullptr) result = joinAround(less, lessHeight, mid, greater, greaterHeight, resultHeight);
+    else joinPair(less, lessHeight, greater, greaterHeight, result, resultHeight);
+}
+
+/**
+* Joins two detached subtrees, all keys of left < all keys of right, into
+* the detached subtree result in O(log n), splitting the smallest node off
+* right to join them around.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::joinPair(AVLNode<Key, Value>* left, int leftHeight, AVLNode<Key, Value>* right, int rightHeight,
+                                                   AVLNode<Key, Value>*& result, int& resultHeight)
+{
+    if (left == nullptr || right == nullptr){
+        result = left != nullptr ? left : right;
+        resultHeight = left != nullptr ? leftHeight : rightHeight;
+        return;
+    }
+    AVLNode<Key, Value>* min = right;
+    while (min->getLeft() != nullptr){
+        min = min->getLeft();
+    }
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* match = nullptr;
+    int lessHeight = 0;
+    splitAt(right, rightHeight, min->getKey(), less, lessHeight, match, right, rightHeight);
+    result = joinAround(left, leftHeight, match, right, rightHeight, resultHeight);
+}
+
+/**
+* Rotates a node whose balance has reached +2 or -2 and fixes the balances
+* of the nodes involved, returning the new root of the subtree. shorter is
+* set when the rotation left the subtree one level shorter than the
+* unbalanced subtree was; a single rotation over a balanced child does not.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare, Alloc>::rotateUnbalanced(AVLNode<Key, Value>* node, bool& shorter)
+{
+    if (node->getBalance() > 0){
+        AVLNode<Key, Value>* c = node->getRight();
+        if (c->getBalance() == -1){ // Zig-Zag
+            AVLNode<Key, Value>* g = c->getLeft();
+            rightRotate(c);
+            leftRotate(node);
+            node->setBalance(g->getBalance() == 1 ? -1 : 0);
+            c->setBalance(g->getBalance() == -1 ? 1 : 0);
+            g->setBalance(0);
+            shorter = true;
+            return g;
+        }
+        leftRotate(node); // Zig-zig
+        shorter = c->getBalance() == 1;
+        node->setBalance(shorter ? 0 : 1);
+        c->setBalance(shorter ? 0 : -1);
+        return c;
+    } else {
+        AVLNode<Key, Value>* c = node->getLeft();
+        if (c->getBalance() == 1){ // Zig-Zag
+            AVLNode<Key, Value>* g = c->getRight();
+            leftRotate(c);
+            rightRotate(node);
+            node->setBalance(g->getBalance() == -1 ? 1 : 0);
+            c->setBalance(g->getBalance() == 1 ? -1 : 0);
+            g->setBalance(0);
+            shorter = true;
+            return g;
+        }
+        rightRotate(node); // Zig-zig
+        shorter = c->getBalance() == -1;
+        node->setBalance(shorter ? 0 : -1);
+        c->setBalance(shorter ? 0 : 1);
+        return c;
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::leftRotate(AVLNode<Key, Value>* node)
 {
     if (node != nullptr){
         AVLNode<Key, Value>* x = node;
@@ -423,8 +1234,8 @@ void AVLTree<Key, Value>::leftRotate(AVLNode<Key, Value>* node)
 //        AVLNode<Key, Value>* a = x->getLeft();
         AVLNode<Key, Value>* b = y->getLeft();
 //        AVLNode<Key, Value>* z = y->getRight();
-        if (x == BinarySearchTree<Key, Value>::root_){
-            BinarySearchTree<Key, Value>::root_ = y;
+        if (x == BinarySearchTree<Key, Value, Compare, Alloc>::root_){
+            BinarySearchTree<Key, Value, Compare, Alloc>::root_ = y;
         }
         y->setParent(x->getParent());
         if (x->getParent() != nullptr){
@@ -438,11 +1249,13 @@ void AVLTree<Key, Value>::leftRotate(AVLNode<Key, Value>* node)
         x->setRight(b);
         x->setParent(y);
         if (b != nullptr) b->setParent(x);
+        y->setSize(x->getSize());
+        x->setSize(BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(x->getLeft()) + BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(b) + 1);
     }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rightRotate(AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::rightRotate(AVLNode<Key, Value>* node)
 {
     if (node != nullptr){
         AVLNode<Key, Value>* z = node;
@@ -450,8 +1263,8 @@ void AVLTree<Key, Value>::rightRotate(AVLNode<Key, Value>* node)
         AVLNode<Key, Value>* y = z->getLeft();
         AVLNode<Key, Value>* c = y->getRight();
 //        AVLNode<Key, Value>* x = y->getLeft();
-        if (z == BinarySearchTree<Key, Value>::root_){
-            BinarySearchTree<Key, Value>::root_ = y;
+        if (z == BinarySearchTree<Key, Value, Compare, Alloc>::root_){
+            BinarySearchTree<Key, Value, Compare, Alloc>::root_ = y;
         }
         y->setParent(z->getParent());
         if (z->getParent() != nullptr){
@@ -465,29 +1278,44 @@ void AVLTree<Key, Value>::rightRotate(AVLNode<Key, Value>* node)
         z->setLeft(c);
         z->setParent(y);
         if (c != nullptr) c->setParent(z);
+        y->setSize(z->getSize());
+        z->setSize(BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(c) + BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(z->getRight()) + 1);
     }
 }
 
-template<class Key, class Value>
-int AVLTree<Key, Value>::getHeight(AVLNode<Key, Value>* node)
+/**
+* Adds the AVL invariants to the base checks: the recorded balance_ must
+* be the true height difference, and that difference at most one.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+bool AVLTree<Key, Value, Compare, Alloc>::checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const
 {
-    if (node == nullptr){
-        return 0;
-    }
-    int rootL = getHeight(node->getLeft());
-    int rootR = getHeight(node->getRight());
-    return std::max(rootL, rootR) + 1;
+    int balance = rightHeight - leftHeight;
+    return BinarySearchTree<Key, Value, Compare, Alloc>::checkNode(node, leftHeight, rightHeight)
+        && balance >= -1 && balance <= 1
+        && static_cast<const AVLNode<Key, Value>*>(node)->getBalance() == balance;
 }
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
 }
 
+/**
+* Destroys a node made by insert() and returns its storage to the allocator.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void AVLTree<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* avlNode = static_cast<AVLNode<Key, Value>*>(node);
+    avlNode->~AVLNode();
+    this->alloc_.deallocate(avlNode, sizeof(AVLNode<Key, Value>));
+}
+
 
 #endif
@@ -0,0 +1,1220 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+#include "btree.h"
+#include "compact_avl.h"
+#include "concurrent_avl.h"
+#include "sharded_tree.h"
+#include "persistent_avl.h"
+#include "work_stealing_pool.h"
+
+using namespace std;
+
+/**
+ * Simple wall-clock timer used by every benchmark below.
+ */
+class Timer
+{
+public:
+    Timer() : start_(chrono::steady_clock::now()) { }
+    double elapsedNs() const
+    {
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start_).count();
+    }
+private:
+    chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Returns n distinct keys in random order.
+ */
+vector<uint64_t> shuffledKeys(size_t n, unsigned seed)
+{
+    vector<uint64_t> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = 2 * i + 1;
+    shuffle(keys.begin(), keys.end(), mt19937_64(seed));
+    return keys;
+}
+
+/**
+ * Measures the cost of one more insert into trees of doubling size.
+ * For an O(log n) insert, ns/op divided by log2(n) stays roughly flat.
+ */
+template<typename Tree>
+void benchInsertScaling(const string& name, int maxExp)
+{
+    const size_t probes = 4096;
+    cout << name << " insert scaling" << endl;
+    cout << setw(12) << "n" << setw(12) << "ns/op" << setw(16) << "ns/op/log2(n)" << endl;
+    for (int e = 10; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<uint64_t> keys = shuffledKeys(n + probes, e);
+        Tree tree;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        Timer timer;
+        for (size_t i = n; i < n + probes; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        double perOp = timer.elapsedNs() / probes;
+        cout << setw(12) << n << setw(12) << fixed << setprecision(1) << perOp
+             << setw(16) << setprecision(2) << perOp / e << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Compares the pooled and heap-per-node allocators on an insert / iterate /
+ * remove churn loop followed by clear().
+ */
+template<typename Alloc>
+void benchAllocator(const string& name, size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n, 7);
+    AVLTree<uint64_t, uint64_t, std::less<uint64_t>, Alloc> tree;
+    double insertNs = 0, iterateNs = 0, removeNs = 0, clearNs = 0;
+    uint64_t sum = 0;
+    for (int round = 0; round < 3; ++round) {
+        Timer insertTimer;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        insertNs += insertTimer.elapsedNs();
+        Timer iterateTimer;
+        for (typename AVLTree<uint64_t, uint64_t, std::less<uint64_t>, Alloc>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+        iterateNs += iterateTimer.elapsedNs();
+        Timer removeTimer;
+        for (size_t i = 0; i < n / 2; ++i) {
+            tree.remove(keys[i]);
+        }
+        removeNs += removeTimer.elapsedNs();
+        Timer clearTimer;
+        tree.clear();
+        clearNs += clearTimer.elapsedNs();
+    }
+    double ops = 3.0 * n;
+    cout << setw(20) << name << fixed << setprecision(1)
+         << setw(12) << insertNs / ops << setw(12) << iterateNs / ops
+         << setw(12) << removeNs / (ops / 2) << setw(12) << clearNs / 3e6
+         << "   (checksum " << sum << ")" << endl;
+}
+
+/**
+ * Times find() for random present keys and reports the node footprint.
+ */
+template<typename Tree, typename NodeType>
+void benchLookup(const string& name, int maxExp)
+{
+    const size_t probes = 1 << 20;
+    cout << name << " find(), node size " << sizeof(NodeType) << " bytes" << endl;
+    cout << setw(12) << "n" << setw(12) << "ns/find" << endl;
+    for (int e = 10; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<uint64_t> keys = shuffledKeys(n, e);
+        Tree tree;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        mt19937_64 rng(e);
+        vector<uint64_t> queries(probes);
+        for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+        uint64_t sum = 0;
+        Timer timer;
+        for (size_t i = 0; i < probes; ++i) {
+            sum += tree.find(queries[i])->second;
+        }
+        double perOp = timer.elapsedNs() / probes;
+        cout << setw(12) << n << setw(12) << fixed << setprecision(1) << perOp
+             << "   (checksum " << sum << ")" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Cold-start load of n sorted keys: assign() from the sorted range versus
+ * one insert() per key.
+ */
+template<typename Tree>
+void benchBuild(const string& name, size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for (size_t i = 0; i < n; ++i) items[i] = make_pair(2 * i + 1, i);
+    Timer assignTimer;
+    Tree built(items.begin(), items.end());
+    double assignMs = assignTimer.elapsedNs() / 1e6;
+    Timer insertTimer;
+    Tree inserted;
+    for (size_t i = 0; i < n; ++i) {
+        inserted.insert(items[i]);
+    }
+    double insertMs = insertTimer.elapsedNs() / 1e6;
+    cout << setw(20) << name << fixed << setprecision(1)
+         << setw(14) << assignMs << setw(14) << insertMs
+         << setw(10) << insertMs / assignMs << "x" << endl;
+}
+
+/**
+ * Applies batches of m random updates to an AVLTree of n keys, once with
+ * insert_batch() and once with one insert() per item.
+ */
+void benchBatch(size_t n, size_t m)
+{
+    vector<uint64_t> keys = shuffledKeys(n, 11);
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for (size_t i = 0; i < n; ++i) items[i] = make_pair(keys[i], keys[i]);
+    AVLTree<uint64_t, uint64_t> batched(items.begin(), items.end());
+    AVLTree<uint64_t, uint64_t> single(items.begin(), items.end());
+    const size_t batches = 64;
+    mt19937_64 rng(m);
+    vector<vector<pair<uint64_t, uint64_t> > > updates(batches);
+    for (size_t b = 0; b < batches; ++b) {
+        for (size_t i = 0; i < m; ++i) {
+            uint64_t key = rng() % (2 * n);
+            updates[b].push_back(make_pair(key, b));
+        }
+    }
+    Timer batchTimer;
+    for (size_t b = 0; b < batches; ++b) {
+        batched.insert_batch(updates[b].begin(), updates[b].end());
+    }
+    double batchNs = batchTimer.elapsedNs() / (batches * m);
+    Timer singleTimer;
+    for (size_t b = 0; b < batches; ++b) {
+        for (size_t i = 0; i < m; ++i) {
+            single.insert(updates[b][i]);
+        }
+    }
+    double singleNs = singleTimer.elapsedNs() / (batches * m);
+    cout << setw(12) << m << fixed << setprecision(1)
+         << setw(16) << batchNs << setw(16) << singleNs << endl;
+}
+
+/**
+ * Times split() at a random key followed by join() of the two halves, on
+ * trees of doubling size.
+ */
+void benchSplitJoin(int maxExp)
+{
+    const size_t rounds = 1000;
+    cout << "AVLTree split + join" << endl;
+    cout << setw(12) << "n" << setw(12) << "ns/pair" << endl;
+    for (int e = 10; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<pair<uint64_t, uint64_t> > items(n);
+        for (size_t i = 0; i < n; ++i) items[i] = make_pair(2 * i + 1, i);
+        AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+        AVLTree<uint64_t, uint64_t> greater;
+        mt19937_64 rng(e);
+        Timer timer;
+        for (size_t r = 0; r < rounds; ++r) {
+            tree.split(rng() % (2 * n), greater);
+            tree.join(greater);
+        }
+        cout << setw(12) << n << setw(12) << fixed << setprecision(1)
+             << timer.elapsedNs() / rounds << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Range scans over an AVLTree of n keys: lower_bound() to a random start,
+ * then width steps of operator++.
+ */
+void benchRangeScan(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for (size_t i = 0; i < n; ++i) items[i] = make_pair(2 * i + 1, i);
+    AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+    cout << "AVLTree range scan, n = " << n << endl;
+    cout << setw(12) << "width" << setw(14) << "ns/scan" << setw(14) << "ns/item" << endl;
+    mt19937_64 rng(3);
+    for (size_t width = 1; width <= 65536 && width <= n; width *= 16) {
+        const size_t scans = max<size_t>(16, (size_t(1) << 20) / width);
+        uint64_t sum = 0;
+        Timer timer;
+        for (size_t s = 0; s < scans; ++s) {
+            uint64_t lo = rng() % (2 * n);
+            AVLTree<uint64_t, uint64_t>::iterator it = tree.lower_bound(lo);
+            for (size_t i = 0; i < width && it != tree.end(); ++i, ++it) {
+                sum += it->second;
+            }
+        }
+        double perScan = timer.elapsedNs() / scans;
+        cout << setw(12) << width << fixed << setprecision(1) << setw(14) << perScan
+             << setw(14) << perScan / width << "   (checksum " << sum << ")" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Times one pass of inserting n keys with large string values into tree
+ * through the given path: 0 copies a const pair, 1 passes make_pair(k, v),
+ * 2 moves a prepared pair, 3 calls try_emplace. Prepared pairs are built
+ * before the timer starts.
+ */
+double timeValueInserts(AVLTree<uint64_t, string>& tree, const vector<uint64_t>& keys,
+                        const string& value, int path)
+{
+    size_t n = keys.size();
+    vector<pair<uint64_t, string> > items;
+    if (path == 2) {
+        items.assign(n, make_pair(uint64_t(0), value));
+        for (size_t i = 0; i < n; ++i) items[i].first = keys[i];
+    }
+    Timer timer;
+    for (size_t i = 0; i < n; ++i) {
+        if (path == 0) {
+            const pair<const uint64_t, string> item(keys[i], value);
+            tree.insert(item);
+        } else if (path == 1) {
+            tree.insert(make_pair(keys[i], value));
+        } else if (path == 2) {
+            tree.insert(std::move(items[i]));
+        } else {
+            tree.try_emplace(keys[i], value.size(), 'x');
+        }
+    }
+    return timer.elapsedNs() / n;
+}
+
+/**
+ * Loads n keys with payload-byte string values into an AVLTree through each
+ * insert path, then (except for try_emplace, which never overwrites) sends
+ * every key again to overwrite its value, reporting ns per item.
+ */
+void benchValues(size_t n, size_t payload)
+{
+    static const char* names[] = { "insert(const pair&)", "insert(make_pair(k, v))",
+                                   "insert(std::move(pair))", "try_emplace(k, args...)" };
+    vector<uint64_t> keys = shuffledKeys(n, 5);
+    const string value(payload, 'x');
+    cout << "AVLTree with " << payload << "-byte string values, n = " << n << endl;
+    cout << setw(28) << "insert path" << setw(14) << "load ns" << setw(14) << "overwrite ns" << endl;
+    for (int path = 0; path < 4; ++path) {
+        AVLTree<uint64_t, string> tree;
+        cout << setw(28) << names[path] << fixed << setprecision(1)
+             << setw(14) << timeValueInserts(tree, keys, value, path);
+        if (path < 3) cout << setw(14) << timeValueInserts(tree, keys, value, path);
+        cout << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * String-keyed lookups from const char* queries: building a std::string key
+ * for each find() on a std::less tree, versus passing the pointer straight
+ * to a tree ordered by TransparentLess. Keys share a long prefix so every
+ * comparison has to look past it, and are long enough to allocate.
+ */
+void benchStringLookup(size_t n)
+{
+    const size_t probes = 1 << 20;
+    vector<uint64_t> ids = shuffledKeys(n, 13);
+    vector<string> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = "/var/lib/service/objects/" + to_string(ids[i]);
+    AVLTree<string, uint64_t> plain;
+    AVLTree<string, uint64_t, TransparentLess> transparent;
+    for (size_t i = 0; i < n; ++i) {
+        plain.insert(make_pair(keys[i], ids[i]));
+        transparent.insert(make_pair(keys[i], ids[i]));
+    }
+    mt19937_64 rng(13);
+    vector<const char*> queries(probes);
+    for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n].c_str();
+    uint64_t sum = 0;
+    Timer plainTimer;
+    for (size_t i = 0; i < probes; ++i) {
+        sum += plain.find(string(queries[i]))->second;
+    }
+    double plainNs = plainTimer.elapsedNs() / probes;
+    Timer transparentTimer;
+    for (size_t i = 0; i < probes; ++i) {
+        sum += transparent.find(queries[i])->second;
+    }
+    double transparentNs = transparentTimer.elapsedNs() / probes;
+    cout << "AVLTree<string> find from const char*, n = " << n << endl;
+    cout << setw(28) << "find(string(key))" << setw(12) << fixed << setprecision(1) << plainNs << " ns" << endl;
+    cout << setw(28) << "TransparentLess find(key)" << setw(12) << transparentNs << " ns"
+         << "   (checksum " << sum << ")" << endl << endl;
+}
+
+/**
+ * Compares the ways of handing an AVLTree of n random keys to another
+ * owner: re-inserting every item, the copy constructor, and a move.
+ */
+void benchCopy(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n, 11);
+    AVLTree<uint64_t, uint64_t> source;
+    for (size_t i = 0; i < n; ++i) {
+        source.insert(make_pair(keys[i], uint64_t(i)));
+    }
+    Timer rebuildTimer;
+    AVLTree<uint64_t, uint64_t> rebuilt;
+    for (AVLTree<uint64_t, uint64_t>::const_iterator it = source.cbegin(); it != source.cend(); ++it) {
+        rebuilt.insert(*it);
+    }
+    double rebuildMs = rebuildTimer.elapsedNs() / 1e6;
+    Timer copyTimer;
+    AVLTree<uint64_t, uint64_t> copied(source);
+    double copyMs = copyTimer.elapsedNs() / 1e6;
+    Timer moveTimer;
+    AVLTree<uint64_t, uint64_t> moved(std::move(copied));
+    double moveUs = moveTimer.elapsedNs() / 1e3;
+    cout << "AVLTree handoff, n = " << n << endl;
+    cout << setw(14) << "rebuild ms" << setw(14) << "copy ms" << setw(14) << "move us" << endl;
+    cout << fixed << setprecision(1) << setw(14) << rebuildMs << setw(14) << copyMs
+         << setprecision(3) << setw(14) << moveUs << endl;
+    if (moved.size() != rebuilt.size()) cout << "size mismatch" << endl;
+    cout << endl;
+}
+
+/**
+ * A BinarySearchTree linked by hand into a single right spine of n nodes,
+ * the shape sorted inserts give it, built in O(n) rather than O(n^2).
+ */
+template<typename Value, typename Alloc>
+class SpineTree : public BinarySearchTree<uint64_t, Value, less<uint64_t>, Alloc>
+{
+public:
+    explicit SpineTree(size_t n)
+    {
+        Node<uint64_t, Value>* last = nullptr;
+        for (size_t i = 0; i < n; ++i) {
+            Node<uint64_t, Value>* node =
+                this->template createNode<Node<uint64_t, Value> >(last, uint64_t(i), Value());
+            node->setSize(n - i);
+            if (last == nullptr) this->root_ = node;
+            else last->setRight(node);
+            last = node;
+        }
+        this->resetEnds();
+    }
+};
+
+/**
+ * Times clear() on a fully degenerate tree of n nodes. The heap allocator
+ * and the string values both force a walk over every node; the pool with
+ * trivial values frees its blocks without one.
+ */
+template<typename Value, typename Alloc>
+void timeTeardown(const string& name, size_t n)
+{
+    SpineTree<Value, Alloc> tree(n);
+    if (tree.size() != n) cout << "size mismatch" << endl;
+    Timer clearTimer;
+    tree.clear();
+    double clearMs = clearTimer.elapsedNs() / 1e6;
+    cout << setw(28) << name << fixed << setprecision(1) << setw(12) << clearMs
+         << setprecision(2) << setw(12) << clearMs * 1e6 / n << endl;
+}
+
+/**
+ * Tears down degenerate trees of n nodes, deep enough that a recursive
+ * clear() would overflow the stack.
+ */
+void benchTeardown(size_t n)
+{
+    cout << "Degenerate BinarySearchTree teardown, n = " << n << endl;
+    cout << setw(28) << "tree" << setw(12) << "clear ms" << setw(12) << "ns/node" << endl;
+    timeTeardown<uint64_t, NodePool>("NodePool, uint64_t", n);
+    timeTeardown<uint64_t, HeapNodeAllocator>("HeapNodeAllocator, uint64_t", n);
+    timeTeardown<string, NodePool>("NodePool, string", n);
+    cout << endl;
+}
+
+/**
+ * Times find() for random present keys on an AVLTree and on its frozen
+ * snapshot, from sizes that fit in L1 up to 2^maxExp keys.
+ */
+void benchFrozen(int maxExp)
+{
+    const size_t probes = 1 << 20;
+    cout << "AVLTree find() versus freeze()->find()" << endl;
+    cout << setw(12) << "n" << setw(14) << "tree ns/find" << setw(16) << "frozen ns/find"
+         << setw(10) << "speedup" << endl;
+    for (int e = 10; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<uint64_t> keys = shuffledKeys(n, e);
+        AVLTree<uint64_t, uint64_t> tree;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        FrozenTree<uint64_t, uint64_t> frozen = tree.freeze();
+        mt19937_64 rng(e);
+        vector<uint64_t> queries(probes);
+        for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+        uint64_t treeSum = 0;
+        Timer treeTimer;
+        for (size_t i = 0; i < probes; ++i) {
+            treeSum += tree.find(queries[i])->second;
+        }
+        double treeNs = treeTimer.elapsedNs() / probes;
+        uint64_t frozenSum = 0;
+        Timer frozenTimer;
+        for (size_t i = 0; i < probes; ++i) {
+            frozenSum += frozen.find(queries[i]).value();
+        }
+        double frozenNs = frozenTimer.elapsedNs() / probes;
+        cout << setw(12) << n << fixed << setprecision(1) << setw(14) << treeNs
+             << setw(16) << frozenNs << setprecision(2) << setw(9) << treeNs / frozenNs << "x";
+        if (treeSum != frozenSum) cout << "   checksum mismatch";
+        cout << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Returns millions of lookups per second for the given total time.
+ */
+double mlookups(size_t lookups, double ns)
+{
+    return lookups * 1e3 / ns;
+}
+
+/**
+ * Times frozen.find() over all the queries, adding the values found to sum.
+ */
+template<typename Frozen>
+double timeFrozenFind(const Frozen& frozen, const vector<uint64_t>& queries, uint64_t& sum)
+{
+    Timer timer;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        sum += frozen.find(queries[i]).value();
+    }
+    return timer.elapsedNs();
+}
+
+/**
+ * Compares lookup throughput for uint64_t keys: AVLTree::find, the
+ * Eytzinger snapshot (forced by a comparator the kernels do not take),
+ * the block layout with each search kernel, and find_batch().
+ */
+void benchSimd(int maxExp)
+{
+    const size_t probes = 1 << 20;
+    typedef FrozenTree<uint64_t, uint64_t>::const_iterator Found;
+    cout << "uint64_t lookups, millions per second" << endl;
+    cout << setw(10) << "n" << setw(9) << "tree" << setw(11) << "eytzinger" << setw(10) << "portable"
+         << setw(8) << "sse2" << setw(8) << "avx2" << setw(8) << "batch" << endl;
+    for (int e = 10; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<uint64_t> keys = shuffledKeys(n, e);
+        AVLTree<uint64_t, uint64_t, TransparentLess> tree;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        FrozenTree<uint64_t, uint64_t, TransparentLess> eytzinger = tree.freeze();
+        FrozenTree<uint64_t, uint64_t> blocked(eytzinger.begin(), eytzinger.end());
+        mt19937_64 rng(e);
+        vector<uint64_t> queries(probes);
+        for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+
+        uint64_t sums[6] = { 0 };
+        Timer treeTimer;
+        for (size_t i = 0; i < probes; ++i) {
+            sums[0] += tree.find(queries[i])->second;
+        }
+        double treeNs = treeTimer.elapsedNs();
+        double eytzingerNs = timeFrozenFind(eytzinger, queries, sums[1]);
+        cout << setw(10) << n << fixed << setprecision(1) << setw(9) << mlookups(probes, treeNs)
+             << setw(11) << mlookups(probes, eytzingerNs);
+        const BlockSearchIsa isas[3] = { blockSearchPortable, blockSearchSse2, blockSearchAvx2 };
+        for (int k = 0; k < 3; ++k) {
+            int width = k == 0 ? 10 : 8;
+            if (setBlockSearchIsa(isas[k]) != isas[k]) {
+                cout << setw(width) << "-";
+                continue;
+            }
+            cout << setw(width) << mlookups(probes, timeFrozenFind(blocked, queries, sums[2 + k]));
+        }
+        vector<Found> found(probes);
+        Timer batchTimer;
+        blocked.find_batch(queries.begin(), queries.end(), found.begin());
+        for (size_t i = 0; i < probes; ++i) {
+            sums[5] += found[i].value();
+        }
+        cout << setw(8) << mlookups(probes, batchTimer.elapsedNs());
+        for (int k = 1; k < 6; ++k) {
+            if (sums[k] != sums[0] && sums[k] != 0) cout << "   checksum mismatch";
+        }
+        cout << endl;
+        setBlockSearchIsa(blockSearchAvx2);
+    }
+    cout << endl;
+}
+
+/**
+ * Times one find() per query against find_batch() over the same queries,
+ * on trees of random keys from sizes that fit in cache to 2^maxExp keys.
+ */
+template<typename Tree>
+void benchFindBatch(const string& name, int maxExp)
+{
+    const size_t probes = 1 << 20;
+    cout << name << " find() versus find_batch(), random present keys" << endl;
+    cout << setw(12) << "n" << setw(12) << "find ns" << setw(12) << "batch ns" << setw(10) << "speedup" << endl;
+    for (int e = 12; e <= maxExp; e += 2) {
+        size_t n = size_t(1) << e;
+        vector<uint64_t> keys = shuffledKeys(n, e);
+        Tree tree;
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        mt19937_64 rng(e);
+        vector<uint64_t> queries(probes);
+        for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+        uint64_t sum = 0;
+        Timer findTimer;
+        for (size_t i = 0; i < probes; ++i) {
+            sum += tree.find(queries[i])->second;
+        }
+        double findNs = findTimer.elapsedNs() / probes;
+        vector<typename Tree::iterator> found(probes);
+        Timer batchTimer;
+        tree.find_batch(queries.begin(), queries.end(), found.begin());
+        for (size_t i = 0; i < probes; ++i) {
+            sum -= found[i]->second;
+        }
+        double batchNs = batchTimer.elapsedNs() / probes;
+        cout << setw(12) << n << fixed << setprecision(1) << setw(12) << findNs << setw(12) << batchNs
+             << setw(9) << findNs / batchNs << "x   (checksum " << sum << ")" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * A NodePool that keeps a running total of the node bytes handed out by
+ * every instance, so the benchmarks can report memory per key for any tree.
+ */
+class CountingPool
+{
+public:
+    void* allocate(size_t size, size_t align)
+    {
+        liveBytes += size;
+        return pool_.allocate(size, align);
+    }
+    void deallocate(void* p, size_t size)
+    {
+        liveBytes -= size;
+        pool_.deallocate(p, size);
+    }
+    bool releasesAll() const { return pool_.releasesAll(); }
+    void release() { pool_.release(); }
+    void merge(CountingPool& other) { pool_.merge(other.pool_); }
+    void swap(CountingPool& other) { pool_.swap(other.pool_); }
+
+    static size_t liveBytes;
+
+private:
+    NodePool pool_;
+};
+
+size_t CountingPool::liveBytes = 0;
+
+/**
+ * Fills a tree with n random keys, then times random finds of present keys
+ * and range scans of 64 items from a random lower_bound(). Prints one row
+ * with the per-operation costs and the node bytes per key.
+ */
+template<typename Tree>
+void benchWide(const string& name, size_t n)
+{
+    const size_t probes = 1 << 20;
+    const size_t width = 64;
+    const size_t scans = (size_t(1) << 20) / width;
+    vector<uint64_t> keys = shuffledKeys(n, 5);
+    CountingPool::liveBytes = 0;
+    Tree tree;
+    Timer insertTimer;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double insertNs = insertTimer.elapsedNs() / n;
+    double bytesPerKey = double(CountingPool::liveBytes) / n;
+    mt19937_64 rng(n);
+    vector<uint64_t> queries(probes);
+    for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+    uint64_t sum = 0;
+    Timer findTimer;
+    for (size_t i = 0; i < probes; ++i) {
+        sum += tree.find(queries[i])->second;
+    }
+    double findNs = findTimer.elapsedNs() / probes;
+    Timer scanTimer;
+    for (size_t s = 0; s < scans; ++s) {
+        typename Tree::iterator it = tree.lower_bound(rng() % (2 * n));
+        for (size_t i = 0; i < width && it != tree.end(); ++i, ++it) {
+            sum += it->second;
+        }
+    }
+    double scanNs = scanTimer.elapsedNs() / (scans * width);
+    cout << setw(20) << name << setw(12) << n << fixed << setprecision(1)
+         << setw(12) << insertNs << setw(12) << findNs << setw(12) << scanNs
+         << setw(12) << bytesPerKey << "   (checksum " << sum << ")" << endl;
+}
+
+/**
+ * Head-to-head of the binary trees and BTree at a few fanouts on random
+ * uint64_t keys, from sizes that fit in cache up to 2^maxExp keys.
+ */
+void benchBTree(int maxExp)
+{
+    cout << "Binary trees versus BTree, random keys" << endl;
+    cout << setw(20) << "tree" << setw(12) << "n" << setw(12) << "insert ns" << setw(12) << "find ns"
+         << setw(12) << "scan ns" << setw(12) << "bytes/key" << endl;
+    for (int e = 12; e <= maxExp; e += 4) {
+        size_t n = size_t(1) << e;
+        benchWide<BinarySearchTree<uint64_t, uint64_t, less<uint64_t>, CountingPool> >("BinarySearchTree", n);
+        benchWide<AVLTree<uint64_t, uint64_t, less<uint64_t>, CountingPool> >("AVLTree", n);
+        benchWide<BTree<uint64_t, uint64_t, 8, less<uint64_t>, CountingPool> >("BTree<8>", n);
+        benchWide<BTree<uint64_t, uint64_t, 16, less<uint64_t>, CountingPool> >("BTree<16>", n);
+        benchWide<BTree<uint64_t, uint64_t, 32, less<uint64_t>, CountingPool> >("BTree<32>", n);
+        benchWide<BTree<uint64_t, uint64_t, 64, less<uint64_t>, CountingPool> >("BTree<64>", n);
+    }
+    cout << endl;
+}
+
+/**
+ * Node bytes held by a tree in the benchmarks below: whatever the counting
+ * pool handed out, or the whole node array of a CompactAVLTree, spare
+ * capacity included.
+ */
+template<typename Tree>
+size_t nodeBytes(const Tree&)
+{
+    return CountingPool::liveBytes;
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t nodeBytes(const CompactAVLTree<Key, Value, Compare>& tree)
+{
+    return tree.capacity() * sizeof(CompactAVLNode<Key, Value>);
+}
+
+/**
+ * Fills a tree with n random uint32_t keys, then times random finds of
+ * present keys and a full in-order walk. Prints one row with the
+ * per-operation costs and the node bytes per key.
+ */
+template<typename Tree>
+void benchNarrow(const string& name, size_t n)
+{
+    const size_t probes = 1 << 20;
+    vector<uint64_t> wide = shuffledKeys(n, 9);
+    vector<uint32_t> keys(wide.begin(), wide.end());
+    CountingPool::liveBytes = 0;
+    Tree tree;
+    Timer insertTimer;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double insertNs = insertTimer.elapsedNs() / n;
+    double bytesPerKey = double(nodeBytes(tree)) / n;
+    mt19937_64 rng(n);
+    vector<uint32_t> queries(probes);
+    for (size_t i = 0; i < probes; ++i) queries[i] = keys[rng() % n];
+    uint64_t sum = 0;
+    Timer findTimer;
+    for (size_t i = 0; i < probes; ++i) {
+        sum += tree.find(queries[i])->second;
+    }
+    double findNs = findTimer.elapsedNs() / probes;
+    Timer walkTimer;
+    for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    double walkNs = walkTimer.elapsedNs() / n;
+    cout << setw(20) << name << setw(12) << n << fixed << setprecision(1)
+         << setw(12) << insertNs << setw(12) << findNs << setw(12) << walkNs
+         << setw(12) << bytesPerKey << "   (checksum " << sum << ")" << endl;
+}
+
+/**
+ * AVLTree against CompactAVLTree on uint32_t keys and values, where the
+ * links are most of a node: 32-bit positions and a packed balance against
+ * three pointers, a subtree size and a balance byte.
+ */
+void benchCompact(int maxExp)
+{
+    cout << "AVLTree versus CompactAVLTree, random uint32_t keys" << endl;
+    cout << "sizeof AVLNode " << sizeof(AVLNode<uint32_t, uint32_t>) << ", sizeof CompactAVLNode "
+         << sizeof(CompactAVLNode<uint32_t, uint32_t>) << endl;
+    cout << setw(20) << "tree" << setw(12) << "n" << setw(12) << "insert ns" << setw(12) << "find ns"
+         << setw(12) << "walk ns" << setw(12) << "bytes/key" << endl;
+    for (int e = 12; e <= maxExp; e += 4) {
+        size_t n = size_t(1) << e;
+        benchNarrow<AVLTree<uint32_t, uint32_t, less<uint32_t>, CountingPool> >("AVLTree", n);
+        benchNarrow<CompactAVLTree<uint32_t, uint32_t> >("CompactAVLTree", n);
+    }
+    cout << endl;
+}
+
+/**
+ * An AVLTree behind one mutex: the baseline ConcurrentAVLTree replaces,
+ * with the same find/insert/remove calls.
+ */
+class LockedAVLTree
+{
+public:
+    bool find(uint64_t key, uint64_t& value) const
+    {
+        lock_guard<mutex> lock(mutex_);
+        AVLTree<uint64_t, uint64_t>::const_iterator it = tree_.find(key);
+        if (it == tree_.end()) return false;
+        value = it->second;
+        return true;
+    }
+    void insert(const pair<const uint64_t, uint64_t>& item)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.insert(item);
+    }
+    void remove(uint64_t key)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.remove(key);
+    }
+
+private:
+    mutable mutex mutex_;
+    AVLTree<uint64_t, uint64_t> tree_;
+};
+
+/**
+ * Loads a shared tree with n keys, then has threads run 2^20 operations
+ * between them on random keys in [0, 2n): readPercent of them find(), the
+ * rest an insert or a remove with equal odds, so the size stays near n.
+ * Prints the total throughput.
+ */
+template<typename Tree>
+void timeMixed(const string& name, size_t n, unsigned threads, unsigned readPercent)
+{
+    const size_t ops = size_t(1) << 20;
+    Tree tree;
+    vector<uint64_t> keys = shuffledKeys(n, 11);
+    for (size_t i = 0; i < n; ++i) tree.insert(make_pair(keys[i], keys[i]));
+    atomic<unsigned> ready(0);
+    atomic<bool> go(false);
+    atomic<uint64_t> checksum(0);
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(thread([&, t]() {
+            mt19937_64 rng(t + 1);
+            size_t count = ops / threads + (t < ops % threads ? 1 : 0);
+            uint64_t sum = 0;
+            ++ready;
+            while (!go.load()) this_thread::yield();
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t r = rng();
+                uint64_t key = (r >> 8) % (2 * n);
+                if (r % 100 < readPercent) {
+                    uint64_t value;
+                    if (tree.find(key, value)) sum += value;
+                } else if (r & 128) {
+                    tree.insert(make_pair(key, key));
+                } else {
+                    tree.remove(key);
+                }
+            }
+            checksum += sum;
+        }));
+    }
+    while (ready.load() < threads) this_thread::yield();
+    Timer timer;
+    go = true;
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    double mops = ops / timer.elapsedNs() * 1000.0;
+    cout << setw(20) << name << setw(8) << threads << setw(8) << readPercent << fixed << setprecision(2)
+         << setw(12) << mops << "   (checksum " << checksum.load() << ")" << endl;
+}
+
+/**
+ * ConcurrentAVLTree against an AVLTree behind a global mutex, over read
+ * percentages from read-only to half writes and 1 to 64 threads.
+ */
+void benchConcurrent(int maxExp)
+{
+    size_t n = size_t(1) << (maxExp < 20 ? maxExp : 20);
+    cout << "Shared tree of " << n << " keys, " << thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(20) << "tree" << setw(8) << "threads" << setw(8) << "read %" << setw(12) << "Mops/s" << endl;
+    const unsigned mixes[] = { 100, 95, 90, 50 };
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m) {
+        for (unsigned threads = 1; threads <= 64; threads *= 2) {
+            timeMixed<LockedAVLTree>("AVLTree + mutex", n, threads, mixes[m]);
+            timeMixed<ConcurrentAVLTree<uint64_t, uint64_t> >("ConcurrentAVLTree", n, threads, mixes[m]);
+        }
+    }
+    cout << endl;
+}
+
+/**
+ * A ShardedTree with one shard per hardware thread of a large machine.
+ */
+class WideShardedTree : public ShardedTree<uint64_t, uint64_t>
+{
+public:
+    WideShardedTree() : ShardedTree<uint64_t, uint64_t>(64) { }
+};
+
+/**
+ * Write throughput of one shared tree from 1 to 64 threads: AVLTree behind
+ * a mutex, ConcurrentAVLTree, whose writers still serialize, and
+ * ShardedTree at 16 and 64 shards, whose writers only meet on a shard.
+ */
+void benchSharded(int maxExp)
+{
+    size_t n = size_t(1) << (maxExp < 20 ? maxExp : 20);
+    cout << "Writes to a shared tree of " << n << " keys, " << thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(20) << "tree" << setw(8) << "threads" << setw(8) << "read %" << setw(12) << "Mops/s" << endl;
+    const unsigned mixes[] = { 0, 50 };
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m) {
+        for (unsigned threads = 1; threads <= 64; threads *= 2) {
+            timeMixed<LockedAVLTree>("AVLTree + mutex", n, threads, mixes[m]);
+            timeMixed<ConcurrentAVLTree<uint64_t, uint64_t> >("ConcurrentAVLTree", n, threads, mixes[m]);
+            timeMixed<ShardedTree<uint64_t, uint64_t> >("ShardedTree<16>", n, threads, mixes[m]);
+            timeMixed<WideShardedTree>("ShardedTree<64>", n, threads, mixes[m]);
+        }
+    }
+    cout << endl;
+}
+
+/**
+ * The heap allocator, counting every byte handed out so a benchmark can
+ * read off how much a stretch of writes allocated.
+ */
+class CountingHeap
+{
+public:
+    void* allocate(size_t size, size_t align)
+    {
+        allocatedBytes += size;
+        return heap_.allocate(size, align);
+    }
+    void deallocate(void* p, size_t size) { heap_.deallocate(p, size); }
+    bool releasesAll() const { return heap_.releasesAll(); }
+    void release() { heap_.release(); }
+    void merge(CountingHeap& other) { heap_.merge(other.heap_); }
+    void swap(CountingHeap& other) { heap_.swap(other.heap_); }
+
+    static size_t allocatedBytes;
+
+private:
+    HeapNodeAllocator heap_;
+};
+
+size_t CountingHeap::allocatedBytes = 0;
+
+/**
+ * Times writes to a tree of n keys while a reader's snapshot is refreshed
+ * every `every` writes (never when 0), once with PersistentAVLTree and once
+ * with AVLTree copies. Each write removes a present key and inserts a new
+ * one. Prints the cost per write and the bytes allocated per write,
+ * snapshots included. The copying tree stops after 32 copies.
+ */
+void timeSnapshotWrites(size_t n, size_t every)
+{
+    const size_t writes = 1 << 16;
+    vector<uint64_t> keys = shuffledKeys(n + writes, 17);
+    PersistentAVLTree<uint64_t, uint64_t, less<uint64_t>, CountingHeap> persistent;
+    AVLTree<uint64_t, uint64_t, less<uint64_t>, CountingHeap> copied;
+    for (size_t i = 0; i < n; ++i) {
+        persistent.insert(make_pair(keys[i], keys[i]));
+        copied.insert(make_pair(keys[i], keys[i]));
+    }
+
+    PersistentAVLTree<uint64_t, uint64_t, less<uint64_t>, CountingHeap> reader;
+    CountingHeap::allocatedBytes = 0;
+    Timer persistentTimer;
+    for (size_t i = 0; i < writes; ++i) {
+        if (every != 0 && i % every == 0) reader = persistent.snapshot();
+        persistent.remove(keys[i]);
+        persistent.insert(make_pair(keys[n + i], keys[n + i]));
+    }
+    double persistentNs = persistentTimer.elapsedNs() / writes;
+    double persistentBytes = double(CountingHeap::allocatedBytes) / writes;
+
+    size_t copyWrites = every == 0 || every * 32 > writes ? writes : every * 32;
+    AVLTree<uint64_t, uint64_t, less<uint64_t>, CountingHeap> copiedReader;
+    CountingHeap::allocatedBytes = 0;
+    Timer copyTimer;
+    for (size_t i = 0; i < copyWrites; ++i) {
+        if (every != 0 && i % every == 0) copiedReader = copied;
+        copied.remove(keys[i]);
+        copied.insert(make_pair(keys[n + i], keys[n + i]));
+    }
+    double copyNs = copyTimer.elapsedNs() / copyWrites;
+    double copyBytes = double(CountingHeap::allocatedBytes) / copyWrites;
+
+    if (!persistent.isValid() || reader.size() != (every == 0 ? 0 : n) || copied.size() != n) cout << "tree mismatch" << endl;
+    if (every == 0) cout << setw(16) << "never";
+    else cout << setw(16) << every;
+    cout << fixed << setprecision(1) << setw(16) << persistentNs << setw(16) << persistentBytes
+         << setw(16) << copyNs << setw(16) << copyBytes << endl;
+}
+
+/**
+ * PersistentAVLTree snapshots against full AVLTree copies: the cost of
+ * taking one, then the cost and write amplification of writes while a
+ * reader holds a snapshot refreshed at various intervals.
+ */
+void benchPersistent(int maxExp)
+{
+    size_t n = size_t(1) << maxExp;
+    vector<uint64_t> keys = shuffledKeys(n, 13);
+    PersistentAVLTree<uint64_t, uint64_t> persistent;
+    AVLTree<uint64_t, uint64_t> tree;
+    for (size_t i = 0; i < n; ++i) {
+        persistent.insert(make_pair(keys[i], keys[i]));
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const size_t snapshots = 1 << 20;
+    size_t checksum = 0;
+    Timer snapshotTimer;
+    for (size_t i = 0; i < snapshots; ++i) {
+        PersistentAVLTree<uint64_t, uint64_t> reader = persistent.snapshot();
+        checksum += reader.size();
+    }
+    double snapshotNs = snapshotTimer.elapsedNs() / snapshots;
+    Timer copyTimer;
+    AVLTree<uint64_t, uint64_t> copied(tree);
+    double copyMs = copyTimer.elapsedNs() / 1e6;
+    checksum += copied.size();
+    cout << "Snapshots of " << n << " keys" << endl;
+    cout << setw(28) << "PersistentAVLTree snapshot" << setw(12) << fixed << setprecision(1) << snapshotNs << " ns" << endl;
+    cout << setw(28) << "AVLTree copy" << setw(12) << copyMs << " ms"
+         << "   (checksum " << checksum << ")" << endl << endl;
+
+    cout << "Writes (remove + insert) while a reader holds a snapshot, n = " << n << endl;
+    cout << setw(16) << "snapshot every" << setw(16) << "persistent ns" << setw(16) << "persistent B"
+         << setw(16) << "copy ns" << setw(16) << "copy B" << endl;
+    timeSnapshotWrites(n, 0);
+    for (size_t every = 1; every <= 65536; every *= 16) {
+        timeSnapshotWrites(n, every);
+    }
+    cout << endl;
+}
+
+/**
+ * Times building an AVLTree from n sorted keys and walking it, serially
+ * with assign() and an iterator, then with parallel_assign(),
+ * parallel_reduce() summing the values and parallel_for_each() copying
+ * each value out, on WorkStealingPools of 1 to 16 threads.
+ */
+void benchParallel(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for (size_t i = 0; i < n; ++i) {
+        items[i] = make_pair(uint64_t(i) * 2, uint64_t(i));
+    }
+    vector<uint64_t> out(n);
+    uint64_t checksum = 0;
+    {
+        Timer buildTimer;
+        AVLTree<uint64_t, uint64_t> tree(items.begin(), items.end());
+        double buildMs = buildTimer.elapsedNs() / 1e6;
+        Timer walkTimer;
+        for (AVLTree<uint64_t, uint64_t>::const_iterator it = tree.cbegin(); it != tree.cend(); ++it) {
+            checksum += it->second;
+        }
+        double walkMs = walkTimer.elapsedNs() / 1e6;
+        cout << "Parallel build and traversal of " << n << " sorted keys, "
+             << thread::hardware_concurrency() << " hardware threads" << endl;
+        cout << setw(10) << "threads" << setw(14) << "build ms" << setw(14) << "reduce ms" << setw(14) << "for_each ms" << endl;
+        cout << setw(10) << "serial" << fixed << setprecision(1) << setw(14) << buildMs << setw(14) << walkMs
+             << setw(14) << "-" << endl;
+    }
+    for (unsigned threads = 1; threads <= 16; threads *= 2) {
+        WorkStealingPool pool(threads);
+        Timer buildTimer;
+        AVLTree<uint64_t, uint64_t> tree;
+        tree.parallel_assign(pool, items.begin(), items.end());
+        double buildMs = buildTimer.elapsedNs() / 1e6;
+        Timer reduceTimer;
+        checksum += tree.parallel_reduce(pool, uint64_t(0),
+            [](const pair<const uint64_t, uint64_t>& item) { return item.second; },
+            [](uint64_t a, uint64_t b) { return a + b; });
+        double reduceMs = reduceTimer.elapsedNs() / 1e6;
+        Timer forEachTimer;
+        tree.parallel_for_each(pool, [&out](const pair<const uint64_t, uint64_t>& item) { out[item.second] = item.first; });
+        double forEachMs = forEachTimer.elapsedNs() / 1e6;
+        checksum += out[n / 2];
+        if (tree.size() != n) cout << "size mismatch" << endl;
+        cout << setw(10) << threads << fixed << setprecision(1) << setw(14) << buildMs << setw(14) << reduceMs
+             << setw(14) << forEachMs << endl;
+    }
+    cout << "(checksum " << checksum << ")" << endl << endl;
+}
+
+/**
+ * Times one set operation of an AVLTree of the items a with one of the
+ * items b, both built fresh from sorted input, on a pool of the given
+ * number of threads. Returns the time in ms and the result's size.
+ */
+double timeSetOperation(const vector<pair<uint64_t, uint64_t> >& a, const vector<pair<uint64_t, uint64_t> >& b,
+                        int op, unsigned threads, size_t& resultSize)
+{
+    WorkStealingPool pool(threads);
+    AVLTree<uint64_t, uint64_t> tree(a.begin(), a.end());
+    AVLTree<uint64_t, uint64_t> other(b.begin(), b.end());
+    Timer timer;
+    if (op == 0) tree.set_union(pool, other);
+    else if (op == 1) tree.set_intersection(pool, other);
+    else tree.set_difference(pool, other);
+    double ms = timer.elapsedNs() / 1e6;
+    resultSize = tree.size();
+    return ms;
+}
+
+/**
+ * Set operations between an AVLTree of n keys and one of m keys, about half
+ * of them shared, for m from n/1024 to n: the union by inserting each of
+ * the m items, then set_union, set_intersection and set_difference on 1 and
+ * 4 threads.
+ */
+void benchSetOps(int maxExp)
+{
+    size_t n = size_t(1) << maxExp;
+    vector<pair<uint64_t, uint64_t> > a(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = make_pair(uint64_t(i) * 2, uint64_t(i));
+    }
+    cout << "Set operations of trees of n = " << n << " and m keys, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+    cout << setw(10) << "m" << setw(10) << "threads" << setw(12) << "insert ms" << setw(12) << "union ms"
+         << setw(14) << "intersect ms" << setw(12) << "diff ms" << endl;
+    size_t checksum = 0;
+    for (size_t m = n / 1024; m <= n; m *= 32) {
+        vector<uint64_t> keys = shuffledKeys(2 * n, unsigned(m));
+        keys.resize(m);
+        sort(keys.begin(), keys.end());
+        vector<pair<uint64_t, uint64_t> > b(m);
+        for (size_t i = 0; i < m; ++i) {
+            b[i] = make_pair(keys[i], uint64_t(i));
+        }
+        AVLTree<uint64_t, uint64_t> tree(a.begin(), a.end());
+        AVLTree<uint64_t, uint64_t> other(b.begin(), b.end());
+        Timer insertTimer;
+        for (AVLTree<uint64_t, uint64_t>::const_iterator it = other.cbegin(); it != other.cend(); ++it) {
+            tree.insert(*it);
+        }
+        double insertMs = insertTimer.elapsedNs() / 1e6;
+        for (unsigned threads = 1; threads <= 4; threads *= 4) {
+            size_t unionSize = 0, intersectionSize = 0, differenceSize = 0;
+            double unionMs = timeSetOperation(a, b, 0, threads, unionSize);
+            double intersectionMs = timeSetOperation(a, b, 1, threads, intersectionSize);
+            double differenceMs = timeSetOperation(a, b, 2, threads, differenceSize);
+            if (unionSize != tree.size() || intersectionSize + differenceSize != n) cout << "size mismatch" << endl;
+            checksum += unionSize + intersectionSize;
+            cout << setw(10) << m << setw(10) << threads << fixed << setprecision(1) << setw(12) << insertMs
+                 << setw(12) << unionMs << setw(14) << intersectionMs << setw(12) << differenceMs << endl;
+        }
+    }
+    cout << "(checksum " << checksum << ")" << endl << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string which = argc > 1 ? argv[1] : "all";
+    int maxExp = argc > 2 ? atoi(argv[2]) : 20;
+
+    if (which == "all" || which == "insert") {
+        benchInsertScaling<BinarySearchTree<uint64_t, uint64_t> >("BinarySearchTree", maxExp);
+        benchInsertScaling<AVLTree<uint64_t, uint64_t> >("AVLTree", maxExp);
+    }
+    if (which == "all" || which == "lookup") {
+        benchLookup<BinarySearchTree<uint64_t, uint64_t>, Node<uint64_t, uint64_t> >("BinarySearchTree", maxExp);
+        benchLookup<AVLTree<uint64_t, uint64_t>, AVLNode<uint64_t, uint64_t> >("AVLTree", maxExp);
+    }
+    if (which == "all" || which == "alloc") {
+        size_t n = size_t(1) << maxExp;
+        cout << "AVLTree allocator churn, n = " << n << endl;
+        cout << setw(20) << "allocator" << setw(12) << "insert ns" << setw(12) << "iterate ns"
+             << setw(12) << "remove ns" << setw(12) << "clear ms" << endl;
+        benchAllocator<NodePool>("NodePool", n);
+        benchAllocator<HeapNodeAllocator>("HeapNodeAllocator", n);
+        cout << endl;
+    }
+    if (which == "all" || which == "build") {
+        size_t n = size_t(1) << maxExp;
+        cout << "Cold start from " << n << " sorted keys" << endl;
+        cout << setw(20) << "tree" << setw(14) << "assign ms" << setw(14) << "insert ms" << endl;
+        benchBuild<AVLTree<uint64_t, uint64_t> >("AVLTree", n);
+        cout << endl;
+    }
+    if (which == "all" || which == "batch") {
+        size_t n = size_t(1) << maxExp;
+        cout << "AVLTree batched updates, n = " << n << endl;
+        cout << setw(12) << "batch size" << setw(16) << "insert_batch ns" << setw(16) << "insert ns" << endl;
+        for (size_t m = 64; m <= n / 4 && m <= 65536; m *= 8) {
+            benchBatch(n, m);
+        }
+        cout << endl;
+    }
+    if (which == "all" || which == "split") {
+        benchSplitJoin(maxExp);
+    }
+    if (which == "all" || which == "range") {
+        benchRangeScan(size_t(1) << maxExp);
+    }
+    if (which == "all" || which == "strings") {
+        benchStringLookup(size_t(1) << maxExp);
+    }
+    if (which == "all" || which == "values") {
+        benchValues(size_t(1) << maxExp, 256);
+    }
+    if (which == "all" || which == "copy") {
+        benchCopy(size_t(1) << maxExp);
+    }
+    if (which == "all" || which == "frozen") {
+        benchFrozen(maxExp);
+    }
+    if (which == "all" || which == "simd") {
+        benchSimd(maxExp);
+    }
+    if (which == "all" || which == "findbatch") {
+        benchFindBatch<AVLTree<uint64_t, uint64_t> >("AVLTree", maxExp);
+        benchFindBatch<BinarySearchTree<uint64_t, uint64_t> >("BinarySearchTree", maxExp);
+    }
+    if (which == "all" || which == "btree") {
+        benchBTree(maxExp);
+    }
+    if (which == "all" || which == "compact") {
+        benchCompact(maxExp);
+    }
+    if (which == "all" || which == "concurrent") {
+        benchConcurrent(maxExp);
+    }
+    if (which == "all" || which == "sharded") {
+        benchSharded(maxExp);
+    }
+    if (which == "all" || which == "persistent") {
+        benchPersistent(maxExp);
+    }
+    if (which == "all" || which == "parallel") {
+        benchParallel(10000000);
+    }
+    if (which == "all" || which == "setops") {
+        benchSetOps(maxExp);
+    }
+    if (which == "all" || which == "teardown") {
+        benchTeardown(10000000);
+    }
+    return 0;
+}
@@ -1,10 +1,1259 @@
+#include <atomic>
+#include <cassert>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "btree.h"
+#include "compact_avl.h"
+#include "concurrent_avl.h"
+#include "sharded_tree.h"
+#include "persistent_avl.h"
+#include "work_stealing_pool.h"
 
 using namespace std;
 
+// Returns true if a tree is valid and holds exactly the items of a map in
+// the same order, walking it both forwards and backwards.
+template<typename Tree, typename Map>
+bool sameItems(const Tree& tree, const Map& expected)
+{
+    if(!tree.isValid() || tree.size() != expected.size()) return false;
+    typename Tree::const_iterator it = tree.begin();
+    for(typename Map::const_iterator next = expected.begin(); next != expected.end(); ++next, ++it) {
+        if(it == tree.end() || it->first != next->first || it->second != next->second) return false;
+    }
+    if(it != tree.end()) return false;
+    for(typename Map::const_reverse_iterator prev = expected.rbegin(); prev != expected.rend(); ++prev) {
+        if((--it)->first != prev->first) return false;
+    }
+    return true;
+}
+
+// lower_bound(), upper_bound() and equal_range() against std::map, on both
+// present and missing keys and past either end, through mutable and const
+// trees.
+template<typename Tree>
+void checkBounds()
+{
+    mt19937 rng(9);
+    Tree tree;
+    map<int,int> expected;
+    for(int i = 0; i < 3000; ++i) {
+        int key = 2 * static_cast<int>(rng() % 2000);
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    const Tree& constTree = tree;
+    for(int key = -3; key <= 4002; ++key) {
+        map<int,int>::iterator lower = expected.lower_bound(key);
+        map<int,int>::iterator upper = expected.upper_bound(key);
+        typename Tree::iterator treeLower = tree.lower_bound(key);
+        typename Tree::const_iterator constUpper = constTree.upper_bound(key);
+        assert((treeLower == tree.end()) == (lower == expected.end()));
+        assert((constUpper == constTree.end()) == (upper == expected.end()));
+        if(lower != expected.end()) assert(treeLower->first == lower->first && treeLower->second == lower->second);
+        if(upper != expected.end()) assert(constUpper->first == upper->first);
+        assert(tree.upper_bound(key) == constUpper);
+        assert(constTree.lower_bound(key) == treeLower);
+        pair<typename Tree::iterator, typename Tree::iterator> range = tree.equal_range(key);
+        pair<typename Tree::const_iterator, typename Tree::const_iterator> constRange = constTree.equal_range(key);
+        assert(range.first == treeLower && range.second == constUpper);
+        assert(constRange.first == treeLower && constRange.second == constUpper);
+        size_t count = 0;
+        for(typename Tree::iterator it = range.first; it != range.second; ++it) {
+            ++count;
+        }
+        assert(count == expected.count(key));
+    }
+}
+
+// Whether a tree iterator and a map iterator point at the same item, or are
+// both at the end.
+template<typename Tree, typename Iter, typename Map>
+bool sameItem(const Tree& tree, Iter it, const Map& expected, typename Map::const_iterator next)
+{
+    if(it == tree.end() || next == expected.end()) return it == tree.end() && next == expected.end();
+    return it->first == next->first && it->second == next->second;
+}
+
+// Lookups by const char* in a string-keyed tree under TransparentLess must
+// find what std::map finds for the same string, on present and absent keys
+// and past either end. Then trees under std::greater, whose lookups take
+// the descent for a Compare other than std::less, against std::map under
+// the same order.
+void checkTransparentLookup()
+{
+    AVLTree<string,int,TransparentLess> tree;
+    map<string,int> expected;
+    for(int i = 10; i < 90; i += 2) {
+        string key = "key" + to_string(i);
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    assert(sameItems(tree, expected));
+    const AVLTree<string,int,TransparentLess>& constTree = tree;
+    const char* probes[] = {"", "a", "key10", "key11", "key5", "key50", "key88", "key89", "key9", "zzz"};
+    for(size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i) {
+        const char* probe = probes[i];
+        string key(probe);
+        assert(sameItem(tree, tree.find(probe), expected, expected.find(key)));
+        assert(sameItem(tree, tree.lower_bound(probe), expected, expected.lower_bound(key)));
+        assert(sameItem(tree, tree.upper_bound(probe), expected, expected.upper_bound(key)));
+        assert(sameItem(tree, constTree.find(probe), expected, expected.find(key)));
+        assert(sameItem(tree, constTree.lower_bound(probe), expected, expected.lower_bound(key)));
+        assert(sameItem(tree, constTree.upper_bound(probe), expected, expected.upper_bound(key)));
+        pair<AVLTree<string,int,TransparentLess>::iterator, AVLTree<string,int,TransparentLess>::iterator> range = tree.equal_range(probe);
+        pair<map<string,int>::const_iterator, map<string,int>::const_iterator> expectedRange = expected.equal_range(key);
+        assert(sameItem(tree, range.first, expected, expectedRange.first));
+        assert(sameItem(tree, range.second, expected, expectedRange.second));
+    }
+
+    mt19937 rng(12);
+    BinarySearchTree<int,int,greater<int> > bt;
+    AVLTree<int,int,greater<int> > at;
+    map<int,int,greater<int> > descending;
+    for(int i = 0; i < 5000; ++i) {
+        int key = static_cast<int>(rng() % 1000);
+        if(rng() % 3 != 0) {
+            bt.insert(make_pair(key, i));
+            at.insert(make_pair(key, i));
+            descending[key] = i;
+        }
+        else {
+            bt.remove(key);
+            at.remove(key);
+            descending.erase(key);
+        }
+    }
+    assert(sameItems(bt, descending) && sameItems(at, descending));
+    for(int key = -1; key <= 1000; ++key) {
+        assert(sameItem(bt, bt.find(key), descending, descending.find(key)));
+        assert(sameItem(at, at.find(key), descending, descending.find(key)));
+        assert(sameItem(at, at.lower_bound(key), descending, descending.lower_bound(key)));
+        assert(sameItem(at, at.upper_bound(key), descending, descending.upper_bound(key)));
+    }
+}
+
+// Walks a tree against std::map with every kind of iterator: stepping
+// back from end(), post-increment and post-decrement, const and reverse
+// iterators, and conversions from iterator to const_iterator.
+void checkIterators()
+{
+    mt19937 rng(10);
+    AVLTree<int,int> tree;
+    map<int,int> expected;
+    assert(tree.begin() == tree.end() && tree.rbegin() == tree.rend());
+    for(int i = 0; i < 2000; ++i) {
+        int key = rng() % 5000;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    AVLTree<int,int>::iterator last = tree.end();
+    --last;
+    assert(last->first == expected.rbegin()->first);
+    AVLTree<int,int>::iterator it = tree.end();
+    assert((it--) == tree.end() && it == last);
+    it = tree.begin();
+    assert((it++) == tree.begin() && it != tree.begin());
+
+    map<int,int>::reverse_iterator prev = expected.rbegin();
+    for(AVLTree<int,int>::reverse_iterator rit = tree.rbegin(); rit != tree.rend(); ++rit, ++prev) {
+        assert(prev != expected.rend() && rit->first == prev->first && rit->second == prev->second);
+        rit->second = -rit->second;
+        prev->second = -prev->second;
+    }
+    assert(prev == expected.rend());
+
+    const AVLTree<int,int>& constTree = tree;
+    map<int,int>::const_iterator next = expected.begin();
+    for(AVLTree<int,int>::const_iterator cit = constTree.begin(); cit != constTree.end(); cit++, ++next) {
+        assert(cit->first == next->first && cit->second == next->second);
+    }
+    prev = expected.rbegin();
+    for(AVLTree<int,int>::const_reverse_iterator crit = tree.crbegin(); crit != tree.crend(); ++crit, ++prev) {
+        assert(crit->first == prev->first);
+    }
+    AVLTree<int,int>::const_iterator cit = tree.cend();
+    for(map<int,int>::reverse_iterator back = expected.rbegin(); back != expected.rend(); ++back) {
+        cit--;
+        assert(cit->first == back->first);
+    }
+    assert(cit == tree.cbegin() && tree.begin() == cit && cit == tree.begin());
+    assert(sameItems(tree, expected));
+}
+
+// A value that counts how many times it is built from an int.
+struct Tracked
+{
+    explicit Tracked(int v) : v(v) { ++made; }
+
+    int v;
+    static int made;
+};
+
+int Tracked::made = 0;
+
+ostream& operator<<(ostream& out, const Tracked& tracked)
+{
+    return out << tracked.v;
+}
+
+// emplace() and try_emplace() on new and present keys. Neither may change
+// a present key's value, and try_emplace() must not build a value for it
+// or move from its arguments.
+template<typename Tree>
+void checkEmplace()
+{
+    Tree tree;
+    pair<typename Tree::iterator, bool> result = tree.emplace(1, Tracked(10));
+    assert(result.second && result.first->first == 1 && result.first->second.v == 10);
+    result = tree.emplace(1, Tracked(11));
+    assert(!result.second && result.first->second.v == 10);
+    for(int key = 2; key < 100; ++key) {
+        int made = Tracked::made;
+        result = tree.try_emplace(key, key * 10);
+        assert(result.second && result.first->second.v == key * 10 && Tracked::made == made + 1);
+    }
+    int made = Tracked::made;
+    for(int key = 1; key < 100; ++key) {
+        result = tree.try_emplace(key, -1);
+        assert(!result.second && result.first->first == key && result.first->second.v == key * 10);
+    }
+    assert(Tracked::made == made && tree.size() == 99 && tree.isValid());
+
+    BinarySearchTree<string, string> strings;
+    string key = "key", value = "value";
+    strings.try_emplace(key, value);
+    string again = "again";
+    assert(!strings.try_emplace(std::move(key), std::move(again)).second);
+    assert(key == "key" && again == "again");
+    assert(strings.emplace(string("other"), std::move(again)).second && strings.size() == 2);
+}
+
+// find_batch() against std::map on batches of present and missing keys,
+// repeats and keys past either end, in lengths that are not a multiple of
+// the batch or of the group searched together, through mutable and const
+// trees, and on an empty tree.
+template<typename Tree>
+void checkFindBatch()
+{
+    mt19937 rng(19);
+    Tree tree;
+    map<int,int> expected;
+    vector<int> probes;
+    vector<typename Tree::iterator> found;
+    tree.find_batch(probes.begin(), probes.end(), back_inserter(found));
+    assert(found.empty());
+    probes.push_back(5);
+    tree.find_batch(probes.begin(), probes.end(), back_inserter(found));
+    assert(found.size() == 1 && found[0] == tree.end());
+    for(int i = 0; i < 4000; ++i) {
+        int key = 2 * static_cast<int>(rng() % 5000);
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    size_t lengths[] = {1, 15, 17, 256, 257, 1000};
+    for(size_t n = 0; n < sizeof(lengths) / sizeof(lengths[0]); ++n) {
+        probes.clear();
+        for(size_t i = 0; i < lengths[n]; ++i) probes.push_back(static_cast<int>(rng() % 10004) - 2);
+        found.clear();
+        tree.find_batch(probes.begin(), probes.end(), back_inserter(found));
+        vector<typename Tree::const_iterator> constFound;
+        const Tree& constTree = tree;
+        constTree.find_batch(probes.begin(), probes.end(), back_inserter(constFound));
+        assert(found.size() == probes.size() && constFound.size() == probes.size());
+        for(size_t i = 0; i < probes.size(); ++i) {
+            map<int,int>::const_iterator it = expected.find(probes[i]);
+            if(it == expected.end()) {
+                assert(found[i] == tree.end() && constFound[i] == constTree.end());
+            }
+            else {
+                assert(found[i]->first == it->first && found[i]->second == it->second);
+                assert(constFound[i] == typename Tree::const_iterator(found[i]));
+            }
+        }
+    }
+}
+
+// Copies, moves and swaps against std::map. A copy must be independent of
+// its source, a moved-from tree must be empty and usable, and swap() must
+// keep iterators pointing at the same items.
+template<typename Tree>
+void checkCopyMoveSwap()
+{
+    mt19937 rng(11);
+    Tree tree;
+    map<int,int> expected;
+    for(int i = 0; i < 3000; ++i) {
+        int key = rng() % 4000;
+        tree.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    Tree copy(tree);
+    Tree assigned;
+    assigned.insert(make_pair(-1, -1));
+    assigned = tree;
+    copy.insert(make_pair(-2, 0));
+    assigned.remove(expected.begin()->first);
+    assert(sameItems(tree, expected));
+    map<int,int> copyItems = expected;
+    copyItems[-2] = 0;
+    assert(sameItems(copy, copyItems));
+    map<int,int> assignedItems(++expected.begin(), expected.end());
+    assert(sameItems(assigned, assignedItems));
+    const Tree& self = assigned;
+    assigned = self;
+    assert(sameItems(assigned, assignedItems));
+
+    Tree moved(std::move(copy));
+    assert(sameItems(moved, copyItems) && sameItems(copy, map<int,int>()));
+    copy.insert(make_pair(7, 7));
+    assert(copy.size() == 1 && copy.isValid());
+    assigned = std::move(moved);
+    assert(sameItems(assigned, copyItems) && sameItems(moved, map<int,int>()));
+
+    typename Tree::iterator first = tree.begin();
+    tree.swap(assigned);
+    assert(sameItems(tree, copyItems) && sameItems(assigned, expected));
+    assert(first == assigned.begin());
+    swap(tree, assigned);
+    assert(sameItems(tree, expected) && sameItems(assigned, copyItems));
+}
+
+// The heap allocator, counting the nodes handed out in all and not yet
+// given back, and the merges.
+class CountingAllocator
+{
+public:
+    void* allocate(size_t size, size_t align)
+    {
+        ++live;
+        ++allocations;
+        return heap_.allocate(size, align);
+    }
+    void deallocate(void* p, size_t size)
+    {
+        --live;
+        heap_.deallocate(p, size);
+    }
+    bool releasesAll() const { return heap_.releasesAll(); }
+    void release() { heap_.release(); }
+    void merge(CountingAllocator& other)
+    {
+        ++merges;
+        heap_.merge(other.heap_);
+    }
+    void swap(CountingAllocator& other) { heap_.swap(other.heap_); }
+
+    static long live;
+    static long allocations;
+    static long merges;
+
+private:
+    HeapNodeAllocator heap_;
+};
+
+long CountingAllocator::live = 0;
+long CountingAllocator::allocations = 0;
+long CountingAllocator::merges = 0;
+
+// A std::less<int> that counts its calls.
+struct CountingLess
+{
+    bool operator()(int a, int b) const
+    {
+        ++calls;
+        return a < b;
+    }
+
+    static long calls;
+};
+
+long CountingLess::calls = 0;
+
+// insert_batch() against std::map on random batches that repeat keys, both
+// within a batch, where the last item must win, and from the tree. Then a
+// batch above every key must cost the same comparisons however big the
+// tree is, since each item starts from the largest node.
+template<typename Tree>
+void checkInsertBatch()
+{
+    mt19937 rng(7);
+    Tree tree;
+    map<int,int> expected;
+    for(int round = 0; round < 200; ++round) {
+        vector<pair<int,int> > batch;
+        int count = rng() % 64;
+        for(int i = 0; i < count; ++i) {
+            int key = rng() % 1000;
+            batch.push_back(make_pair(key, round * 64 + i));
+            expected[key] = round * 64 + i;
+        }
+        tree.insert_batch(batch.begin(), batch.end());
+        assert(sameItems(tree, expected));
+    }
+
+    vector<pair<int,int> > items;
+    for(int i = 0; i < (1 << 16); ++i) {
+        items.push_back(make_pair(i, i));
+    }
+    Tree small(items.begin(), items.begin() + 16);
+    Tree large(items.begin(), items.end());
+    vector<pair<int,int> > batch;
+    for(int i = 0; i < 1000; ++i) {
+        batch.push_back(make_pair((1 << 20) + static_cast<int>(rng() % 100000), i));
+    }
+    CountingLess::calls = 0;
+    small.insert_batch(batch.begin(), batch.end());
+    long smallCalls = CountingLess::calls;
+    CountingLess::calls = 0;
+    large.insert_batch(batch.begin(), batch.end());
+    assert(CountingLess::calls < smallCalls + static_cast<long>(batch.size()));
+    assert(small.isValid() && large.isValid());
+}
+
+// rank() and select() against std::map after random inserts and removes,
+// including keys outside the tree and k >= size().
+template<typename Tree>
+void checkOrderStatistics()
+{
+    mt19937 rng(8);
+    Tree tree;
+    map<int,int> expected;
+    for(int i = 0; i < 5000; ++i) {
+        int key = rng() % 2000;
+        if(rng() % 3 != 0) {
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+        else {
+            tree.remove(key);
+            expected.erase(key);
+        }
+    }
+    assert(sameItems(tree, expected));
+    size_t less = 0;
+    for(int key = -1; key <= 2000; ++key) {
+        assert(tree.rank(key) == less);
+        if(expected.count(key) == 1) ++less;
+    }
+    map<int,int>::iterator next = expected.begin();
+    for(size_t k = 0; k < expected.size(); ++k, ++next) {
+        assert(tree.select(k)->first == next->first);
+    }
+    assert(tree.select(expected.size()) == tree.end());
+    assert(tree.select(expected.size() + 7) == tree.end());
+}
+
+// A tree whose links and cached ends a test can reach, to break one
+// invariant at a time.
+template<typename Tree>
+class TamperedTree : public Tree
+{
+public:
+    Node<int,int>* root() const { return this->root_; }
+    Node<int,int>* rightmost() const { return this->rightmost_; }
+    void setEnds(Node<int,int>* leftmost, Node<int,int>* rightmost)
+    {
+        this->leftmost_ = leftmost;
+        this->rightmost_ = rightmost;
+    }
+};
+
+// Fills a tree with the keys 1 to 7 as a perfect tree rooted at 4.
+template<typename Tree>
+void insertPerfect(Tree& tree)
+{
+    int keys[] = {4, 2, 6, 1, 3, 5, 7};
+    for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+}
+
+// Each invariant isValid() claims to check, broken alone on a small tree,
+// must make it return false, and mending it must make it true again: a
+// parent link, a subtree size, key order, either cached end and an AVL
+// balance. isBalanced() must reject a broken parent link and a subtree two
+// levels deeper than its sibling.
+void checkValidator()
+{
+    TamperedTree<AVLTree<int,int> > avl;
+    insertPerfect(avl);
+    assert(avl.isValid() && avl.isBalanced());
+    Node<int,int>* root = avl.root();
+    Node<int,int>* two = root->getLeft();
+    Node<int,int>* one = two->getLeft();
+    Node<int,int>* three = two->getRight();
+    Node<int,int>* seven = avl.rightmost();
+
+    one->setParent(root);
+    assert(!avl.isValid() && !avl.isBalanced());
+    one->setParent(two);
+    assert(avl.isValid());
+
+    two->setSize(4);
+    assert(!avl.isValid());
+    two->setSize(3);
+    assert(avl.isValid());
+
+    two->setLeft(three);
+    two->setRight(one);
+    avl.setEnds(three, seven);
+    assert(!avl.isValid());
+    two->setLeft(one);
+    two->setRight(three);
+    avl.setEnds(one, seven);
+    assert(avl.isValid());
+
+    avl.setEnds(two, seven);
+    assert(!avl.isValid());
+    avl.setEnds(one, root);
+    assert(!avl.isValid());
+    avl.setEnds(one, seven);
+    assert(avl.isValid());
+
+    static_cast<AVLNode<int,int>*>(two)->setBalance(1);
+    assert(!avl.isValid());
+    static_cast<AVLNode<int,int>*>(two)->setBalance(0);
+    assert(avl.isValid());
+
+    BinarySearchTree<int,int> plain;
+    insertPerfect(plain);
+    assert(plain.isValid() && plain.isBalanced());
+    plain.insert(make_pair(8, 8));
+    assert(plain.isValid() && plain.isBalanced());
+    plain.insert(make_pair(9, 9));
+    assert(plain.isValid() && !plain.isBalanced());
+    plain.remove(9);
+    assert(plain.isValid() && plain.isBalanced());
+}
+
+// A tree whose root can claim to hold max_size() items, to reach the size
+// limit without allocating 2^32 nodes.
+template<typename Tree>
+class FullTree : public Tree
+{
+public:
+    void setRootSize(size_t size) { this->root_->setSize(size); }
+};
+
+// Growing a full tree throws std::length_error and changes nothing, while
+// overwriting a present key still works.
+void checkSizeLimit()
+{
+    FullTree<AVLTree<int,int> > full;
+    AVLTree<int,int> greater;
+    map<int,int> expected;
+    for(int key = 0; key < 10; ++key) {
+        full.insert(make_pair(key, key));
+        expected[key] = key;
+    }
+    greater.insert(make_pair(100, 100));
+    assert(full.max_size() == 0xffffffffu);
+    full.setRootSize(full.max_size());
+    int thrown = 0;
+    try {
+        full.insert(make_pair(10, 10));
+    }
+    catch(length_error&) {
+        ++thrown;
+    }
+    try {
+        full.join(greater);
+    }
+    catch(length_error&) {
+        ++thrown;
+    }
+    full.insert(make_pair(5, 50));
+    expected[5] = 50;
+    full.setRootSize(expected.size());
+    assert(thrown == 2 && sameItems(full, expected) && greater.size() == 1);
+}
+
+// Orders keys like std::less, but in whatever types it is handed, without
+// declaring itself transparent.
+struct LooseLess
+{
+    template<typename A, typename B>
+    bool operator()(const A& a, const B& b) const { return a < b; }
+};
+
+// Lookups in a snapshot take keys of another type the way std::map does,
+// converting them to Key first unless Compare is transparent.
+template<typename Compare>
+void checkFrozenLookups()
+{
+    BinarySearchTree<uint32_t,int,Compare> tree;
+    map<uint32_t,int,Compare> expected;
+    for(uint32_t key = 0; key < 100; key += 3) {
+        tree.insert(make_pair(key, static_cast<int>(key)));
+        expected[key] = static_cast<int>(key);
+    }
+    tree.insert(make_pair(0xfffffffbu, -5));
+    expected[0xfffffffbu] = -5;
+    FrozenTree<uint32_t,int,Compare> frozen = tree.freeze();
+    long long probes[] = {-5LL, -4LL, -1LL, 0LL, 1LL, 3LL, 98LL, 99LL, 0x100000000LL};
+    for(size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); ++i) {
+        long long probe = probes[i];
+        typename map<uint32_t,int,Compare>::const_iterator found = expected.find(probe);
+        typename map<uint32_t,int,Compare>::const_iterator lower = expected.lower_bound(probe);
+        typename map<uint32_t,int,Compare>::const_iterator upper = expected.upper_bound(probe);
+        assert(found == expected.end() ? frozen.find(probe) == frozen.end() : frozen.find(probe).key() == found->first);
+        assert(lower == expected.end() ? frozen.lower_bound(probe) == frozen.end() : frozen.lower_bound(probe).key() == lower->first);
+        assert(upper == expected.end() ? frozen.upper_bound(probe) == frozen.end() : frozen.upper_bound(probe).key() == upper->first);
+    }
+    vector<typename FrozenTree<uint32_t,int,Compare>::const_iterator> batch;
+    frozen.find_batch(probes, probes + sizeof(probes) / sizeof(probes[0]), back_inserter(batch));
+    for(size_t i = 0; i < batch.size(); ++i) {
+        assert(batch[i] == frozen.find(probes[i]));
+    }
+}
+
+// Whether a snapshot iterator and a tree iterator point at the same key,
+// or are both at the end.
+template<typename Tree, typename Frozen>
+bool sameKey(const Tree& tree, typename Tree::const_iterator it, const Frozen& frozen, typename Frozen::const_iterator at)
+{
+    if(it == tree.end() || at == frozen.end()) return it == tree.end() && at == frozen.end();
+    return it->first == at.key() && it->second == at.value();
+}
+
+// Every block search kernel against the tree a snapshot came from, at
+// sizes around the block boundaries, on present and absent keys and the
+// ends of Key's range.
+template<typename Key>
+void checkBlockSearch()
+{
+    typedef BinarySearchTree<Key,int> Tree;
+    typedef FrozenTree<Key,int> Frozen;
+    const Key lowest = numeric_limits<Key>::min(), highest = numeric_limits<Key>::max();
+    mt19937_64 rng(17);
+    size_t sizes[] = {0, 1, 7, 8, 9, 63, 64, 65, 1000, 20000};
+    BlockSearchIsa isas[] = {blockSearchPortable, blockSearchSse2, blockSearchAvx2};
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        Tree tree;
+        while(tree.size() < sizes[s]) {
+            Key key = static_cast<Key>(rng() % (4 * sizes[s]) * 2 + lowest / 2);
+            tree.insert(make_pair(key, static_cast<int>(tree.size())));
+        }
+        if(sizes[s] % 2 == 1) {
+            tree.insert(make_pair(lowest, -1));
+            tree.insert(make_pair(highest, -2));
+        }
+        vector<Key> probes;
+        for(typename Tree::const_iterator it = tree.begin(); it != tree.end(); ++it) {
+            probes.push_back(it->first);
+            if(it->first != highest) probes.push_back(static_cast<Key>(it->first + 1));
+        }
+        probes.push_back(lowest);
+        probes.push_back(static_cast<Key>(lowest + 1));
+        probes.push_back(highest);
+        probes.push_back(static_cast<Key>(highest - 1));
+        probes.push_back(static_cast<Key>(0));
+        for(int i = 0; i < 100; ++i) probes.push_back(static_cast<Key>(rng()));
+        Frozen frozen = tree.freeze();
+        for(size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+            setBlockSearchIsa(isas[i]);
+            vector<typename Frozen::const_iterator> batch;
+            frozen.find_batch(probes.begin(), probes.end(), back_inserter(batch));
+            assert(batch.size() == probes.size());
+            for(size_t j = 0; j < probes.size(); ++j) {
+                const Key key = probes[j];
+                assert(sameKey(tree, tree.find(key), frozen, frozen.find(key)));
+                assert(sameKey(tree, tree.lower_bound(key), frozen, frozen.lower_bound(key)));
+                assert(sameKey(tree, tree.upper_bound(key), frozen, frozen.upper_bound(key)));
+                assert(sameKey(tree, tree.find(key), frozen, batch[j]));
+            }
+        }
+    }
+    setBlockSearchIsa(blockSearchAvx2);
+}
+
+// BTree against std::map with small nodes, so that leaves and inner nodes
+// split, borrow and merge often: random inserts, removes and try_emplace(),
+// lookups on present and missing keys, then a tree built from a sorted
+// range and emptied by removes.
+void checkBTree()
+{
+    typedef BTree<int,int,4> Tree;
+    mt19937 rng(18);
+    Tree tree;
+    map<int,int> expected;
+    for(int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(rng() % 3000);
+        switch(rng() % 4) {
+        case 0:
+        case 1:
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+            break;
+        case 2:
+            tree.remove(key);
+            expected.erase(key);
+            break;
+        default:
+            assert(tree.try_emplace(key, i).second == expected.insert(make_pair(key, i)).second);
+            break;
+        }
+        if(i % 1000 == 0) assert(tree.isValid());
+    }
+    assert(sameItems(tree, expected));
+    const Tree& constTree = tree;
+    for(int key = -1; key <= 3000; ++key) {
+        Tree::const_iterator found = constTree.find(key);
+        map<int,int>::const_iterator expectedFound = expected.find(key);
+        assert(expectedFound == expected.end() ? found == constTree.end() : found->second == expectedFound->second);
+        map<int,int>::const_iterator lower = expected.lower_bound(key);
+        assert(lower == expected.end() ? tree.lower_bound(key) == tree.end() : tree.lower_bound(key)->first == lower->first);
+        map<int,int>::const_iterator upper = expected.upper_bound(key);
+        assert(upper == expected.end() ? tree.upper_bound(key) == tree.end() : tree.upper_bound(key)->first == upper->first);
+    }
+    assert((--tree.end())->first == expected.rbegin()->first);
+
+    vector<pair<int,int> > items;
+    expected.clear();
+    for(int i = 0; i < 5000; ++i) {
+        items.push_back(make_pair(3 * i, i));
+        expected[3 * i] = i;
+    }
+    Tree sorted(items.begin(), items.end());
+    assert(sameItems(sorted, expected));
+    while(!expected.empty()) {
+        map<int,int>::iterator victim = expected.begin();
+        advance(victim, rng() % expected.size());
+        sorted.remove(victim->first);
+        expected.erase(victim);
+        if(expected.size() % 500 == 0) assert(sameItems(sorted, expected));
+    }
+    assert(sorted.empty() && sorted.begin() == sorted.end());
+}
+
+// CompactAVLTree against std::map: random inserts, removes and
+// try_emplace(), which reuse the slots that removes free, then a copy that
+// must be independent of its source, and clear().
+void checkCompactTree()
+{
+    typedef CompactAVLTree<int,int> Tree;
+    mt19937 rng(20);
+    Tree tree;
+    map<int,int> expected;
+    for(int i = 0; i < 20000; ++i) {
+        int key = static_cast<int>(rng() % 3000);
+        switch(rng() % 4) {
+        case 0:
+        case 1:
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+            break;
+        case 2:
+            tree.remove(key);
+            expected.erase(key);
+            break;
+        default:
+            assert(tree.try_emplace(key, i).second == expected.insert(make_pair(key, i)).second);
+            break;
+        }
+        if(i % 1000 == 0) assert(sameItems(tree, expected));
+    }
+    assert(sameItems(tree, expected));
+    assert(tree.capacity() < 2 * 3000);
+    for(int key = -1; key <= 3000; ++key) {
+        map<int,int>::const_iterator lower = expected.lower_bound(key);
+        assert(lower == expected.end() ? tree.lower_bound(key) == tree.end() : tree.lower_bound(key)->first == lower->first);
+        assert((tree.find(key) == tree.end()) == (expected.find(key) == expected.end()));
+    }
+
+    Tree copy(tree);
+    map<int,int> copied(expected);
+    assert(sameItems(copy, copied));
+    for(int key = 0; key < 3000; key += 2) {
+        copy.remove(key);
+        copied.erase(key);
+    }
+    copy.insert(make_pair(5000, 1));
+    copied[5000] = 1;
+    assert(sameItems(copy, copied) && sameItems(tree, expected));
+    tree = copy;
+    assert(sameItems(tree, copied));
+
+    tree.clear();
+    assert(tree.empty() && tree.begin() == tree.end() && sameItems(tree, map<int,int>()));
+    assert(sameItems(copy, copied));
+    tree.insert(make_pair(1, 1));
+    assert(tree.size() == 1 && tree.isValid() && tree.find(1)->second == 1);
+}
+
+// AVLTree::split() at present, missing and out-of-range keys, then join()
+// back, against std::map. A join of overlapping trees must throw and leave
+// both as they were.
+void checkSplitJoin()
+{
+    mt19937 rng(5);
+    AVLTree<int,int> at;
+    map<int,int> expected;
+    for(int i = 0; i < 5000; ++i) {
+        int key = rng() % 10000;
+        at.insert(make_pair(key, i));
+        expected[key] = i;
+    }
+    int cuts[] = { -1, 0, 1, 4999, 5000, 9999, 10000, static_cast<int>(rng() % 10000), expected.begin()->first };
+    for(size_t c = 0; c < sizeof(cuts) / sizeof(cuts[0]); ++c) {
+        AVLTree<int,int> greater;
+        greater.insert(make_pair(-5, 0));
+        at.split(cuts[c], greater);
+        map<int,int> less(expected.begin(), expected.lower_bound(cuts[c]));
+        map<int,int> notLess(expected.lower_bound(cuts[c]), expected.end());
+        assert(sameItems(at, less));
+        assert(sameItems(greater, notLess));
+        if(!at.empty() && !greater.empty()) {
+            bool thrown = false;
+            try {
+                greater.join(at);
+            }
+            catch(invalid_argument&) {
+                thrown = true;
+            }
+            assert(thrown && sameItems(at, less) && sameItems(greater, notLess));
+        }
+        at.join(greater);
+        assert(greater.empty() && sameItems(at, expected));
+    }
+
+    // The halves share node memory after a split, and both stay writable.
+    AVLTree<int,int> greater;
+    at.split(5000, greater);
+    for(int i = 0; i < 1000; ++i) {
+        int key = rng() % 5000;
+        at.insert(make_pair(key, i));
+        expected[key] = i;
+        key = 5000 + rng() % 5000;
+        greater.remove(key);
+        expected.erase(key);
+    }
+    at.join(greater);
+    assert(sameItems(at, expected));
+
+    // A join that throws must leave the two trees' pools apart.
+    AVLTree<int,int,less<int>,CountingAllocator> low, high;
+    for(int key = 0; key < 100; ++key) {
+        low.insert(make_pair(key, key));
+        high.insert(make_pair(key + 50, key));
+    }
+    long merges = CountingAllocator::merges;
+    bool thrown = false;
+    try {
+        low.join(high);
+    }
+    catch(invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown && CountingAllocator::merges == merges);
+}
+
+// A BinarySearchTree built directly as a right spine of n nodes, far deeper
+// than a recursive teardown could go.
+class SpineTree : public BinarySearchTree<int, string, less<int>, CountingAllocator>
+{
+public:
+    explicit SpineTree(int n)
+    {
+        Node<int, string>* last = nullptr;
+        for(int i = 0; i < n; ++i) {
+            Node<int, string>* node = createNode<Node<int, string> >(last, i, string("spine"));
+            node->setSize(n - i);
+            if(last == nullptr) root_ = node;
+            else last->setRight(node);
+            last = node;
+        }
+        resetEnds();
+    }
+};
+
+// clear() and the destructor must free every node of a degenerate tree,
+// without recursing down it.
+void checkTeardown()
+{
+    const int n = 1000000;
+    {
+        SpineTree spine(n);
+        assert(spine.isValid() && spine.size() == static_cast<size_t>(n));
+        assert(CountingAllocator::live == n);
+        spine.clear();
+        assert(CountingAllocator::live == 0 && spine.empty() && spine.isValid());
+    }
+    {
+        SpineTree spine(n);
+        assert(spine.isValid() && CountingAllocator::live == n);
+    }
+    assert(CountingAllocator::live == 0);
+}
+
+// ConcurrentAVLTree against std::map, then under concurrent writers: keys
+// that are always present must stay visible to find() and lower_bound()
+// through every rotation, and for_each() must see strictly increasing keys.
+void checkConcurrentTree()
+{
+    mt19937 rng(1);
+    ConcurrentAVLTree<int,int> ct;
+    map<int,int> expected;
+    for(int i = 0; i < 20000; ++i) {
+        int key = rng() % 2000;
+        if(rng() % 3 != 0) {
+            ct.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+        else {
+            ct.remove(key);
+            expected.erase(key);
+        }
+    }
+    assert(ct.isValid() && ct.size() == expected.size());
+    map<int,int>::iterator next = expected.begin();
+    ct.for_each([&](const pair<const int,int>& item) {
+        assert(next != expected.end() && item.first == next->first && item.second == next->second);
+        ++next;
+    });
+    assert(next == expected.end());
+    for(int key = -1; key <= 2000; ++key) {
+        int value;
+        pair<int,int> item;
+        map<int,int>::iterator bound = expected.lower_bound(key);
+        assert(ct.find(key, value) == (expected.count(key) == 1));
+        assert(ct.lower_bound(key, item) == (bound != expected.end()));
+        if(bound != expected.end()) {
+            assert(item.first == bound->first && item.second == bound->second);
+        }
+    }
+
+    // Multiples of 4 are never removed; the writers churn the keys between
+    // them, which rotates the nodes the readers are walking through.
+    const int range = 1 << 13;
+    ConcurrentAVLTree<int,int> shared;
+    for(int key = 0; key < range; key += 4) {
+        shared.insert(make_pair(key, key));
+    }
+    atomic<int> writersLeft(2);
+    vector<thread> threads;
+    for(int w = 0; w < 2; ++w) {
+        threads.push_back(thread([&shared, &writersLeft, w, range]() {
+            mt19937 wrng(10 + w);
+            for(int i = 0; i < 30000; ++i) {
+                int key = wrng() % range;
+                if(key % 4 == 0 || wrng() % 2 == 0) shared.insert(make_pair(key, key));
+                else shared.remove(key);
+            }
+            --writersLeft;
+        }));
+    }
+    for(int r = 0; r < 2; ++r) {
+        threads.push_back(thread([&shared, &writersLeft, r, range]() {
+            mt19937 rrng(20 + r);
+            for(int round = 0; writersLeft.load() != 0 || round < 100; ++round) {
+                int key = rrng() % range;
+                int value;
+                pair<int,int> item;
+                if(key % 4 == 0) assert(shared.find(key, value));
+                assert(shared.lower_bound(key, item));
+                assert(item.first >= key && item.first <= (key + 3) / 4 * 4 && item.second == item.first);
+                if(round % 64 == 0) {
+                    int previous = -1;
+                    int permanent = 0;
+                    shared.for_each([&](const pair<const int,int>& entry) {
+                        assert(entry.first > previous);
+                        previous = entry.first;
+                        if(entry.first % 4 == 0) ++permanent;
+                    });
+                    assert(permanent == range / 4);
+                }
+            }
+        }));
+    }
+    for(size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    assert(shared.isValid());
+}
+
+// ShardedTree under concurrent writers, each in its own key range and
+// mirrored in its own std::map. The rising keys skew the shards, so the
+// inserts trigger rebalance() while the others write; a third thread calls
+// it directly as well. Afterwards the tree must be valid and hold exactly
+// the union of the maps, in order.
+void checkShardedTree()
+{
+    const int writers = 3;
+    const int perWriter = 12000;
+    ShardedTree<int,int> st(8);
+    vector<map<int,int> > expected(writers);
+    atomic<int> writersLeft(writers);
+    vector<thread> threads;
+    for(int w = 0; w < writers; ++w) {
+        threads.push_back(thread([&st, &expected, &writersLeft, w]() {
+            mt19937 wrng(30 + w);
+            map<int,int>& mine = expected[w];
+            for(int i = 0; i < perWriter; ++i) {
+                int key = w * perWriter + i;
+                st.insert(make_pair(key, i));
+                mine[key] = i;
+                if(wrng() % 4 == 0) {
+                    int old = key - static_cast<int>(wrng() % 50);
+                    if(old >= w * perWriter) {
+                        st.remove(old);
+                        mine.erase(old);
+                    }
+                }
+                int value;
+                st.find(static_cast<int>(wrng() % (writers * perWriter)), value);
+            }
+            --writersLeft;
+        }));
+    }
+    threads.push_back(thread([&st, &writersLeft]() {
+        while(writersLeft.load() != 0) {
+            st.rebalance();
+            this_thread::yield();
+        }
+    }));
+    for(size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    map<int,int> all;
+    for(int w = 0; w < writers; ++w) {
+        all.insert(expected[w].begin(), expected[w].end());
+    }
+    assert(st.isValid() && st.size() == all.size());
+    ShardedTree<int,int>::iterator it = st.begin();
+    for(map<int,int>::iterator next = all.begin(); next != all.end(); ++next, ++it) {
+        assert(it != st.end() && it->first == next->first && it->second == next->second);
+    }
+    assert(it == st.end());
+    size_t used = 0;
+    for(size_t i = 0; i < st.shardCount(); ++i) {
+        if(st.shardSize(i) != 0) ++used;
+    }
+    assert(used > 1);
+}
+
+// PersistentAVLTree snapshots taken along a run of writes must each keep
+// the contents they were taken with, however the tree and the other
+// snapshots change afterwards.
+void checkPersistentTree()
+{
+    mt19937 rng(4);
+    PersistentAVLTree<int,int> pt;
+    map<int,int> expected;
+    vector<PersistentAVLTree<int,int> > snapshots;
+    vector<map<int,int> > contents;
+    for(int i = 0; i < 30000; ++i) {
+        int key = rng() % 1000;
+        if(rng() % 3 != 0) {
+            pt.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+        else {
+            pt.remove(key);
+            expected.erase(key);
+        }
+        if(i % 500 == 0) {
+            snapshots.push_back(pt.snapshot());
+            contents.push_back(expected);
+        }
+        if(i % 5000 == 0 && !snapshots.empty()) {
+            // Writing to a copy of an old snapshot leaves the snapshot alone.
+            PersistentAVLTree<int,int> branch = snapshots[snapshots.size() / 2];
+            branch.insert(make_pair(-1, i));
+            branch.remove(rng() % 1000);
+            assert(branch.isValid());
+        }
+    }
+    assert(sameItems(pt, expected));
+    for(size_t i = 0; i < snapshots.size(); ++i) {
+        assert(sameItems(snapshots[i], contents[i]));
+    }
+    for(int key = -2; key <= 1000; ++key) {
+        map<int,int>::iterator bound = expected.lower_bound(key);
+        PersistentAVLTree<int,int>::const_iterator found = pt.lower_bound(key);
+        assert((found == pt.end()) == (bound == expected.end()));
+        if(bound != expected.end()) assert(found->first == bound->first);
+        assert((pt.find(key) == pt.end()) == (expected.count(key) == 0));
+    }
+}
+
+// A std::less<int> that throws on the call after a countdown runs out.
+struct ThrowingLess
+{
+    bool operator()(int a, int b) const
+    {
+        if(countdown-- == 0) throw runtime_error("ThrowingLess");
+        return a < b;
+    }
+
+    static long countdown;
+};
+
+long ThrowingLess::countdown = -1;
+
+// PersistentAVLTree writes to nodes no other version holds happen in place:
+// an insert makes only its new node, an overwrite only its replacement and
+// a remove nothing, while a snapshot is alive makes them copy their path
+// again. A write whose comparison throws, with or without a snapshot, must
+// leave the tree as it was.
+void checkPersistentInPlace()
+{
+    typedef PersistentAVLTree<int,int,less<int>,CountingAllocator> Tree;
+    mt19937 rng(23);
+    {
+        Tree pt;
+        map<int,int> expected;
+        for(int i = 0; i < 20000; ++i) {
+            int key = rng() % 2000;
+            long before = CountingAllocator::allocations;
+            if(rng() % 3 != 0) {
+                pt.insert(make_pair(key, i));
+                expected[key] = i;
+                assert(CountingAllocator::allocations == before + 1);
+            }
+            else {
+                pt.remove(key);
+                expected.erase(key);
+                assert(CountingAllocator::allocations == before);
+            }
+            assert(CountingAllocator::live == static_cast<long>(expected.size()));
+        }
+        assert(sameItems(pt, expected));
+        Tree snapshot = pt.snapshot();
+        long before = CountingAllocator::allocations;
+        pt.insert(make_pair(2000, 0));
+        assert(CountingAllocator::allocations > before + 1);
+        expected[2000] = 0;
+        assert(sameItems(pt, expected));
+        expected.erase(2000);
+        assert(sameItems(snapshot, expected));
+    }
+    assert(CountingAllocator::live == 0);
+
+    PersistentAVLTree<int,int,ThrowingLess> pt;
+    map<int,int> expected;
+    vector<PersistentAVLTree<int,int,ThrowingLess> > snapshots;
+    for(int i = 0; i < 20000; ++i) {
+        int key = rng() % 500;
+        bool adding = rng() % 3 != 0;
+        ThrowingLess::countdown = rng() % 24;
+        try {
+            if(adding) pt.insert(make_pair(key, i));
+            else pt.remove(key);
+            ThrowingLess::countdown = -1;
+            if(adding) expected[key] = i;
+            else expected.erase(key);
+        }
+        catch(const runtime_error&) {
+            ThrowingLess::countdown = -1;
+        }
+        if(i % 1000 == 0) {
+            assert(sameItems(pt, expected));
+            if(i % 3000 == 0) snapshots.clear();
+            snapshots.push_back(pt);
+        }
+    }
+    ThrowingLess::countdown = -1;
+    assert(sameItems(pt, expected));
+}
+
+// Concatenates two runs of keys, for an order-sensitive parallel_reduce().
+vector<int> appendKeys(vector<int> left, const vector<int>& right)
+{
+    left.insert(left.end(), right.begin(), right.end());
+    return left;
+}
+
+// AVLTree::parallel_assign() and parallel_reduce() on a pool, with enough
+// items to be split across threads, against std::map. Unsorted input must
+// fall back to a serial build with the same result.
+void checkParallelTree()
+{
+    WorkStealingPool pool(4);
+    map<int,int> expected;
+    vector<pair<int,int> > items;
+    for(int i = 0; i < 50000; ++i) {
+        items.push_back(make_pair(3 * i, i));
+        expected[3 * i] = i;
+    }
+    AVLTree<int,int> at;
+    at.insert(make_pair(-1, -1));
+    at.parallel_assign(pool, items.begin(), items.end());
+    assert(sameItems(at, expected));
+
+    long long sum = at.parallel_reduce(pool, 0LL,
+        [](const pair<const int,int>& item) { return static_cast<long long>(item.second); },
+        [](long long a, long long b) { return a + b; });
+    assert(sum == 50000LL * 49999 / 2);
+    vector<int> keys = at.parallel_reduce(pool, vector<int>(),
+        [](const pair<const int,int>& item) { return vector<int>(1, item.first); },
+        appendKeys);
+    assert(keys.size() == expected.size());
+    size_t index = 0;
+    for(map<int,int>::iterator next = expected.begin(); next != expected.end(); ++next, ++index) {
+        assert(keys[index] == next->first);
+    }
+
+    swap(items[100], items[101]);
+    AVLTree<int,int> unsorted;
+    unsorted.parallel_assign(pool, items.begin(), items.end());
+    assert(sameItems(unsorted, expected));
+}
+
+// AVLTree::set_union(), set_intersection() and set_difference() on a pool,
+// with overlapping random keys, against the same operations on std::map.
+// The other tree is left empty, and both trees stay usable afterwards.
+void checkSetOperations()
+{
+    WorkStealingPool pool(4);
+    mt19937 rng(6);
+    for(int op = 0; op < 3; ++op) {
+        AVLTree<int,int> lhs, rhs;
+        map<int,int> left, right, expected;
+        for(int i = 0; i < 30000; ++i) {
+            int key = rng() % 60000;
+            lhs.insert(make_pair(key, 1));
+            left[key] = 1;
+            key = rng() % 60000;
+            rhs.insert(make_pair(key, 2));
+            right[key] = 2;
+        }
+        if(op == 0) {
+            expected = left;
+            for(map<int,int>::iterator it = right.begin(); it != right.end(); ++it) {
+                expected[it->first] = it->second;
+            }
+            lhs.set_union(pool, rhs);
+        }
+        else {
+            for(map<int,int>::iterator it = left.begin(); it != left.end(); ++it) {
+                if((right.count(it->first) == 1) == (op == 1)) expected.insert(*it);
+            }
+            if(op == 1) lhs.set_intersection(pool, rhs);
+            else lhs.set_difference(pool, rhs);
+        }
+        assert(sameItems(lhs, expected));
+        assert(rhs.empty() && rhs.isValid());
+        for(int i = 0; i < 1000; ++i) {
+            int key = rng() % 60000;
+            lhs.insert(make_pair(key, 3));
+            rhs.insert(make_pair(key, 3));
+            lhs.remove(rng() % 60000);
+        }
+        assert(lhs.isValid() && rhs.isValid());
+    }
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -45,5 +1294,54 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Bulk load from sorted input
+    std::map<char,int> sorted;
+    for(char c = 'a'; c <= 'g'; ++c) {
+        sorted[c] = c - 'a';
+    }
+    AVLTree<char,int> bulk(sorted.begin(), sorted.end());
+    cout << "\nBulk-loaded AVLTree:" << endl;
+    bulk.print();
+
+    cout << "In reverse:" << endl;
+    for(AVLTree<char,int>::const_reverse_iterator it = bulk.crbegin(); it != bulk.crend(); ++it) {
+        cout << it->first << " ";
+    }
+    cout << endl;
+
+    checkInsertBatch<BinarySearchTree<int,int,CountingLess> >();
+    checkInsertBatch<AVLTree<int,int,CountingLess> >();
+    checkOrderStatistics<BinarySearchTree<int,int> >();
+    checkOrderStatistics<AVLTree<int,int> >();
+    checkSizeLimit();
+    checkValidator();
+    checkBounds<BinarySearchTree<int,int> >();
+    checkBounds<AVLTree<int,int> >();
+    checkTransparentLookup();
+    checkIterators();
+    checkEmplace<BinarySearchTree<int,Tracked> >();
+    checkEmplace<AVLTree<int,Tracked> >();
+    checkFindBatch<BinarySearchTree<int,int> >();
+    checkFindBatch<AVLTree<int,int> >();
+    checkCopyMoveSwap<BinarySearchTree<int,int> >();
+    checkCopyMoveSwap<AVLTree<int,int> >();
+    checkFrozenLookups<less<uint32_t> >();
+    checkFrozenLookups<LooseLess>();
+    checkBlockSearch<int32_t>();
+    checkBlockSearch<uint32_t>();
+    checkBlockSearch<int64_t>();
+    checkBlockSearch<uint64_t>();
+    checkBTree();
+    checkCompactTree();
+    checkSplitJoin();
+    checkTeardown();
+    checkConcurrentTree();
+    checkShardedTree();
+    checkPersistentTree();
+    checkPersistentInPlace();
+    checkParallelTree();
+    checkSetOperations();
+    cout << "\nAll checks passed" << endl;
+
     return 0;
 }
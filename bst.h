@@ -5,20 +5,36 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
+#include <tuple>
+#include <functional>
+#include <stdexcept>
+#include "node_pool.h"
+#include "frozen_tree.h"
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
+ * Nodes carry no vtable: node types for other kinds of
  * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * and AVL trees, derive from Node and hide the getters
+ * for parent/left/right with versions returning their
+ * own type, so every traversal step is resolved at
+ * compile time and can be inlined. Subtree sizes are
+ * stored in 32 bits, which caps a tree at 2^32 - 1 items.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    Node(Node<Key, Value>* parent, Args&&... args);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,20 +42,27 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
+
+    // Getter/setter for the number of nodes in this node's subtree.
+    std::size_t getSize() const;
+    void setSize(std::size_t size);
+    void updateSize(long diff);
 
 protected:
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
+    uint32_t size_;    // 32 bits so derived nodes can pack into the padding after it
 };
 
 /*
@@ -56,7 +79,25 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
     item_(key, value),
     parent_(parent),
     left_(NULL),
-    right_(NULL)
+    right_(NULL),
+    size_(1)
+{
+
+}
+
+/**
+* Constructs the item in place from args, exactly as
+* std::pair<const Key, Value>(args...) would, so nothing is copied that the
+* caller did not ask to copy.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(Node<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL),
+    size_(1)
 {
 
 }
@@ -118,7 +159,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +168,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +177,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,37 +221,146 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter that moves the new value in rather than copying it.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
+/**
+* A getter for the number of nodes in the subtree rooted at this node.
+*/
+template<typename Key, typename Value>
+std::size_t Node<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the subtree size of a node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setSize(std::size_t size)
+{
+    size_ = static_cast<uint32_t>(size);
+}
+
+/**
+* Adds diff to the subtree size of a node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::updateSize(long diff)
+{
+    size_ = static_cast<uint32_t>(size_ + diff);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* Orders key/value pairs by key alone, using a tree's comparator.
+*/
+template<typename Compare>
+struct KeyLess
+{
+    explicit KeyLess(const Compare& comp) : comp(comp) { }
+    template<typename Pair>
+    bool operator()(const Pair& lhs, const Pair& rhs) const { return comp(lhs.first, rhs.first); }
+    Compare comp;
+};
+
+/**
+* Orders any two values with operator<, like C++14's std::less<>. Being
+* transparent, it lets a tree look keys up by any type that compares with
+* them, e.g. a std::string-keyed tree by const char*, with no temporary key.
+*/
+struct TransparentLess
+{
+    typedef void is_transparent;
+    template<typename Lhs, typename Rhs>
+    bool operator()(const Lhs& lhs, const Rhs& rhs) const { return lhs < rhs; }
+};
+
+/**
+* The balance callback for BinarySearchTree::buildSorted and cloneTree when
+* the nodes have no balance to record.
+*/
+struct NoBalance
+{
+    template<typename NodeType>
+    void operator()(NodeType* node, int balance) const { }
+    template<typename NodeType>
+    void operator()(NodeType* node, const NodeType* from) const { }
+};
+
 /**
 * A templated unbalanced binary search tree.
+* Keys are ordered by Compare, a strict weak ordering as for std::map; when
+* Compare defines is_transparent, find and the bounds also accept any key
+* type it can compare. Nodes are obtained from Alloc (see node_pool.h),
+* which defaults to a pool owned by the tree. A tree holds at most
+* max_size() items, the limit of the 32-bit subtree sizes; anything that
+* would grow it further throws std::length_error instead.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = NodePool>
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
+    template<typename Iter>
+    BinarySearchTree(Iter first, Iter last, const Compare& comp = Compare());
+    BinarySearchTree(const BinarySearchTree& other);
+    BinarySearchTree(BinarySearchTree&& other);
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree& operator=(const BinarySearchTree& other);
+    BinarySearchTree& operator=(BinarySearchTree&& other);
+    void swap(BinarySearchTree& other);
+    template<typename Iter>
+    void assign(Iter first, Iter last);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    template<typename Pair>
+    typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+    insert(Pair&& keyValuePair);
+    template<typename Iter>
+    void insert_batch(Iter first, Iter last);
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
     bool isBalanced() const; //TODO
+    bool isValid() const;
     void print() const;
     bool empty() const;
+    std::size_t size() const;
+    std::size_t max_size() const;
+    Compare key_comp() const;
+    FrozenTree<Key, Value, Compare> freeze() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
 public:
+    class const_iterator;
+
     /**
     * An internal iterator class for traversing the contents of the BST.
+    * It is bidirectional: stepping back from end() lands on the largest
+    * item, which is why an iterator remembers the tree it came from.
     */
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -218,19 +368,109 @@ public:
 
         bool operator==(const iterator& rhs) const;
         bool operator!=(const iterator& rhs) const;
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare, Alloc>;
+        friend class const_iterator;
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare, Alloc>* tree);
+        Node<Key, Value> *current_;
+        const BinarySearchTree<Key, Value, Compare, Alloc>* tree_;
+    };
+
+    /**
+    * The read-only counterpart of iterator, handed out by const trees.
+    * Any iterator converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare, Alloc>;
+        const_iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare, Alloc>* tree);
         Node<Key, Value> *current_;
+        const BinarySearchTree<Key, Value, Compare, Alloc>* tree_;
     };
 
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
 public:
-    iterator begin() const;
-    iterator end() const;
-    iterator find(const Key& key) const;
+    iterator begin();
+    const_iterator begin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator> equal_range(const K& key) const;
+    template<typename InIter, typename OutIter>
+    OutIter find_batch(InIter first, InIter last, OutIter out);
+    template<typename InIter, typename OutIter>
+    OutIter find_batch(InIter first, InIter last, OutIter out) const;
+    std::size_t rank(const Key& key) const;
+    iterator select(std::size_t k);
+    const_iterator select(std::size_t k) const;
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
@@ -238,6 +478,7 @@ protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value>* getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
@@ -247,14 +488,66 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
+    template<typename Item>
+    Node<Key, Value>* insertFrom(Node<Key, Value>* start, Item&& keyValuePair);
+    Node<Key, Value>* coveringSubtree(Node<Key, Value>* node, const Key& key) const;
+    template<typename NodeType, typename... Args>
+    NodeType* createNode(NodeType* parent, Args&&... args);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual Node<Key, Value>* createLeaf(Node<Key, Value>* parent, const std::pair<const Key, Value>& item);
+    virtual Node<Key, Value>* createLeaf(Node<Key, Value>* parent, std::pair<Key, Value>&& item);
+    virtual void balanceAfterInsert(Node<Key, Value>* leaf);
+    Node<Key, Value>* findInsertPosition(Node<Key, Value>* start, const Key& key, Node<Key, Value>*& parent, bool& left);
+    void attachLeaf(Node<Key, Value>* parent, bool left, Node<Key, Value>* leaf);
+    template<typename Item>
+    std::pair<Node<Key, Value>*, bool> insertItem(Node<Key, Value>* start, Item&& item);
     void clearTree(Node<Key, Value>* root);
     static Node<Key, Value>* successor(Node<Key, Value>* current); // TODO
-    static int processLeaves(Node<Key, Value>* root, bool& l);
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* lowerBoundNode(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* upperBoundNode(const K& key) const;
+    template<typename K>
+    std::pair<Node<Key, Value>*, Node<Key, Value>*> equalRangeNodes(const K& key) const;
+    template<typename OutIter, typename Iterator>
+    OutIter findBatch(const Key* keys, std::size_t count, OutIter out) const;
+    void findNodes(const Key* keys, std::size_t count, Node<Key, Value>** found) const;
+    Node<Key, Value>* selectNode(std::size_t k) const;
+    bool checkTree(bool full) const;
+    virtual bool checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    template<typename Iter>
+    bool sortedRange(Iter first, Iter last, std::size_t& size) const;
+    static int builtHeight(std::size_t size);
+    static std::size_t subtreeSize(Node<Key, Value>* node);
+    static void updateSizes(Node<Key, Value>* node, long diff);
+    void updateEndsAfterInsert(Node<Key, Value>* node);
+    void updateEndsBeforeRemove(Node<Key, Value>* node);
+    void resetEnds();
+    template<typename NodeType, typename Iter, typename Visit>
+    NodeType* buildSorted(Iter& first, std::size_t size, Visit visit);
+    virtual Node<Key, Value>* copyNodes(const Node<Key, Value>* root);
+    template<typename NodeType, typename Visit>
+    NodeType* cloneTree(const NodeType* root, Visit visit);
 
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    Node<Key, Value>* leftmost_;     // smallest key, kept current by every update
+    Node<Key, Value>* rightmost_;    // largest key
+    Compare comp_;
+    Alloc alloc_;
+
+    /**
+    * How many keys find_batch() gathers before searching, and how many of
+    * those descend together, one level at a time.
+    */
+    static const std::size_t findBatchSize = 256;
+    static const std::size_t findBatchGroup = 16;
+
+    // The most items Node's 32-bit size_ can count.
+    static const std::size_t maxSize = 0xffffffffu;
 };
 
 /*
@@ -264,10 +557,13 @@ Begin implementations for the BinarySearchTree::iterator class.
 */
 
 /**
-* Explicit constructor that initializes an iterator with a given node pointer.
+* Explicit constructor that initializes an iterator with a given node pointer
+* and the tree it belongs to.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr) : current_(ptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value, Compare, Alloc>* tree) :
+    current_(ptr),
+    tree_(tree)
 {
     // TODO
 }
@@ -275,8 +571,8 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr) : current
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator() : current_(nullptr), tree_(nullptr)
 {
     // TODO
 }
@@ -284,9 +580,9 @@ BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr)
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -294,9 +590,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -305,10 +601,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return current_ == rhs.current_;
@@ -318,28 +614,82 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return current_ != rhs.current_;
 }
 
+/**
+* Compares against a const_iterator, so mixed comparisons work both ways.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
 
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++()
 {
     // TODO
     current_ = successor(current_);
     return *this;
 }
 
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--()
+{
+    current_ = current_ == nullptr ? tree_->getLargestNode() : predecessor(current_);
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
 
 /*
 -------------------------------------------------------------
@@ -348,223 +698,1210 @@ End implementations for the BinarySearchTree::iterator class.
 */
 
 /*
------------------------------------------------------
-Begin implementations for the BinarySearchTree class.
------------------------------------------------------
+-------------------------------------------------------------------
+Begin implementations for the BinarySearchTree::const_iterator class.
+-------------------------------------------------------------------
 */
 
 /**
-* Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Explicit constructor that initializes a const_iterator with a given node
+* pointer and the tree it belongs to.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value, Compare, Alloc>* tree) :
+    current_(ptr),
+    tree_(tree)
 {
-    // TODO
-    root_ = nullptr;
+
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* A default constructor that initializes the const_iterator to NULL.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator() : current_(nullptr), tree_(nullptr)
 {
-    // TODO
-    clear();
+
 }
 
 /**
- * Returns true if tree is empty
+* Converts an iterator to a const_iterator at the same position.
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& it) :
+    current_(it.current_),
+    tree_(it.tree_)
 {
-    return root_ == NULL;
+
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Provides read-only access to the item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator*() const
 {
-    printRoot(root_);
-    std::cout << "\n";
+    return current_->getItem();
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Provides the address of the item, read-only.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare, class Alloc>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator->() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-    return begin;
+    return &(current_->getItem());
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* Checks if 'this' const_iterator's internals have the same value
+* as 'rhs'
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator& rhs) const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
-    return end;
+    return current_ == rhs.current_;
 }
 
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+* Checks if 'this' const_iterator's internals have a different value
+* as 'rhs'
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare, class Alloc>
+bool
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator& rhs) const
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
-    return it;
+    return current_ != rhs.current_;
 }
 
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+* Advances the const_iterator's location using an in-order sequencing
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator++()
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    current_ = successor(current_);
+    return *this;
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+
+/**
+* Post-increment: advances the const_iterator and returns its old position.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator++(int)
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    const_iterator old(*this);
+    ++(*this);
+    return old;
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+* Moves the const_iterator back one item in order. Stepping back from end()
+* gives the largest item.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator--()
 {
-    // TODO
-    if (empty()){
-        root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
-        return;
-    }
-    Node<Key, Value>* currNode = root_;
-    while (currNode != nullptr){
-        if (keyValuePair.first == currNode->getKey()){ /* No duplicate keys in a BST. */
-            currNode->setValue(keyValuePair.second);
-            return;
-        } else if (keyValuePair.first < currNode->getKey()){ /* key must go in left subtree */
-            if (currNode->getLeft() == nullptr){
-                Node<Key, Value>* newLChild = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, currNode);
-                currNode->setLeft(newLChild);
-                return;
-            } else {
-                currNode = currNode->getLeft();
-            }
-        } else { /* key must go in right subtree */
-            if (currNode->getRight() == nullptr){
-                Node<Key, Value>* newRChild = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, currNode);
-                currNode->setRight(newRChild);
-                return;
-            } else {
-                currNode = currNode->getRight();
-            }
-        }
-    }
+    current_ = current_ == nullptr ? tree_->getLargestNode() : predecessor(current_);
+    return *this;
 }
 
+/**
+* Post-decrement: moves the const_iterator back and returns its old position.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+-----------------------------------------------------------------
+End implementations for the BinarySearchTree::const_iterator class.
+-----------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the BinarySearchTree class.
+-----------------------------------------------------
+*/
 
 /**
-* A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+* Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree() :
+    leftmost_(nullptr),
+    rightmost_(nullptr)
 {
     // TODO
-    Node<Key, Value>* nodeToRemove = internalFind(key);
-    if (!empty() && nodeToRemove != nullptr){
-        if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) { // Node has 2 children
-            nodeSwap(nodeToRemove, predecessor(nodeToRemove)); // Swap values
-        }
-        if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() == nullptr) { // Node has left child only
-            if (nodeToRemove->getParent() != nullptr){ // Node is not the root
-                (nodeToRemove->getLeft())->setParent(nodeToRemove->getParent()); // Promote left child
-                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
-                    (nodeToRemove->getParent())->setLeft(nodeToRemove->getLeft());
-                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
-                    (nodeToRemove->getParent())->setRight(nodeToRemove->getLeft());
-                }
-            } else { // Node is the root
-                root_ = nodeToRemove->getLeft();
-                (nodeToRemove->getLeft())->setParent(nullptr);
-            }
-        } else if (nodeToRemove->getLeft() == nullptr && nodeToRemove->getRight() != nullptr) { // Node has right child only
-            if (nodeToRemove->getParent() != nullptr){ // Node is not the root
-                (nodeToRemove->getRight())->setParent(nodeToRemove->getParent()); // Promote right child
-                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
-                    (nodeToRemove->getParent())->setLeft(nodeToRemove->getRight());
-                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
-                    (nodeToRemove->getParent())->setRight(nodeToRemove->getRight());
-                }
-            } else { // Node is the root
-                root_ = nodeToRemove->getRight();
-                (nodeToRemove->getRight())->setParent(nullptr);
-            }
-        } else {
-            if (nodeToRemove == root_) {
-                delete nodeToRemove;
-                root_ = nullptr;
-                return;
-            } else {
-                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
-                    (nodeToRemove->getParent())->setLeft(nullptr);
-                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
-                    (nodeToRemove->getParent())->setRight(nullptr);
-                }
-            }
-        }
-        delete nodeToRemove;
-    }
+    root_ = nullptr;
 }
 
-template<class Key, class Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+/**
+* Constructs an empty tree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const Compare& comp) :
+    root_(nullptr),
+    leftmost_(nullptr),
+    rightmost_(nullptr),
+    comp_(comp)
 {
-    // TODO
-    if (current->getLeft() != nullptr){
-        current = current->getLeft();
-        while (current->getRight() != nullptr){
-            current = current->getRight();
-        }
-        return current;
-    } else {
-        Node<Key, Value>* parent = current->getParent();
-        while (parent != nullptr && current != current->getParent()->getRight()){
-            current = parent;
-            parent = parent->getParent();
-        }
-        return parent;
-    }
+
 }
 
-template<class Key, class Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+/**
+* Constructs the tree from the items in [first, last), in O(n) when the
+* keys are strictly increasing. See assign().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Iter>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(Iter first, Iter last, const Compare& comp) :
+    root_(nullptr),
+    leftmost_(nullptr),
+    rightmost_(nullptr),
+    comp_(comp)
 {
-    // TODO
-    if (current->getRight() != nullptr){
-        current = current->getRight();
-        while (current->getLeft() != nullptr){
-            current = current->getLeft();
+    assign(first, last);
+}
+
+/**
+* Copy constructor. The other tree's shape and subtree sizes are cloned
+* node by node in O(n), so nothing is compared or rebalanced.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const BinarySearchTree& other) :
+    root_(nullptr),
+    leftmost_(nullptr),
+    rightmost_(nullptr),
+    comp_(other.comp_)
+{
+    root_ = cloneTree<Node<Key, Value> >(other.root_, NoBalance());
+    resetEnds();
+}
+
+/**
+* Move constructor. Takes over the other tree's nodes and allocator in
+* O(1), leaving the other tree empty.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(BinarySearchTree&& other) :
+    root_(nullptr),
+    leftmost_(nullptr),
+    rightmost_(nullptr),
+    comp_(other.comp_)
+{
+    swap(other);
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::~BinarySearchTree()
+{
+    // TODO
+    clear();
+}
+
+/**
+* Copy assignment. The tree is cleared and then cloned from other through
+* copyNodes(), so the copies are of this tree's own node type. If copying
+* an item throws, the tree is left empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>&
+BinarySearchTree<Key, Value, Compare, Alloc>::operator=(const BinarySearchTree& other)
+{
+    if (this == &other) return *this;
+    clear();
+    comp_ = other.comp_;
+    root_ = copyNodes(other.root_);
+    resetEnds();
+    return *this;
+}
+
+/**
+* Move assignment. Frees this tree's nodes and takes over the other's in
+* O(1) apart from the clear, leaving the other tree empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>&
+BinarySearchTree<Key, Value, Compare, Alloc>::operator=(BinarySearchTree&& other)
+{
+    if (this == &other) return *this;
+    clear();
+    swap(other);
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees of the same kind in O(1). Nodes
+* never move, so iterators stay valid and now refer into the other tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::swap(BinarySearchTree& other)
+{
+    using std::swap;
+    swap(root_, other.root_);
+    swap(leftmost_, other.leftmost_);
+    swap(rightmost_, other.rightmost_);
+    swap(comp_, other.comp_);
+    alloc_.swap(other.alloc_);
+}
+
+/**
+* Exchanges the contents of two trees, as lhs.swap(rhs).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void swap(BinarySearchTree<Key, Value, Compare, Alloc>& lhs, BinarySearchTree<Key, Value, Compare, Alloc>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+ * Returns the number of items in the tree in O(1)
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::size() const
+{
+    return subtreeSize(root_);
+}
+
+/**
+ * Returns the most items a tree can hold: 2^32 - 1, since subtree sizes
+ * are stored in 32 bits
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::max_size() const
+{
+    return maxSize;
+}
+
+/**
+ * Returns a copy of the comparator that orders the keys
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Compare BinarySearchTree<Key, Value, Compare, Alloc>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an immutable copy of the tree laid out for fast lookups (see
+* frozen_tree.h), in O(n). Later changes to the tree do not affect it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+FrozenTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare, Alloc>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(cbegin(), cend(), comp_);
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::print() const
+{
+    printRoot(root_);
+    std::cout << "\n";
+}
+
+/**
+* Returns an iterator to the "smallest" item in the tree in O(1)
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::begin()
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator begin(getSmallestNode(), this);
+    return begin;
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::begin() const
+{
+    return const_iterator(getSmallestNode(), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::end()
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator end(NULL, this);
+    return end;
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::end() const
+{
+    return const_iterator(NULL, this);
+}
+
+/**
+* Read-only begin() and end() for trees that are not themselves const.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::cbegin() const
+{
+    return begin();
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns a reverse iterator to the "largest" item in the tree in O(1)
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rbegin()
+{
+    return reverse_iterator(end());
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+/**
+* Returns the reverse iterator past the "smallest" item
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rend()
+{
+    return reverse_iterator(begin());
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+/**
+* Read-only rbegin() and rend() for trees that are not themselves const.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::crbegin() const
+{
+    return rbegin();
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::crend() const
+{
+    return rend();
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const Key & k)
+{
+    Node<Key, Value> *curr = internalFind(k);
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator it(curr, this);
+    return it;
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const Key & k) const
+{
+    return const_iterator(internalFind(k), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than k,
+* or the end iterator if there is none.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const Key& k)
+{
+    return iterator(lowerBoundNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const Key& k) const
+{
+    return const_iterator(lowerBoundNode(k), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than k,
+* or the end iterator if there is none.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const Key& k)
+{
+    return iterator(upperBoundNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const Key& k) const
+{
+    return const_iterator(upperBoundNode(k), this);
+}
+
+/**
+* Returns the range of items with key k as [lower_bound(k), upper_bound(k)).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const Key& k)
+{
+    std::pair<Node<Key, Value>*, Node<Key, Value>*> range = equalRangeNodes(k);
+    return std::make_pair(iterator(range.first, this), iterator(range.second, this));
+}
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator, typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const Key& k) const
+{
+    std::pair<Node<Key, Value>*, Node<Key, Value>*> range = equalRangeNodes(k);
+    return std::make_pair(const_iterator(range.first, this), const_iterator(range.second, this));
+}
+
+/**
+* Heterogeneous find(), for a transparent Compare: looks up any key type the
+* comparator accepts, without building a Key.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const K& k)
+{
+    return iterator(findNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const K& k) const
+{
+    return const_iterator(findNode(k), this);
+}
+
+/**
+* Heterogeneous lower_bound(), for a transparent Compare.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const K& k)
+{
+    return iterator(lowerBoundNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const K& k) const
+{
+    return const_iterator(lowerBoundNode(k), this);
+}
+
+/**
+* Heterogeneous upper_bound(), for a transparent Compare.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const K& k)
+{
+    return iterator(upperBoundNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const K& k) const
+{
+    return const_iterator(upperBoundNode(k), this);
+}
+
+/**
+* Heterogeneous equal_range(), for a transparent Compare.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const K& k)
+{
+    std::pair<Node<Key, Value>*, Node<Key, Value>*> range = equalRangeNodes(k);
+    return std::make_pair(iterator(range.first, this), iterator(range.second, this));
+}
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator, typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const K& k) const
+{
+    std::pair<Node<Key, Value>*, Node<Key, Value>*> range = equalRangeNodes(k);
+    return std::make_pair(const_iterator(range.first, this), const_iterator(range.second, this));
+}
+
+/**
+* Looks up every key in [first, last) and writes an iterator to its item,
+* or end(), to out for each, in order; returns out past the last one. The
+* keys are searched for in batches, with several descents in flight at
+* once so that their cache misses overlap instead of each lookup stalling
+* on every node in turn.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InIter, typename OutIter>
+OutIter BinarySearchTree<Key, Value, Compare, Alloc>::find_batch(InIter first, InIter last, OutIter out)
+{
+    std::vector<Key> keys;
+    keys.reserve(findBatchSize);
+    while (first != last){
+        keys.clear();
+        for (; first != last && keys.size() < findBatchSize; ++first){
+            keys.push_back(*first);
+        }
+        out = findBatch<OutIter, iterator>(keys.data(), keys.size(), out);
+    }
+    return out;
+}
+
+/**
+* Const overload of find_batch(), writing const_iterators.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InIter, typename OutIter>
+OutIter BinarySearchTree<Key, Value, Compare, Alloc>::find_batch(InIter first, InIter last, OutIter out) const
+{
+    std::vector<Key> keys;
+    keys.reserve(findBatchSize);
+    while (first != last){
+        keys.clear();
+        for (; first != last && keys.size() < findBatchSize; ++first){
+            keys.push_back(*first);
+        }
+        out = findBatch<OutIter, const_iterator>(keys.data(), keys.size(), out);
+    }
+    return out;
+}
+
+/**
+* The node holding key k, or NULL. For scalar keys under std::less the
+* two calls per level inline to one machine comparison, so the descent
+* stops as soon as it meets k. Under any other Compare each call may cost
+* a real comparison, so the descent is lower_bound()'s, one comparison per
+* level plus one at the end.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::findNode(const K& k) const
+{
+    if (std::is_scalar<Key>::value && std::is_same<Compare, std::less<Key> >::value){
+        Node<Key, Value>* currNode = root_;
+        while (currNode != nullptr){
+            if (comp_(k, currNode->getKey())){
+                currNode = currNode->getLeft();
+            } else if (comp_(currNode->getKey(), k)){
+                currNode = currNode->getRight();
+            } else {
+                return currNode;
+            }
+        }
+        return nullptr;
+    }
+    Node<Key, Value>* bound = lowerBoundNode(k);
+    if (bound != nullptr && !comp_(k, bound->getKey())) return bound;
+    return nullptr;
+}
+
+/**
+* The node holding the first key not less than k, or NULL, in a single
+* descent with one comparison per level.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::lowerBoundNode(const K& k) const
+{
+    Node<Key, Value>* bound = nullptr;
+    Node<Key, Value>* currNode = root_;
+    while (currNode != nullptr){
+        if (comp_(currNode->getKey(), k)){
+            currNode = currNode->getRight();
+        } else {
+            bound = currNode;
+            currNode = currNode->getLeft();
+        }
+    }
+    return bound;
+}
+
+/**
+* The node holding the first key greater than k, or NULL, in a single
+* descent with one comparison per level.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::upperBoundNode(const K& k) const
+{
+    Node<Key, Value>* bound = nullptr;
+    Node<Key, Value>* currNode = root_;
+    while (currNode != nullptr){
+        if (comp_(k, currNode->getKey())){
+            bound = currNode;
+            currNode = currNode->getLeft();
+        } else {
+            currNode = currNode->getRight();
+        }
+    }
+    return bound;
+}
+
+/**
+* The nodes bounding the items with key k. Keys are unique, so the range
+* is empty or just the lower bound and its successor.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K>
+std::pair<Node<Key, Value>*, Node<Key, Value>*>
+BinarySearchTree<Key, Value, Compare, Alloc>::equalRangeNodes(const K& k) const
+{
+    Node<Key, Value>* bound = lowerBoundNode(k);
+    if (bound != nullptr && !comp_(k, bound->getKey())){
+        return std::make_pair(bound, successor(bound));
+    }
+    return std::make_pair(bound, bound);
+}
+
+/**
+* Finds one gathered batch of keys for find_batch() and writes an Iterator
+* for each to out.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename OutIter, typename Iterator>
+OutIter BinarySearchTree<Key, Value, Compare, Alloc>::findBatch(const Key* keys, std::size_t count, OutIter out) const
+{
+    Node<Key, Value>* found[findBatchSize];
+    findNodes(keys, count, found);
+    for (std::size_t j = 0; j < count; ++j){
+        *out = Iterator(found[j], this);
+        ++out;
+    }
+    return out;
+}
+
+/**
+* Finds the nodes holding count keys, writing NULL for each key that is
+* absent. The keys go down in groups, each step of the group's descents
+* taken in turn: a descent's next node is prefetched as soon as it is
+* known and only read once every other descent has taken its step, so
+* up to a group's worth of cache misses are outstanding at once. Each
+* descent is lower_bound()'s, one comparison per level.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::findNodes(const Key* keys, std::size_t count, Node<Key, Value>** found) const
+{
+    Node<Key, Value>* current[findBatchGroup];
+    for (std::size_t base = 0; base < count; base += findBatchGroup){
+        std::size_t group = count - base < findBatchGroup ? count - base : findBatchGroup;
+        Node<Key, Value>** bound = found + base;
+        for (std::size_t j = 0; j < group; ++j){
+            current[j] = root_;
+            bound[j] = nullptr;
+        }
+        for (bool descending = root_ != nullptr; descending; ){
+            descending = false;
+            for (std::size_t j = 0; j < group; ++j){
+                Node<Key, Value>* node = current[j];
+                if (node == nullptr) continue;
+                if (comp_(node->getKey(), keys[base + j])){
+                    node = node->getRight();
+                } else {
+                    bound[j] = node;
+                    node = node->getLeft();
+                }
+#if defined(__GNUC__)
+                if (node != nullptr) __builtin_prefetch(node);
+#endif
+                current[j] = node;
+                descending = true;
+            }
+        }
+        for (std::size_t j = 0; j < group; ++j){
+            if (bound[j] != nullptr && comp_(keys[base + j], bound[j]->getKey())) bound[j] = nullptr;
+        }
+    }
+}
+
+/**
+* Returns the number of keys in the tree less than key, in O(height).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::rank(const Key& key) const
+{
+    std::size_t less = 0;
+    Node<Key, Value>* currNode = root_;
+    while (currNode != nullptr){
+        if (comp_(currNode->getKey(), key)){
+            less += subtreeSize(currNode->getLeft()) + 1;
+            currNode = currNode->getRight();
+        } else {
+            currNode = currNode->getLeft();
+        }
+    }
+    return less;
+}
+
+/**
+* Returns an iterator to the item with the k-th smallest key (counting
+* from 0), or the end iterator if k >= size(), in O(height).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::select(std::size_t k)
+{
+    return iterator(selectNode(k), this);
+}
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::select(std::size_t k) const
+{
+    return const_iterator(selectNode(k), this);
+}
+
+/**
+* The node holding the k-th smallest key, or NULL if k >= size().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::selectNode(std::size_t k) const
+{
+    Node<Key, Value>* currNode = root_;
+    while (currNode != nullptr){
+        std::size_t leftSize = subtreeSize(currNode->getLeft());
+        if (k < leftSize){
+            currNode = currNode->getLeft();
+        } else if (k == leftSize){
+            break;
+        } else {
+            k -= leftSize + 1;
+            currNode = currNode->getRight();
+        }
+    }
+    return currNode;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare, class Alloc>
+Value const & BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    // TODO
+    insertFrom(root_, keyValuePair);
+}
+
+/**
+* Inserts (or overwrites) by moving out of the pair, so a large key or value
+* is never copied, whether it goes into a new node or over an old value.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+    std::pair<Node<Key, Value>*, bool> result = insertItem(root_, std::move(keyValuePair));
+    if (!result.second) result.first->setValue(std::move(keyValuePair.second));
+}
+
+/**
+* Inserts (or overwrites) from any other pair the item can be built from,
+* such as std::make_pair of convertible types, moving what it can.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Pair>
+typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(Pair&& keyValuePair)
+{
+    insert(std::pair<Key, Value>(std::forward<Pair>(keyValuePair)));
+}
+
+/**
+* Constructs an item from args and moves it into a new node, unless its key
+* is already present, in which case the tree is unchanged (as with
+* std::map::emplace, and unlike insert()). Returns the item with the key
+* and whether it was inserted.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::emplace(Args&&... args)
+{
+    std::pair<Node<Key, Value>*, bool> result =
+        insertItem(root_, std::pair<Key, Value>(std::forward<Args>(args)...));
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+
+/**
+* Inserts key with a value constructed from args if key is not present.
+* Nothing at all is constructed when it is, and args are left untouched.
+* Returns the item with the key and whether it was inserted.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(const Key& key, Args&&... args)
+{
+    Node<Key, Value>* parent;
+    bool left;
+    Node<Key, Value>* found = findInsertPosition(root_, key, parent, left);
+    if (found != nullptr) return std::make_pair(iterator(found, this), false);
+    Node<Key, Value>* leaf;
+    try {
+        leaf = createLeaf(parent, std::pair<Key, Value>(std::piecewise_construct,
+            std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...)));
+    } catch (...) {
+        updateSizes(parent, -1);
+        throw;
+    }
+    attachLeaf(parent, left, leaf);
+    return std::make_pair(iterator(leaf, this), true);
+}
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(Key&& key, Args&&... args)
+{
+    Node<Key, Value>* parent;
+    bool left;
+    Node<Key, Value>* found = findInsertPosition(root_, key, parent, left);
+    if (found != nullptr) return std::make_pair(iterator(found, this), false);
+    Node<Key, Value>* leaf;
+    try {
+        leaf = createLeaf(parent, std::pair<Key, Value>(std::piecewise_construct,
+            std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...)));
+    } catch (...) {
+        updateSizes(parent, -1);
+        throw;
+    }
+    attachLeaf(parent, left, leaf);
+    return std::make_pair(iterator(leaf, this), true);
+}
+
+/**
+* Inserts every item in [first, last). The batch is sorted by key and
+* inserted in that order, each descent starting from the lowest subtree
+* around the node placed by the previous one whose key range covers the
+* new key, instead of from the root (see insertFrom). A key above every
+* key in the tree starts from the largest node. So a batch of m items
+* costs O(m log(n/m + 1)) comparisons rather than O(m log n) and touches
+* the tree left to right; each new node still adds one to the subtree size
+* of every ancestor. The sort is stable, so a key that appears more than
+* once ends up with its last value, as with insert(). Items are moved out
+* of the sorted copy of the batch into the nodes.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Iter>
+void BinarySearchTree<Key, Value, Compare, Alloc>::insert_batch(Iter first, Iter last)
+{
+    std::vector<std::pair<Key, Value> > batch(first, last);
+    std::stable_sort(batch.begin(), batch.end(), KeyLess<Compare>(comp_));
+    Node<Key, Value>* finger = nullptr;
+    for (std::size_t i = 0; i < batch.size(); ++i){
+        Node<Key, Value>* start = root_;
+        if (finger != nullptr){
+            start = comp_(rightmost_->getKey(), batch[i].first) ? rightmost_ : coveringSubtree(finger, batch[i].first);
+        }
+        finger = insertFrom(start, std::move(batch[i]));
+    }
+}
+
+/**
+* Returns the lowest subtree containing node whose key range covers key,
+* which must not sort before node's key. The range of a subtree is bounded
+* above by the nearest ancestor it hangs to the left of: right links are
+* climbed to find it, and if it sorts after key the subtree covers key;
+* otherwise the climb goes on from that ancestor. A subtree with no such
+* ancestor lies on the right spine and is unbounded.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::coveringSubtree(Node<Key, Value>* node, const Key& key) const
+{
+    while (true){
+        Node<Key, Value>* child = node;
+        while (child->getParent() != nullptr && child->getParent()->getRight() == child){
+            child = child->getParent();
+        }
+        Node<Key, Value>* bound = child->getParent();
+        if (bound == nullptr || comp_(key, bound->getKey())) return node;
+        node = bound;
+    }
+}
+
+/**
+* Inserts (or overwrites) the item by descending from start, which must be
+* the root of a subtree whose key range covers the item's key, and returns
+* the node now holding the key. The item is copied from an lvalue and moved
+* from an rvalue.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Item>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::insertFrom(Node<Key, Value>* start, Item&& keyValuePair)
+{
+    std::pair<Node<Key, Value>*, bool> result = insertItem(start, std::forward<Item>(keyValuePair));
+    // A new node took the item; an existing one only needs the value, which insertItem left alone.
+    if (!result.second) result.first->setValue(std::forward<Item>(keyValuePair).second); /* No duplicate keys in a BST. */
+    return result.first;
+}
+
+/**
+* Descends from start, which must be the root of a subtree whose key range
+* covers key, to the node holding key and returns it. If there is none,
+* returns NULL and sets parent and left to where a new leaf for key goes.
+* Like lowerBoundNode() it makes one comparison per level, remembering the
+* last node it went right from, and only checks that node for equality at
+* the bottom. A new leaf is counted into the size of every subtree on its
+* path as the descent goes, so attachLeaf() has nothing left to walk;
+* whoever then fails to attach one must take it back out with
+* updateSizes(parent, -1). Throws std::length_error, before changing
+* anything, if the tree is full and key is not in it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::findInsertPosition(Node<Key, Value>* start, const Key& key,
+                                                                                  Node<Key, Value>*& parent, bool& left)
+{
+    parent = nullptr;
+    left = false;
+    if (empty()) return nullptr;
+    if (subtreeSize(root_) >= maxSize){
+        Node<Key, Value>* bound = lowerBoundNode(key);
+        if (bound == nullptr || comp_(key, bound->getKey())) throw std::length_error("BinarySearchTree: too many items");
+    }
+    Node<Key, Value>* notGreater = nullptr;
+    Node<Key, Value>* currNode = start;
+    while (currNode != nullptr){
+        currNode->updateSize(1);
+        parent = currNode;
+        left = comp_(key, currNode->getKey());
+        if (left){
+            currNode = currNode->getLeft();
+        } else {
+            notGreater = currNode;
+            currNode = currNode->getRight();
+        }
+    }
+    if (notGreater != nullptr && !comp_(notGreater->getKey(), key)){ /* No duplicate keys in a BST. */
+        // Undo the size increments made on the way down.
+        for (Node<Key, Value>* n = parent; n != start->getParent(); n = n->getParent()){
+            n->updateSize(-1);
+        }
+        return notGreater;
+    }
+    updateSizes(start->getParent(), 1);
+    return nullptr;
+}
+
+/**
+* Links a new leaf in where findInsertPosition() said it goes, then lets
+* the tree rebalance.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::attachLeaf(Node<Key, Value>* parent, bool left, Node<Key, Value>* leaf)
+{
+    if (parent == nullptr){
+        root_ = leaf;
+    } else if (left){
+        parent->setLeft(leaf);
+    } else {
+        parent->setRight(leaf);
+    }
+    updateEndsAfterInsert(leaf);
+    balanceAfterInsert(leaf);
+}
+
+/**
+* Looks the item's key up from start and, only if it is missing, links in a
+* new node holding the item (copied from an lvalue, moved from an rvalue).
+* Returns the node holding the key and whether it is the new one.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Item>
+std::pair<Node<Key, Value>*, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insertItem(Node<Key, Value>* start, Item&& item)
+{
+    Node<Key, Value>* parent;
+    bool left;
+    Node<Key, Value>* found = findInsertPosition(start, item.first, parent, left);
+    if (found != nullptr) return std::make_pair(found, false);
+    Node<Key, Value>* leaf;
+    try {
+        leaf = createLeaf(parent, std::forward<Item>(item));
+    } catch (...) {
+        updateSizes(parent, -1);
+        throw;
+    }
+    attachLeaf(parent, left, leaf);
+    return std::make_pair(leaf, true);
+}
+
+/**
+* Creates the node for a new leaf below parent, holding a copy of item.
+* Trees with their own node type override both versions.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::createLeaf(Node<Key, Value>* parent, const std::pair<const Key, Value>& item)
+{
+    return createNode<Node<Key, Value> >(parent, item);
+}
+
+/**
+* Creates the node for a new leaf below parent, moving item into it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::createLeaf(Node<Key, Value>* parent, std::pair<Key, Value>&& item)
+{
+    return createNode<Node<Key, Value> >(parent, std::move(item));
+}
+
+/**
+* Called once a new leaf is linked in. A plain BST does not rebalance.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::balanceAfterInsert(Node<Key, Value>* leaf)
+{
+
+}
+
+
+/**
+* A remove method to remove a specific key from a Binary Search Tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    // TODO
+    Node<Key, Value>* nodeToRemove = internalFind(key);
+    if (!empty() && nodeToRemove != nullptr){
+        updateEndsBeforeRemove(nodeToRemove);
+        if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() != nullptr) { // Node has 2 children
+            nodeSwap(nodeToRemove, predecessor(nodeToRemove)); // Swap values
+        }
+        if (nodeToRemove->getLeft() != nullptr && nodeToRemove->getRight() == nullptr) { // Node has left child only
+            if (nodeToRemove->getParent() != nullptr){ // Node is not the root
+                (nodeToRemove->getLeft())->setParent(nodeToRemove->getParent()); // Promote left child
+                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
+                    (nodeToRemove->getParent())->setLeft(nodeToRemove->getLeft());
+                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
+                    (nodeToRemove->getParent())->setRight(nodeToRemove->getLeft());
+                }
+            } else { // Node is the root
+                root_ = nodeToRemove->getLeft();
+                (nodeToRemove->getLeft())->setParent(nullptr);
+            }
+        } else if (nodeToRemove->getLeft() == nullptr && nodeToRemove->getRight() != nullptr) { // Node has right child only
+            if (nodeToRemove->getParent() != nullptr){ // Node is not the root
+                (nodeToRemove->getRight())->setParent(nodeToRemove->getParent()); // Promote right child
+                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
+                    (nodeToRemove->getParent())->setLeft(nodeToRemove->getRight());
+                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
+                    (nodeToRemove->getParent())->setRight(nodeToRemove->getRight());
+                }
+            } else { // Node is the root
+                root_ = nodeToRemove->getRight();
+                (nodeToRemove->getRight())->setParent(nullptr);
+            }
+        } else {
+            if (nodeToRemove == root_) {
+                destroyNode(nodeToRemove);
+                root_ = nullptr;
+                return;
+            } else {
+                if ((nodeToRemove->getParent())->getLeft() == nodeToRemove){ // Node is a parent's left child
+                    (nodeToRemove->getParent())->setLeft(nullptr);
+                } else if ((nodeToRemove->getParent())->getRight() == nodeToRemove){ // Node is a parent's right child
+                    (nodeToRemove->getParent())->setRight(nullptr);
+                }
+            }
+        }
+        updateSizes(nodeToRemove->getParent(), -1);
+        destroyNode(nodeToRemove);
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(Node<Key, Value>* current)
+{
+    // TODO
+    if (current->getLeft() != nullptr){
+        current = current->getLeft();
+        while (current->getRight() != nullptr){
+            current = current->getRight();
+        }
+        return current;
+    } else {
+        Node<Key, Value>* parent = current->getParent();
+        while (parent != nullptr && current != current->getParent()->getRight()){
+            current = parent;
+            parent = parent->getParent();
+        }
+        return parent;
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::successor(Node<Key, Value>* current)
+{
+    // TODO
+    if (current->getRight() != nullptr){
+        current = current->getRight();
+        while (current->getLeft() != nullptr){
+            current = current->getLeft();
         }
         return current;
     } else {
@@ -582,38 +1919,303 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* When the allocator can drop every node at once and the nodes have nothing
+* to destroy, the tree is never walked.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::clear()
 {
     // TODO
-    BinarySearchTree::clearTree(root_);
+    if (!(alloc_.releasesAll() && std::is_trivially_destructible<Key>::value
+            && std::is_trivially_destructible<Value>::value)){
+        clearTree(root_);
+    }
+    alloc_.release();
     root_ = nullptr;
+    leftmost_ = rightmost_ = nullptr;
 }
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearTree(Node<Key, Value>* root){
-    if (root == nullptr) return;
-    clearTree(root->getLeft());
-    clearTree(root->getRight());
-    delete root;
+
+/**
+* Destroys every node of the subtree at root in postorder, without
+* recursion or a stack: the walk goes down to a leaf, unhooks and destroys
+* it, and climbs back to its parent, which is a leaf or has one child fewer
+* next time. Each link is followed at most twice, so any shape, including
+* the list an unbalanced tree becomes on sorted input, takes O(n) time and
+* O(1) extra space. The parent of root, if any, is left untouched.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::clearTree(Node<Key, Value>* root){
+    Node<Key, Value>* node = root;
+    while (node != nullptr){
+        if (node->getLeft() != nullptr){
+            node = node->getLeft();
+        } else if (node->getRight() != nullptr){
+            node = node->getRight();
+        } else {
+            Node<Key, Value>* parent = nullptr;
+            if (node != root){
+                parent = node->getParent();
+                if (parent->getLeft() == node) parent->setLeft(nullptr);
+                else parent->setRight(nullptr);
+            }
+            destroyNode(node);
+            node = parent;
+        }
+    }
+}
+
+/**
+* Replaces the contents of the tree with the items in [first, last).
+* If the keys are strictly increasing the tree is built directly in
+* perfectly balanced shape in O(n); otherwise the items are inserted one
+* at a time, so later duplicates overwrite earlier ones as with insert().
+* Sorted input over max_size() items throws std::length_error before the
+* tree is cleared; unsorted input throws once the tree is full.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename Iter>
+void BinarySearchTree<Key, Value, Compare, Alloc>::assign(Iter first, Iter last)
+{
+    std::size_t size = 0;
+    bool sorted = sortedRange(first, last, size);
+    if (sorted && size > maxSize) throw std::length_error("BinarySearchTree: too many items");
+    clear();
+    if (sorted){
+        root_ = buildSorted<Node<Key, Value> >(first, size, NoBalance());
+        resetEnds();
+    } else {
+        for (; first != last; ++first){
+            insert(*first);
+        }
+    }
+}
+
+/**
+* Counts the items in [first, last) and returns true iff their keys are
+* strictly increasing.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename Iter>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::sortedRange(Iter first, Iter last, std::size_t& size) const
+{
+    size = 0;
+    if (first == last) return true;
+    Iter prev = first;
+    for (++first, ++size; first != last; ++first, ++size){
+        if (!comp_(prev->first, first->first)) return false;
+        prev = first;
+    }
+    return true;
 }
 
+/**
+* The height of a subtree of the given size built by buildSorted().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int BinarySearchTree<Key, Value, Compare, Alloc>::builtHeight(std::size_t size)
+{
+    int height = 0;
+    for (; size != 0; size >>= 1){
+        ++height;
+    }
+    return height;
+}
 
+/**
+* Builds a perfectly balanced subtree from the next size items of a sorted
+* range, creating nodes in key order and advancing first past them. The
+* left half always gets the extra node, so visit(node, balance) is told each
+* node's height difference (0 or -1) without ever measuring a subtree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename Iter, typename Visit>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::buildSorted(Iter& first, std::size_t size, Visit visit)
+{
+    if (size == 0) return nullptr;
+    std::size_t leftSize = size / 2;
+    std::size_t rightSize = size - 1 - leftSize;
+    NodeType* left = buildSorted<NodeType>(first, leftSize, visit);
+    NodeType* node = createNode<NodeType>(static_cast<NodeType*>(nullptr), first->first, first->second);
+    ++first;
+    NodeType* right = buildSorted<NodeType>(first, rightSize, visit);
+    node->setLeft(left);
+    node->setRight(right);
+    node->setSize(size);
+    if (left != nullptr) left->setParent(node);
+    if (right != nullptr) right->setParent(node);
+    visit(node, builtHeight(rightSize) - builtHeight(leftSize));
+    return node;
+}
 
 /**
-* A helper function to find the smallest node in the tree.
+* Returns a copy of the subtree at root made of this tree's node type.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::copyNodes(const Node<Key, Value>* root)
+{
+    return cloneTree<Node<Key, Value> >(root, NoBalance());
+}
+
+/**
+* Copies the subtree at root into nodes from this tree's allocator, keeping
+* every link and subtree size and passing each new node to visit(node, from)
+* with the node it copies. The source is walked in preorder through parent
+* links rather than recursion, so degenerate trees cannot exhaust the stack,
+* and the copies come out of the allocator in preorder too. If an item
+* throws while being copied, the partial copy is freed before rethrowing.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename Visit>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::cloneTree(const NodeType* root, Visit visit)
+{
+    if (root == nullptr) return nullptr;
+    NodeType* copy = createNode<NodeType>(static_cast<NodeType*>(nullptr), root->getItem());
+    copy->setSize(root->getSize());
+    visit(copy, root);
+    try {
+        const NodeType* from = root;
+        NodeType* to = copy;
+        while (true){
+            const NodeType* next = nullptr;
+            bool left = false;
+            if (from->getLeft() != nullptr && to->getLeft() == nullptr){
+                next = from->getLeft();
+                left = true;
+            } else if (from->getRight() != nullptr && to->getRight() == nullptr){
+                next = from->getRight();
+            }
+            if (next == nullptr){
+                if (from == root) break;
+                from = from->getParent();
+                to = to->getParent();
+                continue;
+            }
+            NodeType* child = createNode<NodeType>(to, next->getItem());
+            child->setSize(next->getSize());
+            visit(child, next);
+            if (left) to->setLeft(child);
+            else to->setRight(child);
+            from = next;
+            to = child;
+        }
+    } catch (...) {
+        clearTree(copy);
+        throw;
+    }
+    return copy;
+}
+
+/**
+* Constructs a node of the given type in storage from the tree's allocator,
+* building its item from args.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename... Args>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::createNode(NodeType* parent, Args&&... args)
+{
+    void* slot = alloc_.allocate(sizeof(NodeType), alignof(NodeType));
+    try {
+        return new (slot) NodeType(parent, std::forward<Args>(args)...);
+    } catch (...) {
+        alloc_.deallocate(slot, sizeof(NodeType));
+        throw;
+    }
+}
+
+/**
+* Destroys a node made by createNode and returns its storage to the allocator.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroyNode(Node<Key, Value>* node)
+{
+    node->~Node();
+    alloc_.deallocate(node, sizeof(Node<Key, Value>));
+}
+
+
+
+/**
+* The number of nodes in a subtree, 0 for an empty one.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t BinarySearchTree<Key, Value, Compare, Alloc>::subtreeSize(Node<Key, Value>* node)
+{
+    return node == nullptr ? 0 : node->getSize();
+}
+
+/**
+* Adds diff to the subtree size of node and every ancestor above it,
+* after a node has been linked into or unlinked from below node.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::updateSizes(Node<Key, Value>* node, long diff)
+{
+    for (; node != nullptr; node = node->getParent()){
+        node->updateSize(diff);
+    }
+}
+
+/**
+* Records a node just linked in as a leaf if it became the smallest or
+* largest key: a new leaf is only ever a new end when it hangs off the
+* old one on the outer side.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::updateEndsAfterInsert(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    if (parent == nullptr){
+        leftmost_ = rightmost_ = node;
+    } else if (parent == leftmost_ && parent->getLeft() == node){
+        leftmost_ = node;
+    } else if (parent == rightmost_ && parent->getRight() == node){
+        rightmost_ = node;
+    }
+}
+
+/**
+* Moves the cached ends off a node that is about to be unlinked. Must run
+* while the node is still in the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::updateEndsBeforeRemove(Node<Key, Value>* node)
+{
+    if (node == leftmost_) leftmost_ = successor(node);
+    if (node == rightmost_) rightmost_ = predecessor(node);
+}
+
+/**
+* Finds both ends again by descending from the root, after the tree has
+* been rebuilt wholesale (assign, split, join).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::resetEnds()
+{
+    leftmost_ = rightmost_ = root_;
+    if (root_ == nullptr) return;
+    while (leftmost_->getLeft() != nullptr) leftmost_ = leftmost_->getLeft();
+    while (rightmost_->getRight() != nullptr) rightmost_ = rightmost_->getRight();
+}
+
+/**
+* A helper function to find the smallest node in the tree, in O(1).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare, Alloc>::getSmallestNode() const
 {
     // TODO
-    if (empty()) return nullptr;
-    Node<Key, Value>* smallest = root_;
-    while (predecessor(smallest) != nullptr){
-        smallest = predecessor(smallest);
-    }
-    return smallest;
+    return leftmost_;
+}
+
+/**
+* A helper function to find the largest node in the tree, in O(1).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare, Alloc>::getLargestNode() const
+{
+    return rightmost_;
 }
 
 /**
@@ -621,56 +2223,114 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::internalFind(const Key& key) const
 {
     // TODO
-    if (empty()) return nullptr;
-    Node<Key, Value>* currNode = root_;
-    while (currNode != nullptr){
-        if (currNode->getKey() == key) {
-            return currNode;
-        } else if (key > currNode->getKey()){
-            if (currNode->getRight() == nullptr) break;
-            currNode = currNode->getRight();
-        } else {
-            if (currNode->getLeft() == nullptr) break;
-            currNode = currNode->getLeft();
-        }
-    }
-    return nullptr;
+    return findNode(key);
 }
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isBalanced() const
 {
     // TODO
-    bool balanced = true;
-    BinarySearchTree<Key, Value>::processLeaves(root_, balanced);
-    return balanced;
+    return checkTree(false);
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::processLeaves(Node<Key, Value>* root, bool& l){
-    if (root == nullptr){
-        return 0;
-    }
-    int rootL = processLeaves(root->getLeft(), l);
-    int rootR = processLeaves(root->getRight(), l);
-    if (abs(rootL - rootR) > 1){
-        l = false;
+/**
+* Returns true iff the tree satisfies every invariant it maintains: keys
+* strictly increasing in order, consistent parent links, correct subtree
+* sizes and cached ends, and whatever checkNode() adds for the node type.
+* Takes one O(n) pass without recursion and stops at the first violation,
+* so it is cheap enough for assert() in debug builds.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isValid() const
+{
+    if (!checkTree(true)) return false;
+    if (root_ == nullptr) return leftmost_ == nullptr && rightmost_ == nullptr;
+    const Node<Key, Value>* smallest = root_;
+    const Node<Key, Value>* largest = root_;
+    while (smallest->getLeft() != nullptr) smallest = smallest->getLeft();
+    while (largest->getRight() != nullptr) largest = largest->getRight();
+    return leftmost_ == smallest && rightmost_ == largest;
+}
+
+/**
+* Walks the whole tree once in postorder, measuring every subtree's
+* height on the way back up, and returns false at the first bad node.
+* Every link is checked against its parent pointer before it is followed.
+* With full set, keys must increase in order and checkNode() must accept
+* every node; otherwise every node just has to be height-balanced. The
+* pending nodes are kept on a vector rather than the call stack, so the
+* list a degenerate tree becomes costs heap, not stack.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::checkTree(bool full) const
+{
+    // leftHeight stays -1 until the node's left subtree has been walked.
+    struct Pending
+    {
+        const Node<Key, Value>* node;
+        int leftHeight;
+    };
+    if (root_ != nullptr && root_->getParent() != nullptr) return false;
+    std::vector<Pending> path;
+    const Node<Key, Value>* previous = nullptr;    // the last node in key order
+    const Node<Key, Value>* node = root_;
+    while (true){
+        for (; node != nullptr; node = node->getLeft()){
+            if (node->getLeft() != nullptr && node->getLeft()->getParent() != node) return false;
+            Pending pending = { node, -1 };
+            path.push_back(pending);
+        }
+        int height = 0;    // of the subtree just walked
+        while (node == nullptr){
+            if (path.empty()) return true;
+            Pending& top = path.back();
+            if (top.leftHeight < 0){
+                top.leftHeight = height;
+                if (full){
+                    if (previous != nullptr && !comp_(previous->getKey(), top.node->getKey())) return false;
+                    previous = top.node;
+                }
+                node = top.node->getRight();
+                if (node != nullptr){
+                    if (node->getParent() != top.node) return false;
+                    break;
+                }
+                height = 0;
+            }
+            if (full ? !checkNode(top.node, top.leftHeight, height) : std::abs(height - top.leftHeight) > 1){
+                return false;
+            }
+            height = 1 + std::max(top.leftHeight, height);
+            path.pop_back();
+        }
     }
-    return std::max(rootL, rootR) + 1;
+}
+
+/**
+* Checks the invariants held by a single node, given the heights of its
+* subtrees: here, that its size counts both subtrees and itself.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::checkNode(const Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    std::size_t size = 1;
+    if (node->getLeft() != nullptr) size += node->getLeft()->getSize();
+    if (node->getRight() != nullptr) size += node->getRight()->getSize();
+    return node->getSize() == size;
 }
 
 
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -751,6 +2411,11 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
         this->root_ = n1;
     }
 
+    // Subtree sizes belong to the positions, which the nodes just traded.
+    std::size_t tempSize = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempSize);
+
 }
 
 /**
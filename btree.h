@@ -0,0 +1,1884 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "node_pool.h"
+#include "frozen_tree.h"
+
+/**
+* A templated B+ tree with the interface of BinarySearchTree, for workloads
+* where a pointer chase per key comparison costs more than the comparison.
+* Every item lives in a leaf of up to Fanout items, stored contiguously as
+* std::pair<const Key, Value> so iterators dereference exactly as they do
+* for the binary trees; the inner nodes hold up to Fanout children and the
+* Fanout - 1 separator keys between them, so a lookup touches about
+* log(n) / log(Fanout) nodes instead of log2(n). The leaves are chained in
+* key order, which makes iteration and range scans sequential.
+*
+* Leaves and inner nodes are obtained from two separate Alloc instances
+* (see node_pool.h), one per node size. Inserting or removing moves the
+* items after the position within their leaf, and splitting or merging a
+* leaf moves half of it, so moving an item (which copies its const key)
+* should not throw; with that, an insert that throws leaves the tree as it
+* was.
+*/
+template <typename Key, typename Value, std::size_t Fanout = 16, typename Compare = std::less<Key>, typename Alloc = NodePool>
+class BTree
+{
+    static_assert(Fanout >= 4, "a B-tree node needs room for at least four children");
+
+public:
+    BTree();
+    explicit BTree(const Compare& comp);
+    template<typename Iter>
+    BTree(Iter first, Iter last, const Compare& comp = Compare());
+    BTree(const BTree& other);
+    BTree(BTree&& other);
+    ~BTree();
+    BTree& operator=(const BTree& other);
+    BTree& operator=(BTree&& other);
+    void swap(BTree& other);
+    template<typename Iter>
+    void assign(Iter first, Iter last);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    template<typename Pair>
+    typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+    insert(Pair&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isValid() const;
+    bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+
+private:
+    struct InnerNode;
+
+    /**
+    * The fields shared by leaves and inner nodes. count is the number of
+    * items in a leaf and the number of separator keys in an inner node,
+    * which has one child more.
+    */
+    struct NodeBase
+    {
+        explicit NodeBase(bool isLeaf) : parent(nullptr), count(0), leaf(isLeaf) { }
+
+        InnerNode* parent;
+        std::uint32_t count;
+        bool leaf;
+    };
+
+    struct LeafNode : NodeBase
+    {
+        LeafNode() : NodeBase(true), prev(nullptr), next(nullptr) { }
+
+        std::pair<const Key, Value>* items() { return reinterpret_cast<std::pair<const Key, Value>*>(slots); }
+        const std::pair<const Key, Value>* items() const { return reinterpret_cast<const std::pair<const Key, Value>*>(slots); }
+
+        LeafNode* prev;
+        LeafNode* next;
+        typename std::aligned_storage<sizeof(std::pair<const Key, Value>), alignof(std::pair<const Key, Value>)>::type slots[Fanout];
+    };
+
+    /**
+    * An inner node has room for one separator and one child more than it
+    * may keep, so that a full node takes the separator of a child that
+    * split before splitting itself.
+    */
+    struct InnerNode : NodeBase
+    {
+        InnerNode() : NodeBase(false) { }
+
+        Key* keys() { return reinterpret_cast<Key*>(slots); }
+        const Key* keys() const { return reinterpret_cast<const Key*>(slots); }
+
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type slots[Fanout];
+        NodeBase* children[Fanout + 1];
+    };
+
+public:
+    class const_iterator;
+
+    /**
+    * A bidirectional iterator over the items in key order: a leaf and a
+    * position within it. Stepping back from end() lands on the largest
+    * item, which is why an iterator remembers the tree it came from.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    private:
+        friend class BTree<Key, Value, Fanout, Compare, Alloc>;
+        friend class const_iterator;
+        iterator(LeafNode* leaf, std::size_t index, const BTree<Key, Value, Fanout, Compare, Alloc>* tree);
+        LeafNode* leaf_;    // nullptr for end()
+        std::size_t index_;
+        const BTree<Key, Value, Fanout, Compare, Alloc>* tree_;
+    };
+
+    /**
+    * The read-only counterpart of iterator, handed out by const trees.
+    * Any iterator converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    private:
+        friend class BTree<Key, Value, Fanout, Compare, Alloc>;
+        const_iterator(LeafNode* leaf, std::size_t index, const BTree<Key, Value, Fanout, Compare, Alloc>* tree);
+        LeafNode* leaf_;
+        std::size_t index_;
+        const BTree<Key, Value, Fanout, Compare, Alloc>* tree_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+public:
+    iterator begin();
+    const_iterator begin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const;
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+private:
+    /**
+    * The fewest items a leaf and the fewest separators an inner node may
+    * keep, other than the root: what the smaller half of a split gets.
+    */
+    static const std::size_t minLeafItems = Fanout / 2;
+    static const std::size_t minInnerKeys = (Fanout - 1) / 2;
+
+    /**
+    * A bound on the height, and so on the nodes one insert can split: every
+    * node but the root has at least two children.
+    */
+    static const std::size_t maxHeight = 64;
+
+    template<typename K>
+    std::size_t lowerBoundIn(const LeafNode* leaf, const K& key) const;
+    template<typename K>
+    std::size_t upperBoundIn(const LeafNode* leaf, const K& key) const;
+    template<typename K>
+    std::size_t childIndex(const InnerNode* node, const K& key) const;
+    template<typename K>
+    LeafNode* findLeaf(const K& key) const;
+    template<typename K>
+    std::pair<LeafNode*, std::size_t> findPosition(const K& key) const;
+    template<typename K>
+    std::pair<LeafNode*, std::size_t> lowerBoundPosition(const K& key) const;
+    template<typename K>
+    std::pair<LeafNode*, std::size_t> upperBoundPosition(const K& key) const;
+    static std::pair<LeafNode*, std::size_t> normalize(LeafNode* leaf, std::size_t index);
+    template<typename... Args>
+    std::pair<iterator, bool> insertUnique(const Key& key, Args&&... args);
+    template<typename... Args>
+    void insertIntoLeaf(LeafNode* leaf, std::size_t index, Args&&... args);
+    void splitLeaf(LeafNode* leaf, LeafNode* right, Key* separator, InnerNode** spares);
+    void insertSeparator(NodeBase* left, Key* separator, NodeBase* right, InnerNode** spares);
+    void rebalanceLeaf(LeafNode* leaf);
+    void rebalanceInner(InnerNode* node);
+    static void eraseChild(InnerNode* node, std::size_t index);
+    static std::size_t childPosition(const InnerNode* parent, const NodeBase* child);
+    static const Key& smallestKey(const NodeBase* node);
+    template<typename T>
+    static void relocate(T* from, std::size_t count, T* to);
+    LeafNode* createLeafNode();
+    InnerNode* createInnerNode();
+    void destroyLeafNode(LeafNode* leaf);
+    void destroyInnerNode(InnerNode* node);
+    void clearNodes(NodeBase* root);
+    template<typename Iter>
+    bool sortedRange(Iter first, Iter last, std::size_t& size) const;
+    template<typename Iter>
+    void buildSorted(Iter first, std::size_t size);
+
+    NodeBase* root_;
+    LeafNode* head_;    // leftmost leaf, holding the smallest key
+    LeafNode* tail_;    // rightmost leaf
+    std::size_t size_;
+    Compare comp_;
+    Alloc leafAlloc_;
+    Alloc innerAlloc_;
+};
+
+/*
+---------------------------------------------------
+Begin implementations for the BTree::iterator class.
+---------------------------------------------------
+*/
+
+/**
+* Explicit constructor for the item at index in leaf, or end() if leaf is
+* nullptr.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::iterator(LeafNode* leaf, std::size_t index, const BTree<Key, Value, Fanout, Compare, Alloc>* tree) :
+    leaf_(leaf),
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::iterator() :
+    leaf_(nullptr),
+    index_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::pair<const Key, Value>& BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator*() const
+{
+    return leaf_->items()[index_];
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::pair<const Key, Value>* BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator->() const
+{
+    return leaf_->items() + index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Compares with a const_iterator, so a tree's iterators compare with its
+* cend().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator==(const const_iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+/**
+* Compares with a const_iterator.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the next leaf after the last
+* item of this one.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator&
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator++()
+{
+    if (++index_ == leaf_->count){
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator&
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator--()
+{
+    if (leaf_ == nullptr){
+        leaf_ = tree_->tail_;
+        index_ = leaf_->count;
+    } else if (index_ == 0){
+        leaf_ = leaf_->prev;
+        index_ = leaf_->count;
+    }
+    --index_;
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+-------------------------------------------------
+End implementations for the BTree::iterator class.
+-------------------------------------------------
+*/
+
+/*
+---------------------------------------------------------
+Begin implementations for the BTree::const_iterator class.
+---------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for the item at index in leaf, or end() if leaf is
+* nullptr.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::const_iterator(LeafNode* leaf, std::size_t index, const BTree<Key, Value, Fanout, Compare, Alloc>* tree) :
+    leaf_(leaf),
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::const_iterator() :
+    leaf_(nullptr),
+    index_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Converts an iterator to a const_iterator at the same position.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::const_iterator(const iterator& it) :
+    leaf_(it.leaf_),
+    index_(it.index_),
+    tree_(it.tree_)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+const std::pair<const Key, Value>& BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator*() const
+{
+    return leaf_->items()[index_];
+}
+
+/**
+* Provides read-only access to the address of the item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+const std::pair<const Key, Value>* BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator->() const
+{
+    return leaf_->items() + index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the next leaf after the last
+* item of this one.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator&
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator++()
+{
+    if (++index_ == leaf_->count){
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator&
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator--()
+{
+    if (leaf_ == nullptr){
+        leaf_ = tree_->tail_;
+        index_ = leaf_->count;
+    } else if (index_ == 0){
+        leaf_ = leaf_->prev;
+        index_ = leaf_->count;
+    }
+    --index_;
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+-------------------------------------------------------
+End implementations for the BTree::const_iterator class.
+-------------------------------------------------------
+*/
+
+/*
+------------------------------------------
+Begin implementations for the BTree class.
+------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::BTree() :
+    root_(nullptr),
+    head_(nullptr),
+    tail_(nullptr),
+    size_(0),
+    comp_()
+{
+
+}
+
+/**
+* Constructor for an empty tree ordered by comp.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::BTree(const Compare& comp) :
+    root_(nullptr),
+    head_(nullptr),
+    tail_(nullptr),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Constructor from a range of key/value pairs, as assign().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename Iter>
+BTree<Key, Value, Fanout, Compare, Alloc>::BTree(Iter first, Iter last, const Compare& comp) :
+    root_(nullptr),
+    head_(nullptr),
+    tail_(nullptr),
+    size_(0),
+    comp_(comp)
+{
+    assign(first, last);
+}
+
+/**
+* Copy constructor. The other tree's items are already sorted, so the copy
+* is bulk loaded in O(n) with full leaves rather than inserted one by one.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::BTree(const BTree& other) :
+    root_(nullptr),
+    head_(nullptr),
+    tail_(nullptr),
+    size_(0),
+    comp_(other.comp_)
+{
+    buildSorted(other.cbegin(), other.size_);
+}
+
+/**
+* Move constructor. The nodes change owner without being touched, and
+* other is left empty.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::BTree(BTree&& other) :
+    root_(nullptr),
+    head_(nullptr),
+    tail_(nullptr),
+    size_(0),
+    comp_(other.comp_)
+{
+    swap(other);
+}
+
+/**
+* Destructor.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>::~BTree()
+{
+    clear();
+}
+
+/**
+* Copy assignment: replaces the contents with a bulk-loaded copy of other.
+* If copying an item throws, the tree is left empty.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>& BTree<Key, Value, Fanout, Compare, Alloc>::operator=(const BTree& other)
+{
+    if (this != &other){
+        clear();
+        comp_ = other.comp_;
+        buildSorted(other.cbegin(), other.size_);
+    }
+    return *this;
+}
+
+/**
+* Move assignment: frees the current contents and takes over other's.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+BTree<Key, Value, Fanout, Compare, Alloc>& BTree<Key, Value, Fanout, Compare, Alloc>::operator=(BTree&& other)
+{
+    if (this != &other){
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1), allocators included.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::swap(BTree& other)
+{
+    using std::swap;
+    swap(root_, other.root_);
+    swap(head_, other.head_);
+    swap(tail_, other.tail_);
+    swap(size_, other.size_);
+    swap(comp_, other.comp_);
+    leafAlloc_.swap(other.leafAlloc_);
+    innerAlloc_.swap(other.innerAlloc_);
+}
+
+/**
+* Exchanges the contents of two trees, as lhs.swap(rhs).
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void swap(BTree<Key, Value, Fanout, Compare, Alloc>& lhs, BTree<Key, Value, Fanout, Compare, Alloc>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/**
+* Replaces the contents with the items in [first, last). A range with
+* strictly increasing keys is bulk loaded in O(n); any other range is
+* inserted item by item, later duplicates overwriting earlier ones.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename Iter>
+void BTree<Key, Value, Fanout, Compare, Alloc>::assign(Iter first, Iter last)
+{
+    clear();
+    std::size_t size = 0;
+    if (sortedRange(first, last, size)){
+        buildSorted(first, size);
+    } else {
+        for (; first != last; ++first){
+            insert(*first);
+        }
+    }
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::pair<iterator, bool> result = insertUnique(keyValuePair.first, keyValuePair);
+    if (!result.second) result.first->second = keyValuePair.second;
+}
+
+/**
+* Inserts (or overwrites) by moving out of the pair.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+    std::pair<iterator, bool> result = insertUnique(keyValuePair.first, std::move(keyValuePair));
+    if (!result.second) result.first->second = std::move(keyValuePair.second);
+}
+
+/**
+* Inserts (or overwrites) from any other pair the item can be built from.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename Pair>
+typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+BTree<Key, Value, Fanout, Compare, Alloc>::insert(Pair&& keyValuePair)
+{
+    insert(std::pair<Key, Value>(std::forward<Pair>(keyValuePair)));
+}
+
+/**
+* Inserts key with a value built from args unless key is already present,
+* in which case nothing is built. Returns the item and whether it is new.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename... Args>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator, bool>
+BTree<Key, Value, Fanout, Compare, Alloc>::try_emplace(const Key& key, Args&&... args)
+{
+    return insertUnique(key, std::piecewise_construct, std::forward_as_tuple(key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+/**
+* Removes the item with the given key, if any. A leaf left with too few
+* items borrows one from a sibling, or else merges with it, which can
+* ripple up through the inner nodes and shrink the tree by a level.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::remove(const Key& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    LeafNode* leaf = pos.first;
+    if (leaf == nullptr) return;
+    std::pair<const Key, Value>* items = leaf->items();
+    items[pos.second].~pair();
+    relocate(items + pos.second + 1, leaf->count - pos.second - 1, items + pos.second);
+    --leaf->count;
+    --size_;
+    rebalanceLeaf(leaf);
+}
+
+/**
+* Deletes all items. With a pool that frees everything at once and items
+* with trivial destructors, the nodes are not even visited.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::clear()
+{
+    if (!(leafAlloc_.releasesAll() && innerAlloc_.releasesAll()
+            && std::is_trivially_destructible<Key>::value
+            && std::is_trivially_destructible<Value>::value)){
+        clearNodes(root_);
+    }
+    leafAlloc_.release();
+    innerAlloc_.release();
+    root_ = nullptr;
+    head_ = tail_ = nullptr;
+    size_ = 0;
+}
+
+/**
+* Checks every structural invariant in one pass over the nodes: parent
+* links, node occupancy, every key within the bounds its ancestors'
+* separators allow, all leaves at the same depth and chained in order, and
+* the item count. Meant for tests and debugging.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::isValid() const
+{
+    if (root_ == nullptr) return head_ == nullptr && tail_ == nullptr && size_ == 0;
+    if (root_->parent != nullptr || root_->count == 0) return false;
+
+    struct Pending
+    {
+        const NodeBase* node;
+        const Key* low;     // every key in the subtree is >= *low, if set
+        const Key* high;    // and < *high
+        std::size_t depth;
+    };
+    std::vector<Pending> pending;
+    Pending start = { root_, nullptr, nullptr, 0 };
+    pending.push_back(start);
+    const LeafNode* expected = head_;
+    const LeafNode* previous = nullptr;
+    std::size_t leafDepth = 0;
+    std::size_t items = 0;
+    while (!pending.empty()){
+        Pending p = pending.back();
+        pending.pop_back();
+        if (p.node != root_ && (p.node->leaf ? p.node->count < minLeafItems : p.node->count < minInnerKeys)) return false;
+        if (p.node->leaf){
+            const LeafNode* leaf = static_cast<const LeafNode*>(p.node);
+            if (leaf->count > Fanout) return false;
+            if (leaf != expected || leaf->prev != previous) return false;
+            if (previous == nullptr) leafDepth = p.depth;
+            else if (p.depth != leafDepth) return false;
+            const std::pair<const Key, Value>* kv = leaf->items();
+            for (std::size_t i = 0; i < leaf->count; ++i){
+                if (i > 0 && !comp_(kv[i - 1].first, kv[i].first)) return false;
+                if (p.low != nullptr && comp_(kv[i].first, *p.low)) return false;
+                if (p.high != nullptr && !comp_(kv[i].first, *p.high)) return false;
+            }
+            items += leaf->count;
+            previous = leaf;
+            expected = leaf->next;
+            continue;
+        }
+        const InnerNode* node = static_cast<const InnerNode*>(p.node);
+        if (node->count > Fanout - 1) return false;
+        const Key* keys = node->keys();
+        for (std::size_t i = 0; i < node->count; ++i){
+            if (i > 0 && !comp_(keys[i - 1], keys[i])) return false;
+            if (p.low != nullptr && comp_(keys[i], *p.low)) return false;
+            if (p.high != nullptr && !comp_(keys[i], *p.high)) return false;
+        }
+        // Pushed right to left so the leaves come off the stack in order.
+        for (std::size_t i = node->count + 1; i-- > 0; ){
+            const NodeBase* child = node->children[i];
+            if (child == nullptr || child->parent != node) return false;
+            Pending next = { child, i == 0 ? p.low : keys + i - 1, i == node->count ? p.high : keys + i, p.depth + 1 };
+            pending.push_back(next);
+        }
+    }
+    return expected == nullptr && previous == tail_ && items == size_;
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::empty() const
+{
+    return root_ == nullptr;
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::size_t BTree<Key, Value, Fanout, Compare, Alloc>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns a copy of the comparison object that orders the keys.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+Compare BTree<Key, Value, Fanout, Compare, Alloc>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an immutable snapshot of the tree, as BinarySearchTree::freeze().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+FrozenTree<Key, Value, Compare> BTree<Key, Value, Fanout, Compare, Alloc>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(cbegin(), cend(), comp_);
+}
+
+/**
+* Returns an iterator to the smallest item in the tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::begin()
+{
+    return iterator(head_, 0, this);
+}
+
+/**
+* Returns a const_iterator to the smallest item in the tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::begin() const
+{
+    return const_iterator(head_, 0, this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::end()
+{
+    return iterator(nullptr, 0, this);
+}
+
+/**
+* Returns a const_iterator whose value means INVALID
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::end() const
+{
+    return const_iterator(nullptr, 0, this);
+}
+
+/**
+* Returns a const_iterator to the smallest item, even from a non-const tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::cbegin() const
+{
+    return begin();
+}
+
+/**
+* Returns the const_iterator past the largest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns a reverse iterator to the largest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::reverse_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+/**
+* Returns a const reverse iterator to the largest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_reverse_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+/**
+* Returns the reverse iterator past the smallest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::reverse_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+/**
+* Returns the const reverse iterator past the smallest item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_reverse_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if the key
+* is not present.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::find(const Key& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Const overload of find().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::find(const Key& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::lower_bound(const Key& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = lowerBoundPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Const overload of lower_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::lower_bound(const Key& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = lowerBoundPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::upper_bound(const Key& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = upperBoundPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Const overload of upper_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::upper_bound(const Key& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = upperBoundPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Returns the range of items with the given key: empty, or just that item.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator,
+          typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator>
+BTree<Key, Value, Fanout, Compare, Alloc>::equal_range(const Key& key)
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/**
+* Const overload of equal_range().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator,
+          typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator>
+BTree<Key, Value, Fanout, Compare, Alloc>::equal_range(const Key& key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/**
+* Heterogeneous find(), available when Compare is transparent.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::find(const K& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Heterogeneous const find().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::find(const K& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Heterogeneous lower_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::lower_bound(const K& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = lowerBoundPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Heterogeneous const lower_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::lower_bound(const K& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = lowerBoundPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Heterogeneous upper_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::upper_bound(const K& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = upperBoundPosition(key);
+    return iterator(pos.first, pos.second, this);
+}
+
+/**
+* Heterogeneous const upper_bound().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K, typename C, typename>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::const_iterator
+BTree<Key, Value, Fanout, Compare, Alloc>::upper_bound(const K& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = upperBoundPosition(key);
+    return const_iterator(pos.first, pos.second, this);
+}
+
+/**
+* Returns the value stored with key, throwing std::out_of_range if the key
+* is not present.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+Value& BTree<Key, Value, Fanout, Compare, Alloc>::operator[](const Key& key)
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    if (pos.first == nullptr) throw std::out_of_range("Invalid key");
+    return pos.first->items()[pos.second].second;
+}
+
+/**
+* Const overload of operator[].
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+Value const & BTree<Key, Value, Fanout, Compare, Alloc>::operator[](const Key& key) const
+{
+    std::pair<LeafNode*, std::size_t> pos = findPosition(key);
+    if (pos.first == nullptr) throw std::out_of_range("Invalid key");
+    return pos.first->items()[pos.second].second;
+}
+
+/**
+* Returns the position of the first item in leaf whose key is not less
+* than key, or leaf->count if there is none. A binary search over the
+* contiguous items.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::size_t BTree<Key, Value, Fanout, Compare, Alloc>::lowerBoundIn(const LeafNode* leaf, const K& key) const
+{
+    const std::pair<const Key, Value>* items = leaf->items();
+    std::size_t low = 0;
+    std::size_t count = leaf->count;
+    while (count > 0){
+        std::size_t half = count / 2;
+        if (comp_(items[low + half].first, key)){
+            low += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return low;
+}
+
+/**
+* Returns the position of the first item in leaf whose key is greater
+* than key, or leaf->count if there is none.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::size_t BTree<Key, Value, Fanout, Compare, Alloc>::upperBoundIn(const LeafNode* leaf, const K& key) const
+{
+    const std::pair<const Key, Value>* items = leaf->items();
+    std::size_t low = 0;
+    std::size_t count = leaf->count;
+    while (count > 0){
+        std::size_t half = count / 2;
+        if (!comp_(key, items[low + half].first)){
+            low += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return low;
+}
+
+/**
+* Returns which child of node may hold key. Separator i is no greater than
+* any key under child i + 1 and greater than every key under child i, so
+* this is the number of separators not greater than key.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::size_t BTree<Key, Value, Fanout, Compare, Alloc>::childIndex(const InnerNode* node, const K& key) const
+{
+    const Key* keys = node->keys();
+    std::size_t low = 0;
+    std::size_t count = node->count;
+    while (count > 0){
+        std::size_t half = count / 2;
+        if (!comp_(key, keys[low + half])){
+            low += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return low;
+}
+
+/**
+* Returns the leaf that holds key if it is present, or nullptr for an
+* empty tree.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*
+BTree<Key, Value, Fanout, Compare, Alloc>::findLeaf(const K& key) const
+{
+    NodeBase* node = root_;
+    if (node == nullptr) return nullptr;
+    while (!node->leaf){
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        node = inner->children[childIndex(inner, key)];
+    }
+    return static_cast<LeafNode*>(node);
+}
+
+/**
+* Returns the leaf and position of the item with the given key, or
+* (nullptr, 0), which is end(), if the key is not present.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*, std::size_t>
+BTree<Key, Value, Fanout, Compare, Alloc>::findPosition(const K& key) const
+{
+    LeafNode* leaf = findLeaf(key);
+    if (leaf != nullptr){
+        std::size_t index = lowerBoundIn(leaf, key);
+        if (index < leaf->count && !comp_(key, leaf->items()[index].first)){
+            return std::make_pair(leaf, index);
+        }
+    }
+    return std::make_pair(static_cast<LeafNode*>(nullptr), std::size_t(0));
+}
+
+/**
+* Returns the position of the first item not less than key.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*, std::size_t>
+BTree<Key, Value, Fanout, Compare, Alloc>::lowerBoundPosition(const K& key) const
+{
+    LeafNode* leaf = findLeaf(key);
+    if (leaf == nullptr) return std::make_pair(leaf, std::size_t(0));
+    return normalize(leaf, lowerBoundIn(leaf, key));
+}
+
+/**
+* Returns the position of the first item greater than key.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename K>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*, std::size_t>
+BTree<Key, Value, Fanout, Compare, Alloc>::upperBoundPosition(const K& key) const
+{
+    LeafNode* leaf = findLeaf(key);
+    if (leaf == nullptr) return std::make_pair(leaf, std::size_t(0));
+    return normalize(leaf, upperBoundIn(leaf, key));
+}
+
+/**
+* Turns the position just past the last item of a leaf into the first
+* item of the next leaf, or end().
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*, std::size_t>
+BTree<Key, Value, Fanout, Compare, Alloc>::normalize(LeafNode* leaf, std::size_t index)
+{
+    if (index == leaf->count) return std::make_pair(leaf->next, std::size_t(0));
+    return std::make_pair(leaf, index);
+}
+
+/**
+* Finds key, and if it is not present builds its item from args in the
+* leaf where it belongs. A full leaf is split first, along with every full
+* ancestor the split reaches; the nodes for all of that are allocated
+* before anything changes, so running out of memory, or an item whose
+* constructor throws, leaves the items as they were.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename... Args>
+std::pair<typename BTree<Key, Value, Fanout, Compare, Alloc>::iterator, bool>
+BTree<Key, Value, Fanout, Compare, Alloc>::insertUnique(const Key& key, Args&&... args)
+{
+    if (root_ == nullptr){
+        LeafNode* leaf = createLeafNode();
+        try {
+            insertIntoLeaf(leaf, 0, std::forward<Args>(args)...);
+        } catch (...) {
+            destroyLeafNode(leaf);
+            throw;
+        }
+        root_ = head_ = tail_ = leaf;
+        size_ = 1;
+        return std::make_pair(iterator(leaf, 0, this), true);
+    }
+    LeafNode* leaf = findLeaf(key);
+    std::size_t index = lowerBoundIn(leaf, key);
+    if (index < leaf->count && !comp_(key, leaf->items()[index].first)){
+        return std::make_pair(iterator(leaf, index, this), false);
+    }
+    if (leaf->count == Fanout){
+        std::size_t splits = 1;
+        InnerNode* parent = leaf->parent;
+        for (; parent != nullptr && parent->count == Fanout - 1; parent = parent->parent){
+            ++splits;
+        }
+        std::size_t spareCount = parent == nullptr ? splits : splits - 1;
+        InnerNode* spares[maxHeight];
+        std::size_t made = 0;
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type separator;
+        LeafNode* right = createLeafNode();
+        try {
+            for (; made < spareCount; ++made){
+                spares[made] = createInnerNode();
+            }
+            new (&separator) Key(leaf->items()[Fanout / 2].first);
+        } catch (...) {
+            while (made > 0){
+                destroyInnerNode(spares[--made]);
+            }
+            destroyLeafNode(right);
+            throw;
+        }
+        splitLeaf(leaf, right, reinterpret_cast<Key*>(&separator), spares);
+        if (index > leaf->count){
+            index -= leaf->count;
+            leaf = right;
+        }
+    }
+    insertIntoLeaf(leaf, index, std::forward<Args>(args)...);
+    ++size_;
+    return std::make_pair(iterator(leaf, index, this), true);
+}
+
+/**
+* Builds an item from args at index in a leaf with room for it, shifting
+* the items after it up by one. If the constructor throws they are shifted
+* back.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename... Args>
+void BTree<Key, Value, Fanout, Compare, Alloc>::insertIntoLeaf(LeafNode* leaf, std::size_t index, Args&&... args)
+{
+    std::pair<const Key, Value>* items = leaf->items();
+    std::size_t after = leaf->count - index;
+    relocate(items + index, after, items + index + 1);
+    try {
+        new (items + index) std::pair<const Key, Value>(std::forward<Args>(args)...);
+    } catch (...) {
+        relocate(items + index + 1, after, items + index);
+        throw;
+    }
+    ++leaf->count;
+}
+
+/**
+* Moves the upper half of a full leaf into right, chains right in after
+* it, and adds *separator, a copy of right's first key, to the parent,
+* splitting full ancestors with the preallocated spares.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::splitLeaf(LeafNode* leaf, LeafNode* right, Key* separator, InnerNode** spares)
+{
+    std::size_t keep = Fanout / 2;
+    relocate(leaf->items() + keep, Fanout - keep, right->items());
+    leaf->count = static_cast<std::uint32_t>(keep);
+    right->count = static_cast<std::uint32_t>(Fanout - keep);
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != nullptr) leaf->next->prev = right;
+    else tail_ = right;
+    leaf->next = right;
+    insertSeparator(leaf, separator, right, spares);
+}
+
+/**
+* Adds right to the parent of left, just after it, with *separator
+* between them; *separator is moved from and destroyed. A parent that
+* overflows moves its upper half to a spare and passes its middle
+* separator up in turn, and a split root gets a spare as the new root.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::insertSeparator(NodeBase* left, Key* separator, NodeBase* right, InnerNode** spares)
+{
+    for (;;){
+        InnerNode* parent = left->parent;
+        if (parent == nullptr){
+            InnerNode* root = *spares;
+            relocate(separator, 1, root->keys());
+            root->children[0] = left;
+            root->children[1] = right;
+            root->count = 1;
+            left->parent = right->parent = root;
+            root_ = root;
+            return;
+        }
+        std::size_t i = childPosition(parent, left);
+        Key* keys = parent->keys();
+        relocate(keys + i, parent->count - i, keys + i + 1);
+        relocate(separator, 1, keys + i);
+        for (std::size_t j = parent->count + 1; j > i + 1; --j){
+            parent->children[j] = parent->children[j - 1];
+        }
+        parent->children[i + 1] = right;
+        right->parent = parent;
+        if (++parent->count < Fanout) return;
+
+        InnerNode* sibling = *spares++;
+        std::size_t keep = Fanout / 2;
+        std::size_t moved = Fanout - 1 - keep;
+        relocate(keys + keep + 1, moved, sibling->keys());
+        for (std::size_t j = 0; j <= moved; ++j){
+            sibling->children[j] = parent->children[keep + 1 + j];
+            sibling->children[j]->parent = sibling;
+        }
+        sibling->count = static_cast<std::uint32_t>(moved);
+        parent->count = static_cast<std::uint32_t>(keep);
+        separator = keys + keep;
+        left = parent;
+        right = sibling;
+    }
+}
+
+/**
+* Restores the occupancy of a leaf an item was just removed from: an empty
+* root leaf is freed, and any other leaf left with too few items takes one
+* from a sibling that can spare it, or else merges with that sibling.
+* Separators only need updating when an item crosses them.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::rebalanceLeaf(LeafNode* leaf)
+{
+    if (leaf == root_){
+        if (leaf->count == 0){
+            destroyLeafNode(leaf);
+            root_ = head_ = tail_ = nullptr;
+        }
+        return;
+    }
+    if (leaf->count >= minLeafItems) return;
+    InnerNode* parent = leaf->parent;
+    std::size_t i = childPosition(parent, leaf);
+    LeafNode* left = i > 0 ? static_cast<LeafNode*>(parent->children[i - 1]) : nullptr;
+    LeafNode* right = i < parent->count ? static_cast<LeafNode*>(parent->children[i + 1]) : nullptr;
+    if (left != nullptr && left->count > minLeafItems){
+        relocate(leaf->items(), leaf->count, leaf->items() + 1);
+        relocate(left->items() + left->count - 1, 1, leaf->items());
+        --left->count;
+        ++leaf->count;
+        parent->keys()[i - 1] = leaf->items()[0].first;
+    } else if (right != nullptr && right->count > minLeafItems){
+        relocate(right->items(), 1, leaf->items() + leaf->count);
+        relocate(right->items() + 1, right->count - 1, right->items());
+        --right->count;
+        ++leaf->count;
+        parent->keys()[i] = right->items()[0].first;
+    } else {
+        if (left == nullptr){
+            left = leaf;
+            ++i;
+        } else {
+            right = leaf;
+        }
+        // Merge right into left and drop separator i - 1 with right.
+        relocate(right->items(), right->count, left->items() + left->count);
+        left->count += right->count;
+        right->count = 0;
+        left->next = right->next;
+        if (right->next != nullptr) right->next->prev = left;
+        else tail_ = left;
+        destroyLeafNode(right);
+        parent->keys()[i - 1].~Key();
+        eraseChild(parent, i - 1);
+        rebalanceInner(parent);
+    }
+}
+
+/**
+* Restores the occupancy of an inner node that just lost a child, walking
+* up while merges leave parents short. A separator moves down from the
+* parent whenever a child changes sides, and one moves up to replace it,
+* as in a rotation. A root left with a single child is freed, and the
+* child becomes the root.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::rebalanceInner(InnerNode* node)
+{
+    for (;;){
+        if (node == root_){
+            if (node->count == 0){
+                root_ = node->children[0];
+                root_->parent = nullptr;
+                destroyInnerNode(node);
+            }
+            return;
+        }
+        if (node->count >= minInnerKeys) return;
+        InnerNode* parent = node->parent;
+        std::size_t i = childPosition(parent, node);
+        InnerNode* left = i > 0 ? static_cast<InnerNode*>(parent->children[i - 1]) : nullptr;
+        InnerNode* right = i < parent->count ? static_cast<InnerNode*>(parent->children[i + 1]) : nullptr;
+        Key* keys = node->keys();
+        if (left != nullptr && left->count > minInnerKeys){
+            relocate(keys, node->count, keys + 1);
+            for (std::size_t j = node->count + 1; j > 0; --j){
+                node->children[j] = node->children[j - 1];
+            }
+            relocate(parent->keys() + i - 1, 1, keys);
+            node->children[0] = left->children[left->count];
+            node->children[0]->parent = node;
+            relocate(left->keys() + left->count - 1, 1, parent->keys() + i - 1);
+            --left->count;
+            ++node->count;
+            return;
+        }
+        if (right != nullptr && right->count > minInnerKeys){
+            relocate(parent->keys() + i, 1, keys + node->count);
+            node->children[node->count + 1] = right->children[0];
+            node->children[node->count + 1]->parent = node;
+            ++node->count;
+            relocate(right->keys(), 1, parent->keys() + i);
+            relocate(right->keys() + 1, right->count - 1, right->keys());
+            for (std::size_t j = 0; j < right->count; ++j){
+                right->children[j] = right->children[j + 1];
+            }
+            --right->count;
+            return;
+        }
+        if (left == nullptr){
+            left = node;
+            ++i;
+        } else {
+            right = node;
+        }
+        // Merge right into left, with separator i - 1 coming down between them.
+        Key* leftKeys = left->keys();
+        relocate(parent->keys() + i - 1, 1, leftKeys + left->count);
+        relocate(right->keys(), right->count, leftKeys + left->count + 1);
+        for (std::size_t j = 0; j <= right->count; ++j){
+            left->children[left->count + 1 + j] = right->children[j];
+            right->children[j]->parent = left;
+        }
+        left->count += right->count + 1;
+        right->count = 0;
+        destroyInnerNode(right);
+        eraseChild(parent, i - 1);
+        node = parent;
+    }
+}
+
+/**
+* Closes the gaps left in node by separator index, whose slot must already
+* be empty, and the child after it.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::eraseChild(InnerNode* node, std::size_t index)
+{
+    Key* keys = node->keys();
+    relocate(keys + index + 1, node->count - index - 1, keys + index);
+    for (std::size_t j = index + 1; j < node->count; ++j){
+        node->children[j] = node->children[j + 1];
+    }
+    --node->count;
+}
+
+/**
+* Returns the position of child among the children of parent.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+std::size_t BTree<Key, Value, Fanout, Compare, Alloc>::childPosition(const InnerNode* parent, const NodeBase* child)
+{
+    std::size_t i = 0;
+    while (parent->children[i] != child){
+        ++i;
+    }
+    return i;
+}
+
+/**
+* Returns the smallest key in the subtree at node.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+const Key& BTree<Key, Value, Fanout, Compare, Alloc>::smallestKey(const NodeBase* node)
+{
+    while (!node->leaf){
+        node = static_cast<const InnerNode*>(node)->children[0];
+    }
+    return static_cast<const LeafNode*>(node)->items()[0].first;
+}
+
+/**
+* Moves count objects from one array to another, constructing each in
+* its new place and destroying the old one. The arrays may overlap in
+* either direction.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename T>
+void BTree<Key, Value, Fanout, Compare, Alloc>::relocate(T* from, std::size_t count, T* to)
+{
+    if (to < from){
+        for (std::size_t i = 0; i < count; ++i){
+            new (to + i) T(std::move(from[i]));
+            from[i].~T();
+        }
+    } else {
+        for (std::size_t i = count; i-- > 0; ){
+            new (to + i) T(std::move(from[i]));
+            from[i].~T();
+        }
+    }
+}
+
+/**
+* Returns an empty, unlinked leaf from the leaf allocator.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::LeafNode*
+BTree<Key, Value, Fanout, Compare, Alloc>::createLeafNode()
+{
+    return new (leafAlloc_.allocate(sizeof(LeafNode), alignof(LeafNode))) LeafNode();
+}
+
+/**
+* Returns an empty, unlinked inner node from the inner node allocator.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+typename BTree<Key, Value, Fanout, Compare, Alloc>::InnerNode*
+BTree<Key, Value, Fanout, Compare, Alloc>::createInnerNode()
+{
+    return new (innerAlloc_.allocate(sizeof(InnerNode), alignof(InnerNode))) InnerNode();
+}
+
+/**
+* Destroys the items of a leaf and returns its storage.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::destroyLeafNode(LeafNode* leaf)
+{
+    std::pair<const Key, Value>* items = leaf->items();
+    for (std::size_t i = 0; i < leaf->count; ++i){
+        items[i].~pair();
+    }
+    leaf->~LeafNode();
+    leafAlloc_.deallocate(leaf, sizeof(LeafNode));
+}
+
+/**
+* Destroys the separators of an inner node and returns its storage. The
+* children are left alone.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::destroyInnerNode(InnerNode* node)
+{
+    Key* keys = node->keys();
+    for (std::size_t i = 0; i < node->count; ++i){
+        keys[i].~Key();
+    }
+    node->~InnerNode();
+    innerAlloc_.deallocate(node, sizeof(InnerNode));
+}
+
+/**
+* Destroys every node of the subtree at root in postorder with O(1) extra
+* space. An inner node's separators are destroyed when the walk first
+* reaches it, after which its count says how many children are still
+* left to visit, last first. The parent of root, if any, is left
+* untouched.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+void BTree<Key, Value, Fanout, Compare, Alloc>::clearNodes(NodeBase* root)
+{
+    NodeBase* node = root;
+    bool entering = true;
+    while (node != nullptr){
+        if (!node->leaf){
+            InnerNode* inner = static_cast<InnerNode*>(node);
+            if (entering){
+                Key* keys = inner->keys();
+                for (std::size_t i = 0; i < inner->count; ++i){
+                    keys[i].~Key();
+                }
+                ++inner->count;
+            }
+            if (inner->count > 0){
+                node = inner->children[--inner->count];
+                entering = true;
+                continue;
+            }
+        }
+        NodeBase* parent = node == root ? nullptr : node->parent;
+        if (node->leaf){
+            destroyLeafNode(static_cast<LeafNode*>(node));
+        } else {
+            node->~NodeBase();
+            innerAlloc_.deallocate(node, sizeof(InnerNode));
+        }
+        node = parent;
+        entering = false;
+    }
+}
+
+/**
+* Counts the items in [first, last) and returns true iff their keys are
+* strictly increasing.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename Iter>
+bool BTree<Key, Value, Fanout, Compare, Alloc>::sortedRange(Iter first, Iter last, std::size_t& size) const
+{
+    size = 0;
+    if (first == last) return true;
+    Iter prev = first;
+    for (++first, ++size; first != last; ++first, ++size){
+        if (!comp_(prev->first, first->first)) return false;
+        prev = first;
+    }
+    return true;
+}
+
+/**
+* Bulk loads an empty tree from the next size items of a sorted range,
+* bottom up: the items are dealt out evenly over as few leaves as will
+* hold them, then each level of inner nodes over the level below, so every
+* node is as full as possible and none is short. The separators are the
+* smallest key under each child. If an item's constructor throws, the
+* nodes built so far are freed and the tree is left empty.
+*/
+template<typename Key, typename Value, std::size_t Fanout, typename Compare, typename Alloc>
+template<typename Iter>
+void BTree<Key, Value, Fanout, Compare, Alloc>::buildSorted(Iter first, std::size_t size)
+{
+    if (size == 0) return;
+    std::vector<NodeBase*> level;
+    std::vector<NodeBase*> above;
+    std::size_t attached = 0;    // nodes of level already given a parent
+    try {
+        std::size_t leaves = (size + Fanout - 1) / Fanout;
+        level.reserve(leaves);
+        LeafNode* prev = nullptr;
+        for (std::size_t j = 0; j < leaves; ++j){
+            LeafNode* leaf = createLeafNode();
+            level.push_back(leaf);
+            leaf->prev = prev;
+            if (prev != nullptr) prev->next = leaf;
+            prev = leaf;
+            std::size_t count = size / leaves + (j < size % leaves ? 1 : 0);
+            for (std::size_t i = 0; i < count; ++i, ++first){
+                new (leaf->items() + i) std::pair<const Key, Value>(first->first, first->second);
+                ++leaf->count;
+            }
+        }
+        head_ = static_cast<LeafNode*>(level.front());
+        tail_ = prev;
+        while (level.size() > 1){
+            std::size_t nodes = (level.size() + Fanout - 1) / Fanout;
+            above.clear();
+            above.reserve(nodes);
+            attached = 0;
+            for (std::size_t j = 0; j < nodes; ++j){
+                InnerNode* node = createInnerNode();
+                above.push_back(node);
+                std::size_t children = level.size() / nodes + (j < level.size() % nodes ? 1 : 0);
+                node->children[0] = level[attached];
+                level[attached++]->parent = node;
+                for (std::size_t i = 1; i < children; ++i){
+                    new (node->keys() + i - 1) Key(smallestKey(level[attached]));
+                    node->children[i] = level[attached];
+                    level[attached++]->parent = node;
+                    ++node->count;
+                }
+            }
+            level.swap(above);
+            above.clear();
+            attached = 0;
+        }
+    } catch (...) {
+        for (std::size_t j = 0; j < above.size(); ++j){
+            clearNodes(above[j]);
+        }
+        for (std::size_t j = attached; j < level.size(); ++j){
+            clearNodes(level[j]);
+        }
+        head_ = tail_ = nullptr;
+        throw;
+    }
+    root_ = level.front();
+    size_ = size;
+}
+
+/*
+----------------------------------------
+End implementations for the BTree class.
+----------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1521 @@
+#ifndef COMPACT_AVL_H
+#define COMPACT_AVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "frozen_tree.h"
+
+/**
+* A node of a CompactAVLTree. Links are 32-bit positions in the tree's node
+* array, counting from 1 so that 0 means no node, and the balance lives in
+* the top two bits of the parent link, so a node adds 12 bytes to its item
+* where an AVLNode adds three pointers, a subtree size and a balance.
+*
+* The item is kept in raw storage so that a removed node can stay in the
+* array as a free slot, linked to the next free slot through left, until
+* an insert reuses it.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    template<typename... Args>
+    explicit CompactAVLNode(std::uint32_t parent, Args&&... args);
+    CompactAVLNode(const CompactAVLNode& other);
+    CompactAVLNode(CompactAVLNode&& other) noexcept(std::is_nothrow_move_constructible<std::pair<const Key, Value> >::value);
+    ~CompactAVLNode();
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+
+    std::uint32_t getParent() const;
+    std::uint32_t getLeft() const;
+    std::uint32_t getRight() const;
+    int getBalance() const;
+
+    void setParent(std::uint32_t parent);
+    void setLeft(std::uint32_t left);
+    void setRight(std::uint32_t right);
+    void setBalance(int balance);
+
+    bool isFree() const;
+    void release(std::uint32_t nextFree);
+    template<typename... Args>
+    void reuse(std::uint32_t parent, Args&&... args);
+
+    /**
+    * The largest position a parent link can hold.
+    */
+    static const std::uint32_t maxIndex = (std::uint32_t(1) << 30) - 1;
+
+private:
+    // Nodes are relinked, never assigned.
+    CompactAVLNode& operator=(const CompactAVLNode& other);
+
+    static const std::uint32_t indexMask = maxIndex;
+    static const std::uint32_t balanceShift = 30;
+    static const std::uint32_t freeMark = std::uint32_t(3) << balanceShift;
+
+    typename std::aligned_storage<sizeof(std::pair<const Key, Value>), alignof(std::pair<const Key, Value>)>::type item_;
+    std::uint32_t parent_;    // parent position in the low 30 bits, balance + 1 in the top two; 3 marks a free slot
+    std::uint32_t left_;      // the next free slot, while free
+    std::uint32_t right_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* Constructs a balanced leaf under parent, building its item from args.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+CompactAVLNode<Key, Value>::CompactAVLNode(std::uint32_t parent, Args&&... args) :
+    parent_(parent | (std::uint32_t(1) << balanceShift)),
+    left_(0),
+    right_(0)
+{
+    new (&item_) std::pair<const Key, Value>(std::forward<Args>(args)...);
+}
+
+/**
+* Copy constructor: copies the links, and the item unless the slot is free.
+*/
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const CompactAVLNode& other) :
+    parent_(other.parent_),
+    left_(other.left_),
+    right_(other.right_)
+{
+    if (!other.isFree()) new (&item_) std::pair<const Key, Value>(other.getItem());
+}
+
+/**
+* Move constructor, used when the node array grows. It cannot throw unless
+* copying the key or moving the value can, in which case the array copies
+* the nodes instead and keeps its old contents if a copy throws.
+*/
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(CompactAVLNode&& other)
+    noexcept(std::is_nothrow_move_constructible<std::pair<const Key, Value> >::value) :
+    parent_(other.parent_),
+    left_(other.left_),
+    right_(other.right_)
+{
+    if (!other.isFree()) new (&item_) std::pair<const Key, Value>(std::move(other.getItem()));
+}
+
+/**
+* Destructor, which destroys the item of a slot in use.
+*/
+template<typename Key, typename Value>
+CompactAVLNode<Key, Value>::~CompactAVLNode()
+{
+    if (!isFree()) getItem().~pair();
+}
+
+/**
+* A const getter for the item.
+*/
+template<typename Key, typename Value>
+const std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem() const
+{
+    return *reinterpret_cast<const std::pair<const Key, Value>*>(&item_);
+}
+
+/**
+* A non-const getter for the item.
+*/
+template<typename Key, typename Value>
+std::pair<const Key, Value>& CompactAVLNode<Key, Value>::getItem()
+{
+    return *reinterpret_cast<std::pair<const Key, Value>*>(&item_);
+}
+
+/**
+* A const getter for the key.
+*/
+template<typename Key, typename Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return getItem().first;
+}
+
+/**
+* Returns the position of the parent, or 0 for the root.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLNode<Key, Value>::getParent() const
+{
+    return parent_ & indexMask;
+}
+
+/**
+* Returns the position of the left child, or 0.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+/**
+* Returns the position of the right child, or 0.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+/**
+* Returns the height of the right subtree minus that of the left.
+*/
+template<typename Key, typename Value>
+int CompactAVLNode<Key, Value>::getBalance() const
+{
+    return static_cast<int>(parent_ >> balanceShift) - 1;
+}
+
+/**
+* Sets the parent position, keeping the balance.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setParent(std::uint32_t parent)
+{
+    parent_ = (parent_ & ~indexMask) | parent;
+}
+
+/**
+* Sets the left child position.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setLeft(std::uint32_t left)
+{
+    left_ = left;
+}
+
+/**
+* Sets the right child position.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setRight(std::uint32_t right)
+{
+    right_ = right;
+}
+
+/**
+* Sets the balance, which must be -1, 0 or 1, keeping the parent.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::setBalance(int balance)
+{
+    parent_ = (parent_ & indexMask) | (static_cast<std::uint32_t>(balance + 1) << balanceShift);
+}
+
+/**
+* Returns true iff the slot holds no item.
+*/
+template<typename Key, typename Value>
+bool CompactAVLNode<Key, Value>::isFree() const
+{
+    return (parent_ & freeMark) == freeMark;
+}
+
+/**
+* Destroys the item and turns the node into a free slot followed by
+* nextFree.
+*/
+template<typename Key, typename Value>
+void CompactAVLNode<Key, Value>::release(std::uint32_t nextFree)
+{
+    getItem().~pair();
+    parent_ = freeMark;
+    left_ = nextFree;
+    right_ = 0;
+}
+
+/**
+* Builds an item from args in a free slot, making it a balanced leaf under
+* parent. If the item's constructor throws, the slot stays free.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+void CompactAVLNode<Key, Value>::reuse(std::uint32_t parent, Args&&... args)
+{
+    new (&item_) std::pair<const Key, Value>(std::forward<Args>(args)...);
+    parent_ = parent | (std::uint32_t(1) << balanceShift);
+    left_ = 0;
+    right_ = 0;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CompactAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes live in one contiguous array and link to each
+* other by 32-bit position instead of by pointer, for large trees of small
+* items: a <uint32_t, uint32_t> node takes 20 bytes against 40 for an
+* AVLNode. There are no subtree sizes, so rank() and select() are not
+* offered, and the tree holds at most 2^30 - 1 items.
+*
+* Removed nodes become free slots that later inserts reuse; the array only
+* shrinks on clear(). Because items move when the array grows, an insert
+* invalidates references to items, but iterators are positions and stay
+* valid until their own item is removed. Copying a tree copies the array
+* in one pass, since positions mean the same thing in the copy.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class CompactAVLTree
+{
+public:
+    CompactAVLTree();
+    explicit CompactAVLTree(const Compare& comp);
+    template<typename Iter>
+    CompactAVLTree(Iter first, Iter last, const Compare& comp = Compare());
+    CompactAVLTree(const CompactAVLTree& other);
+    CompactAVLTree(CompactAVLTree&& other);
+    CompactAVLTree& operator=(const CompactAVLTree& other);
+    CompactAVLTree& operator=(CompactAVLTree&& other);
+    void swap(CompactAVLTree& other);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(std::pair<Key, Value>&& keyValuePair);
+    template<typename Pair>
+    typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+    insert(Pair&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    void reserve(std::size_t count);
+    std::size_t capacity() const;
+    bool isValid() const;
+    bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+
+    class const_iterator;
+
+    /**
+    * A bidirectional iterator over the items in key order: a node position
+    * and the tree, so that stepping back from end() reaches the largest
+    * item.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    private:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        friend class const_iterator;
+        iterator(std::uint32_t index, CompactAVLTree<Key, Value, Compare>* tree);
+        std::uint32_t index_;    // 0 is end()
+        CompactAVLTree<Key, Value, Compare>* tree_;
+    };
+
+    /**
+    * The read-only counterpart of iterator, handed out by const trees.
+    * Any iterator converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    private:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        const_iterator(std::uint32_t index, const CompactAVLTree<Key, Value, Compare>* tree);
+        std::uint32_t index_;
+        const CompactAVLTree<Key, Value, Compare>* tree_;
+    };
+
+    iterator begin();
+    const_iterator begin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+private:
+    typedef CompactAVLNode<Key, Value> NodeType;
+
+    NodeType& node(std::uint32_t index);
+    const NodeType& node(std::uint32_t index) const;
+    std::uint32_t findIndex(const Key& key) const;
+    std::uint32_t lowerBoundIndex(const Key& key) const;
+    std::uint32_t upperBoundIndex(const Key& key) const;
+    std::uint32_t smallestIndex(std::uint32_t index) const;
+    std::uint32_t largestIndex(std::uint32_t index) const;
+    std::uint32_t successor(std::uint32_t index) const;
+    std::uint32_t predecessor(std::uint32_t index) const;
+    template<typename... Args>
+    std::pair<std::uint32_t, bool> insertUnique(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::uint32_t createNode(std::uint32_t parent, Args&&... args);
+    void replaceChild(std::uint32_t parent, std::uint32_t oldChild, std::uint32_t newChild);
+    void leftRotate(std::uint32_t index);
+    void rightRotate(std::uint32_t index);
+    void insertFix(std::uint32_t index);
+    void removeFix(std::uint32_t index, bool leftShorter);
+
+    std::vector<NodeType> nodes_;
+    std::uint32_t root_;
+    std::uint32_t free_;    // first free slot, or 0
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+--------------------------------------------------------
+Begin implementations for the CompactAVLTree::iterator class.
+--------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for the item at a node position, or end() for 0.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator(std::uint32_t index, CompactAVLTree<Key, Value, Compare>* tree) :
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() :
+    index_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key, Value>& CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->node(index_).getItem();
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key, Value>* CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &tree_->node(index_).getItem();
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+/**
+* Advances the iterator's location using an in-order sequencing
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    index_ = tree_->successor(index_);
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator--()
+{
+    index_ = index_ == 0 ? tree_->largestIndex(tree_->root_) : tree_->predecessor(index_);
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+------------------------------------------------------
+End implementations for the CompactAVLTree::iterator class.
+------------------------------------------------------
+*/
+
+/*
+--------------------------------------------------------------
+Begin implementations for the CompactAVLTree::const_iterator class.
+--------------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for the item at a node position, or end() for 0.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::const_iterator::const_iterator(std::uint32_t index, const CompactAVLTree<Key, Value, Compare>* tree) :
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    index_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Converts an iterator to a const_iterator at the same position.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::const_iterator::const_iterator(const iterator& it) :
+    index_(it.index_),
+    tree_(it.tree_)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value, typename Compare>
+const std::pair<const Key, Value>& CompactAVLTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return tree_->node(index_).getItem();
+}
+
+/**
+* Provides read-only access to the address of the item.
+*/
+template<typename Key, typename Value, typename Compare>
+const std::pair<const Key, Value>* CompactAVLTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &tree_->node(index_).getItem();
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+/**
+* Advances the iterator's location using an in-order sequencing
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator&
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator++()
+{
+    index_ = tree_->successor(index_);
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator&
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator--()
+{
+    index_ = index_ == 0 ? tree_->largestIndex(tree_->root_) : tree_->predecessor(index_);
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+------------------------------------------------------------
+End implementations for the CompactAVLTree::const_iterator class.
+------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------
+Begin implementations for the CompactAVLTree class.
+-----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree() :
+    root_(0),
+    free_(0),
+    size_(0),
+    comp_()
+{
+
+}
+
+/**
+* Constructor for an empty tree ordered by comp.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& comp) :
+    root_(0),
+    free_(0),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Constructor from a range of key/value pairs, later duplicates
+* overwriting earlier ones.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Iter>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(Iter first, Iter last, const Compare& comp) :
+    root_(0),
+    free_(0),
+    size_(0),
+    comp_(comp)
+{
+    for (; first != last; ++first){
+        insert(*first);
+    }
+}
+
+/**
+* Copy constructor: one pass over the node array.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const CompactAVLTree& other) :
+    nodes_(other.nodes_),
+    root_(other.root_),
+    free_(other.free_),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+
+}
+
+/**
+* Move constructor. The node array changes owner and other is left empty.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(CompactAVLTree&& other) :
+    root_(0),
+    free_(0),
+    size_(0),
+    comp_(other.comp_)
+{
+    swap(other);
+}
+
+/**
+* Copy assignment, through a copy so that a throwing item copy leaves the
+* tree as it was.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>& CompactAVLTree<Key, Value, Compare>::operator=(const CompactAVLTree& other)
+{
+    if (this != &other){
+        CompactAVLTree copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+/**
+* Move assignment: frees the current contents and takes over other's.
+*/
+template<typename Key, typename Value, typename Compare>
+CompactAVLTree<Key, Value, Compare>& CompactAVLTree<Key, Value, Compare>::operator=(CompactAVLTree&& other)
+{
+    if (this != &other){
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1).
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::swap(CompactAVLTree& other)
+{
+    using std::swap;
+    nodes_.swap(other.nodes_);
+    swap(root_, other.root_);
+    swap(free_, other.free_);
+    swap(size_, other.size_);
+    swap(comp_, other.comp_);
+}
+
+/**
+* Exchanges the contents of two trees, as lhs.swap(rhs).
+*/
+template<typename Key, typename Value, typename Compare>
+void swap(CompactAVLTree<Key, Value, Compare>& lhs, CompactAVLTree<Key, Value, Compare>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::pair<std::uint32_t, bool> result = insertUnique(keyValuePair.first, keyValuePair);
+    if (!result.second) node(result.first).getItem().second = keyValuePair.second;
+}
+
+/**
+* Inserts (or overwrites) by moving out of the pair.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+    std::pair<std::uint32_t, bool> result = insertUnique(keyValuePair.first, std::move(keyValuePair));
+    if (!result.second) node(result.first).getItem().second = std::move(keyValuePair.second);
+}
+
+/**
+* Inserts (or overwrites) from any other pair the item can be built from.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Pair>
+typename std::enable_if<std::is_constructible<std::pair<Key, Value>, Pair&&>::value>::type
+CompactAVLTree<Key, Value, Compare>::insert(Pair&& keyValuePair)
+{
+    insert(std::pair<Key, Value>(std::forward<Pair>(keyValuePair)));
+}
+
+/**
+* Inserts key with a value built from args unless key is already present,
+* in which case nothing is built. Returns the item and whether it is new.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename... Args>
+std::pair<typename CompactAVLTree<Key, Value, Compare>::iterator, bool>
+CompactAVLTree<Key, Value, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+    std::pair<std::uint32_t, bool> result = insertUnique(key, std::piecewise_construct, std::forward_as_tuple(key),
+                                                         std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+
+/**
+* Removes the item with the given key, if any. A node with two children
+* is replaced by its predecessor, which is relinked into its place rather
+* than having its item moved, so no item other than the removed one is
+* touched. The removed node's slot joins the free list.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    std::uint32_t index = findIndex(key);
+    if (index == 0) return;
+    NodeType& target = node(index);
+    std::uint32_t parent = target.getParent();
+    std::uint32_t fixFrom;
+    bool leftShorter;
+    if (target.getLeft() != 0 && target.getRight() != 0){
+        std::uint32_t pred = largestIndex(target.getLeft());
+        NodeType& p = node(pred);
+        if (pred == target.getLeft()){
+            fixFrom = pred;
+            leftShorter = true;
+        } else {
+            fixFrom = p.getParent();
+            leftShorter = false;
+            node(fixFrom).setRight(p.getLeft());
+            if (p.getLeft() != 0) node(p.getLeft()).setParent(fixFrom);
+            p.setLeft(target.getLeft());
+            node(target.getLeft()).setParent(pred);
+        }
+        p.setRight(target.getRight());
+        node(target.getRight()).setParent(pred);
+        p.setParent(parent);
+        p.setBalance(target.getBalance());
+        replaceChild(parent, index, pred);
+    } else {
+        std::uint32_t child = target.getLeft() != 0 ? target.getLeft() : target.getRight();
+        if (child != 0) node(child).setParent(parent);
+        fixFrom = parent;
+        leftShorter = parent != 0 && node(parent).getLeft() == index;
+        replaceChild(parent, index, child);
+    }
+    target.release(free_);
+    free_ = index;
+    --size_;
+    removeFix(fixFrom, leftShorter);
+}
+
+/**
+* Deletes all items and returns the node array's memory.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+    std::vector<NodeType>().swap(nodes_);
+    root_ = 0;
+    free_ = 0;
+    size_ = 0;
+}
+
+/**
+* Makes room for count nodes in all, so that inserts up to that size
+* neither reallocate nor move items.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::reserve(std::size_t count)
+{
+    nodes_.reserve(count);
+}
+
+/**
+* Returns how many nodes the array has room for without growing.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::capacity() const
+{
+    return nodes_.capacity();
+}
+
+/**
+* Checks the links, balances, key order and item count in one O(n) pass
+* over the nodes in postorder, following parent links rather than keeping a
+* stack, then checks that every other slot is on the free list. Meant for
+* tests and debugging; uses O(n) space for the subtree heights.
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::isValid() const
+{
+    if (root_ != 0 && node(root_).getParent() != 0) return false;
+    std::vector<int> height(nodes_.size() + 1, 0);
+    std::size_t count = 0;
+    std::uint32_t previous = 0;
+    std::uint32_t current = root_;
+    std::uint32_t last = 0;    // the last key visited in order
+    while (current != 0){
+        const NodeType& n = node(current);
+        if (n.isFree()) return false;
+        std::uint32_t left = n.getLeft();
+        std::uint32_t right = n.getRight();
+        if (previous == n.getParent()){
+            if (left != 0){
+                if (node(left).getParent() != current) return false;
+                previous = current;
+                current = left;
+                continue;
+            }
+            previous = 0;
+        }
+        if (previous == left){
+            // In order: the left subtree is done.
+            if (last != 0 && !comp_(node(last).getKey(), n.getKey())) return false;
+            last = current;
+            if (right != 0){
+                if (node(right).getParent() != current) return false;
+                previous = current;
+                current = right;
+                continue;
+            }
+        }
+        int leftHeight = left != 0 ? height[left] : 0;
+        int rightHeight = right != 0 ? height[right] : 0;
+        if (n.getBalance() != rightHeight - leftHeight) return false;
+        height[current] = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+        ++count;
+        previous = current;
+        current = n.getParent();
+    }
+    if (count != size_) return false;
+    std::size_t freeSlots = 0;
+    for (std::uint32_t slot = free_; slot != 0; slot = node(slot).getLeft()){
+        if (!node(slot).isFree() || ++freeSlots > nodes_.size()) return false;
+    }
+    return count + freeSlots == nodes_.size();
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<typename Key, typename Value, typename Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns a copy of the comparison object that orders the keys.
+*/
+template<typename Key, typename Value, typename Compare>
+Compare CompactAVLTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an immutable snapshot of the tree, as BinarySearchTree::freeze().
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare> CompactAVLTree<Key, Value, Compare>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(cbegin(), cend(), comp_);
+}
+
+/**
+* Returns an iterator to the smallest item in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin()
+{
+    return iterator(smallestIndex(root_), this);
+}
+
+/**
+* Returns a const_iterator to the smallest item in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+    return const_iterator(smallestIndex(root_), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end()
+{
+    return iterator(0, this);
+}
+
+/**
+* Returns a const_iterator whose value means INVALID
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+    return const_iterator(0, this);
+}
+
+/**
+* Returns a const_iterator to the smallest item, even from a non-const tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::cbegin() const
+{
+    return begin();
+}
+
+/**
+* Returns the const_iterator past the largest item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key)
+{
+    return iterator(findIndex(key), this);
+}
+
+/**
+* Const overload of find().
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return const_iterator(findIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::lower_bound(const Key& key)
+{
+    return iterator(lowerBoundIndex(key), this);
+}
+
+/**
+* Const overload of lower_bound().
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return const_iterator(lowerBoundIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::upper_bound(const Key& key)
+{
+    return iterator(upperBoundIndex(key), this);
+}
+
+/**
+* Const overload of upper_bound().
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return const_iterator(upperBoundIndex(key), this);
+}
+
+/**
+* Returns the value stored with key, throwing std::out_of_range if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare>
+Value& CompactAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    std::uint32_t index = findIndex(key);
+    if (index == 0) throw std::out_of_range("Invalid key");
+    return node(index).getItem().second;
+}
+
+/**
+* Const overload of operator[].
+*/
+template<typename Key, typename Value, typename Compare>
+Value const & CompactAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    std::uint32_t index = findIndex(key);
+    if (index == 0) throw std::out_of_range("Invalid key");
+    return node(index).getItem().second;
+}
+
+/**
+* Returns the node at a position, counting from 1.
+*/
+template<typename Key, typename Value, typename Compare>
+typename CompactAVLTree<Key, Value, Compare>::NodeType&
+CompactAVLTree<Key, Value, Compare>::node(std::uint32_t index)
+{
+    return nodes_[index - 1];
+}
+
+/**
+* Const overload of node().
+*/
+template<typename Key, typename Value, typename Compare>
+const typename CompactAVLTree<Key, Value, Compare>::NodeType&
+CompactAVLTree<Key, Value, Compare>::node(std::uint32_t index) const
+{
+    return nodes_[index - 1];
+}
+
+/**
+* The position of the node holding key, or 0.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::findIndex(const Key& key) const
+{
+    std::uint32_t bound = lowerBoundIndex(key);
+    if (bound != 0 && !comp_(key, node(bound).getKey())) return bound;
+    return 0;
+}
+
+/**
+* The position of the first key not less than key, or 0, with one
+* comparison per level.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::lowerBoundIndex(const Key& key) const
+{
+    std::uint32_t bound = 0;
+    std::uint32_t current = root_;
+    while (current != 0){
+        const NodeType& n = node(current);
+        if (comp_(n.getKey(), key)){
+            current = n.getRight();
+        } else {
+            bound = current;
+            current = n.getLeft();
+        }
+    }
+    return bound;
+}
+
+/**
+* The position of the first key greater than key, or 0.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::upperBoundIndex(const Key& key) const
+{
+    std::uint32_t bound = 0;
+    std::uint32_t current = root_;
+    while (current != 0){
+        const NodeType& n = node(current);
+        if (comp_(key, n.getKey())){
+            bound = current;
+            current = n.getLeft();
+        } else {
+            current = n.getRight();
+        }
+    }
+    return bound;
+}
+
+/**
+* The position of the smallest key in the subtree at index, or 0 for an
+* empty subtree.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::smallestIndex(std::uint32_t index) const
+{
+    if (index == 0) return 0;
+    while (node(index).getLeft() != 0){
+        index = node(index).getLeft();
+    }
+    return index;
+}
+
+/**
+* The position of the largest key in the subtree at index, or 0 for an
+* empty subtree.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::largestIndex(std::uint32_t index) const
+{
+    if (index == 0) return 0;
+    while (node(index).getRight() != 0){
+        index = node(index).getRight();
+    }
+    return index;
+}
+
+/**
+* The position of the next key in order, or 0 after the largest.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::successor(std::uint32_t index) const
+{
+    if (node(index).getRight() != 0) return smallestIndex(node(index).getRight());
+    std::uint32_t parent = node(index).getParent();
+    while (parent != 0 && node(parent).getRight() == index){
+        index = parent;
+        parent = node(parent).getParent();
+    }
+    return parent;
+}
+
+/**
+* The position of the previous key in order, or 0 before the smallest.
+*/
+template<typename Key, typename Value, typename Compare>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::predecessor(std::uint32_t index) const
+{
+    if (node(index).getLeft() != 0) return largestIndex(node(index).getLeft());
+    std::uint32_t parent = node(index).getParent();
+    while (parent != 0 && node(parent).getLeft() == index){
+        index = parent;
+        parent = node(parent).getParent();
+    }
+    return parent;
+}
+
+/**
+* Finds key, and if it is not present builds its item from args in a new
+* leaf and rebalances. Returns the position of the item and whether it is
+* new.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename... Args>
+std::pair<std::uint32_t, bool> CompactAVLTree<Key, Value, Compare>::insertUnique(const Key& key, Args&&... args)
+{
+    std::uint32_t parent = 0;
+    std::uint32_t current = root_;
+    bool left = false;
+    while (current != 0){
+        const NodeType& n = node(current);
+        parent = current;
+        if (comp_(key, n.getKey())){
+            left = true;
+            current = n.getLeft();
+        } else if (comp_(n.getKey(), key)){
+            left = false;
+            current = n.getRight();
+        } else {
+            return std::make_pair(current, false);
+        }
+    }
+    std::uint32_t leaf = createNode(parent, std::forward<Args>(args)...);
+    ++size_;
+    if (parent == 0){
+        root_ = leaf;
+    } else {
+        if (left) node(parent).setLeft(leaf);
+        else node(parent).setRight(leaf);
+        insertFix(leaf);
+    }
+    return std::make_pair(leaf, true);
+}
+
+/**
+* Builds a leaf under parent in the first free slot, or at the end of the
+* array, and returns its position. Throws std::length_error past the
+* largest position a link can hold.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename... Args>
+std::uint32_t CompactAVLTree<Key, Value, Compare>::createNode(std::uint32_t parent, Args&&... args)
+{
+    if (free_ != 0){
+        std::uint32_t index = free_;
+        std::uint32_t next = node(index).getLeft();
+        node(index).reuse(parent, std::forward<Args>(args)...);
+        free_ = next;
+        return index;
+    }
+    if (nodes_.size() >= NodeType::maxIndex) throw std::length_error("CompactAVLTree: too many nodes");
+    nodes_.emplace_back(parent, std::forward<Args>(args)...);
+    return static_cast<std::uint32_t>(nodes_.size());
+}
+
+/**
+* Points whatever pointed at oldChild, parent or root, at newChild instead.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::replaceChild(std::uint32_t parent, std::uint32_t oldChild, std::uint32_t newChild)
+{
+    if (parent == 0) root_ = newChild;
+    else if (node(parent).getLeft() == oldChild) node(parent).setLeft(newChild);
+    else node(parent).setRight(newChild);
+}
+
+/**
+* Rotates the right child of index up into its place. Balances are left
+* to the caller.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::leftRotate(std::uint32_t index)
+{
+    NodeType& n = node(index);
+    std::uint32_t pivot = n.getRight();
+    NodeType& p = node(pivot);
+    std::uint32_t inner = p.getLeft();
+    std::uint32_t parent = n.getParent();
+    n.setRight(inner);
+    if (inner != 0) node(inner).setParent(index);
+    p.setLeft(index);
+    p.setParent(parent);
+    n.setParent(pivot);
+    replaceChild(parent, index, pivot);
+}
+
+/**
+* Rotates the left child of index up into its place. Balances are left to
+* the caller.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::rightRotate(std::uint32_t index)
+{
+    NodeType& n = node(index);
+    std::uint32_t pivot = n.getLeft();
+    NodeType& p = node(pivot);
+    std::uint32_t inner = p.getRight();
+    std::uint32_t parent = n.getParent();
+    n.setLeft(inner);
+    if (inner != 0) node(inner).setParent(index);
+    p.setRight(index);
+    p.setParent(parent);
+    n.setParent(pivot);
+    replaceChild(parent, index, pivot);
+}
+
+/**
+* Walks up from a new leaf, updating balances while subtrees grow taller,
+* and makes the single or double rotation that ends the walk if a node
+* tips to +/-2.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::insertFix(std::uint32_t index)
+{
+    std::uint32_t child = index;
+    std::uint32_t parent = node(child).getParent();
+    while (parent != 0){
+        NodeType& p = node(parent);
+        int balance = p.getBalance() + (p.getLeft() == child ? -1 : 1);
+        if (balance == 0){
+            p.setBalance(0);
+            return;
+        }
+        if (balance == -1 || balance == 1){
+            p.setBalance(balance);
+            child = parent;
+            parent = p.getParent();
+            continue;
+        }
+        NodeType& c = node(child);
+        int childBalance = c.getBalance();
+        if (balance == -2 && childBalance == -1){ // Zig-zig
+            rightRotate(parent);
+            p.setBalance(0);
+            c.setBalance(0);
+        } else if (balance == 2 && childBalance == 1){ // Zig-zig
+            leftRotate(parent);
+            p.setBalance(0);
+            c.setBalance(0);
+        } else { // Zig-zag
+            std::uint32_t grandChild = balance == -2 ? c.getRight() : c.getLeft();
+            NodeType& g = node(grandChild);
+            int grandBalance = g.getBalance();
+            if (balance == -2){
+                leftRotate(child);
+                rightRotate(parent);
+                p.setBalance(grandBalance == -1 ? 1 : 0);
+                c.setBalance(grandBalance == 1 ? -1 : 0);
+            } else {
+                rightRotate(child);
+                leftRotate(parent);
+                p.setBalance(grandBalance == 1 ? -1 : 0);
+                c.setBalance(grandBalance == -1 ? 1 : 0);
+            }
+            g.setBalance(0);
+        }
+        return;
+    }
+}
+
+/**
+* Walks up from the parent of a removed node, whose left or right subtree
+* just got shorter, rotating where a node tips to +/-2, until a subtree
+* keeps its height.
+*/
+template<typename Key, typename Value, typename Compare>
+void CompactAVLTree<Key, Value, Compare>::removeFix(std::uint32_t index, bool leftShorter)
+{
+    while (index != 0){
+        NodeType& n = node(index);
+        std::uint32_t parent = n.getParent();
+        bool parentLeftShorter = parent != 0 && node(parent).getLeft() == index;
+        int balance = n.getBalance() + (leftShorter ? 1 : -1);
+        if (balance == -1 || balance == 1){
+            n.setBalance(balance);
+            return;
+        }
+        if (balance == 0){
+            n.setBalance(0);
+        } else {
+            std::uint32_t child = balance == 2 ? n.getRight() : n.getLeft();
+            NodeType& c = node(child);
+            int childBalance = c.getBalance();
+            if (childBalance == 0){ // Zig-zig, and the height is unchanged
+                if (balance == 2) leftRotate(index);
+                else rightRotate(index);
+                n.setBalance(balance / 2);
+                c.setBalance(-balance / 2);
+                return;
+            }
+            if (childBalance * balance > 0){ // Zig-zig
+                if (balance == 2) leftRotate(index);
+                else rightRotate(index);
+                n.setBalance(0);
+                c.setBalance(0);
+            } else { // Zig-zag
+                std::uint32_t grandChild = balance == 2 ? c.getLeft() : c.getRight();
+                NodeType& g = node(grandChild);
+                int grandBalance = g.getBalance();
+                if (balance == 2){
+                    rightRotate(child);
+                    leftRotate(index);
+                    n.setBalance(grandBalance == 1 ? -1 : 0);
+                    c.setBalance(grandBalance == -1 ? 1 : 0);
+                } else {
+                    leftRotate(child);
+                    rightRotate(index);
+                    n.setBalance(grandBalance == -1 ? 1 : 0);
+                    c.setBalance(grandBalance == 1 ? -1 : 0);
+                }
+                g.setBalance(0);
+            }
+        }
+        index = parent;
+        leftShorter = parentLeftShorter;
+    }
+}
+
+/*
+---------------------------------------------
+End implementations for the CompactAVLTree class.
+---------------------------------------------
+*/
+
+#endif
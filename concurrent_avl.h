@@ -0,0 +1,878 @@
+#ifndef CONCURRENT_AVL_H
+#define CONCURRENT_AVL_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "node_pool.h"
+
+/**
+* An AVL tree that many threads can share, for read-mostly workloads.
+* Lookups take no lock: they walk the tree optimistically and check a
+* version number that writers bump around every rotation, retrying if a
+* rebalance may have sent them the wrong way and taking the writer lock
+* after a few failed tries. Writers serialize on one mutex, so a write
+* costs about what it does in AVLTree, plus node reclamation.
+*
+* Readers never touch memory that a writer frees or overwrites:
+* - An item is never modified once its node is linked in. Overwriting a
+*   value replaces the whole node.
+* - Removed nodes are retired, not freed. Each reader enters an epoch,
+*   counted on one of a few per-thread stripes, and a writer frees a
+*   retired node only once every reader that might have seen it has left.
+*
+* A find() that returns an item found an item that was in the tree at some
+* point during the call. Leaf inserts, leaf and single-child removals and
+* value replacements change one link, so they do not bump the version and
+* do not make concurrent lookups retry.
+*
+* Compared with BinarySearchTree, reads copy values out (find(),
+* lower_bound()) or visit items in a callback (for_each()) instead of
+* handing out iterators, since an iterator could outlive its node. Compare
+* must be safe to call from several threads at once, and Alloc is only
+* used under the writer lock.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = NodePool>
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    explicit ConcurrentAVLTree(const Compare& comp);
+    ~ConcurrentAVLTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isValid() const;
+    bool empty() const;
+    std::size_t size() const;
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    bool lower_bound(const Key& key, std::pair<Key, Value>& item) const;
+    template<typename F>
+    void for_each(F f) const;
+
+private:
+    // The tree is shared in place, not copied.
+    ConcurrentAVLTree(const ConcurrentAVLTree& other);
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree& other);
+
+    /**
+    * A tree node. Readers only follow left and right; parent and balance
+    * belong to the writer, and once the node is retired parent links it
+    * into the retired list instead.
+    */
+    struct Node
+    {
+        Node(const std::pair<const Key, Value>& keyValuePair, Node* parentNode) :
+            item(keyValuePair), left(nullptr), right(nullptr), parent(parentNode), balance(0) { }
+
+        const std::pair<const Key, Value> item;
+        std::atomic<Node*> left;
+        std::atomic<Node*> right;
+        Node* parent;
+        signed char balance;
+    };
+
+    /**
+    * The readers inside each parity of the epoch, for the threads mapped to
+    * one stripe. The padding keeps stripes on separate cache lines.
+    */
+    struct ReaderSlot
+    {
+        ReaderSlot() { count[0] = 0; count[1] = 0; }
+
+        std::atomic<std::size_t> count[2];
+        char padding[64 - 2 * sizeof(std::atomic<std::size_t>)];
+    };
+
+    /**
+    * Keeps the nodes a reader can reach from being freed while it lives.
+    */
+    class ReadSection
+    {
+    public:
+        explicit ReadSection(const ConcurrentAVLTree& tree);
+        ~ReadSection();
+
+    private:
+        ReadSection(const ReadSection& other);
+        ReadSection& operator=(const ReadSection& other);
+
+        ReaderSlot* slot_;
+        unsigned epoch_;
+    };
+
+    /**
+    * Reader stripes, optimistic attempts before a read takes the writer
+    * lock, and a bound on a walk's length beyond which a rebalance must have
+    * led it astray (an AVL tree of 2^64 items is under 93 levels high).
+    */
+    static const unsigned readerStripes = 16;
+    static const int optimisticTries = 4;
+    static const int maxPathLength = 128;
+
+    static std::size_t readerStripe();
+    static Node* leftOf(const Node* node);
+    static Node* rightOf(const Node* node);
+    bool descend(const Key* key, bool strict, const Node*& bound) const;
+    const Node* findNode(const Key& key) const;
+    const Node* boundNode(const Key* key, bool strict) const;
+    std::atomic<Node*>& childLink(Node* parent, Node* child);
+    void replaceNode(Node* old, const std::pair<const Key, Value>& keyValuePair);
+    void leftRotate(Node* node);
+    void rightRotate(Node* node);
+    void insertFix(Node* node);
+    void removeFix(Node* node, bool leftShorter);
+    void beginRestructure();
+    void finishWrite();
+    void retire(Node* node);
+    void reclaim();
+    Node* createNode(const std::pair<const Key, Value>& keyValuePair, Node* parent);
+    void destroyNode(Node* node);
+    void destroyRetired(Node* list);
+
+    std::atomic<Node*> root_;
+    std::atomic<std::size_t> size_;
+    std::atomic<unsigned> version_;    // odd while a rebalance is under way
+    std::atomic<unsigned> epoch_;
+    mutable ReaderSlot readers_[readerStripes];
+    mutable std::mutex writeMutex_;
+    Node* retired_[2];    // nodes retired in epochs of each parity
+    bool restructuring_;
+    Compare comp_;
+    Alloc alloc_;
+};
+
+/*
+----------------------------------------------------------------
+Begin implementations for the ConcurrentAVLTree::ReadSection class.
+----------------------------------------------------------------
+*/
+
+/**
+* Enters the current epoch on this thread's stripe. If a writer moves the
+* epoch on between reading it and counting in, the count is undone and the
+* reader tries again, so a writer that sees the stripe empty knows no
+* reader is in that epoch or about to enter it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ReadSection::ReadSection(const ConcurrentAVLTree& tree) :
+    slot_(&tree.readers_[readerStripe()]),
+    epoch_(0)
+{
+    for (;;){
+        epoch_ = tree.epoch_.load();
+        slot_->count[epoch_ & 1].fetch_add(1);
+        if (tree.epoch_.load() == epoch_) return;
+        slot_->count[epoch_ & 1].fetch_sub(1);
+    }
+}
+
+/**
+* Leaves the epoch, after which the nodes seen may be freed.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ReadSection::~ReadSection()
+{
+    slot_->count[epoch_ & 1].fetch_sub(1, std::memory_order_release);
+}
+
+/*
+--------------------------------------------------------------
+End implementations for the ConcurrentAVLTree::ReadSection class.
+--------------------------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the ConcurrentAVLTree class.
+--------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ConcurrentAVLTree() :
+    root_(nullptr),
+    size_(0),
+    version_(0),
+    epoch_(0),
+    restructuring_(false),
+    comp_()
+{
+    retired_[0] = nullptr;
+    retired_[1] = nullptr;
+}
+
+/**
+* Constructor for an empty tree ordered by comp.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::ConcurrentAVLTree(const Compare& comp) :
+    root_(nullptr),
+    size_(0),
+    version_(0),
+    epoch_(0),
+    restructuring_(false),
+    comp_(comp)
+{
+    retired_[0] = nullptr;
+    retired_[1] = nullptr;
+}
+
+/**
+* Destructor. No other thread may be using the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::~ConcurrentAVLTree()
+{
+    clear();
+    destroyRetired(retired_[0]);
+    destroyRetired(retired_[1]);
+}
+
+/**
+* Inserts the pair, replacing the item if the key is already present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    Node* parent = nullptr;
+    Node* current = root_.load(std::memory_order_relaxed);
+    bool left = false;
+    while (current != nullptr){
+        parent = current;
+        if (comp_(keyValuePair.first, current->item.first)){
+            left = true;
+            current = leftOf(current);
+        } else if (comp_(current->item.first, keyValuePair.first)){
+            left = false;
+            current = rightOf(current);
+        } else {
+            replaceNode(current, keyValuePair);
+            finishWrite();
+            return;
+        }
+    }
+    Node* leaf = createNode(keyValuePair, parent);
+    if (parent == nullptr) root_.store(leaf, std::memory_order_release);
+    else if (left) parent->left.store(leaf, std::memory_order_release);
+    else parent->right.store(leaf, std::memory_order_release);
+    size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    insertFix(leaf);
+    finishWrite();
+}
+
+/**
+* Removes the item with the given key, if any. A node with two children is
+* replaced by its predecessor, relinked into its place, so that every live
+* node keeps its item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    Node* target = root_.load(std::memory_order_relaxed);
+    while (target != nullptr){
+        if (comp_(key, target->item.first)) target = leftOf(target);
+        else if (comp_(target->item.first, key)) target = rightOf(target);
+        else break;
+    }
+    if (target == nullptr) return;
+    Node* parent = target->parent;
+    Node* left = leftOf(target);
+    Node* right = rightOf(target);
+    Node* fixFrom;
+    bool leftShorter;
+    if (left != nullptr && right != nullptr){
+        beginRestructure();
+        Node* pred = left;
+        while (rightOf(pred) != nullptr){
+            pred = rightOf(pred);
+        }
+        if (pred == left){
+            fixFrom = pred;
+            leftShorter = true;
+        } else {
+            fixFrom = pred->parent;
+            leftShorter = false;
+            Node* predLeft = leftOf(pred);
+            fixFrom->right.store(predLeft, std::memory_order_release);
+            if (predLeft != nullptr) predLeft->parent = fixFrom;
+            pred->left.store(left, std::memory_order_release);
+            left->parent = pred;
+        }
+        pred->right.store(right, std::memory_order_release);
+        right->parent = pred;
+        pred->parent = parent;
+        pred->balance = target->balance;
+        childLink(parent, target).store(pred, std::memory_order_release);
+    } else {
+        Node* child = left != nullptr ? left : right;
+        if (child != nullptr) child->parent = parent;
+        fixFrom = parent;
+        leftShorter = parent != nullptr && leftOf(parent) == target;
+        childLink(parent, target).store(child, std::memory_order_release);
+    }
+    size_.store(size_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    retire(target);
+    removeFix(fixFrom, leftShorter);
+    finishWrite();
+}
+
+/**
+* Removes every item. Readers still walking the old tree keep seeing it
+* until they finish; its nodes are freed after that.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::clear()
+{
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    Node* current = root_.load(std::memory_order_relaxed);
+    root_.store(nullptr, std::memory_order_release);
+    size_.store(0, std::memory_order_relaxed);
+    // Postorder via parent links, read before retire() reuses them.
+    Node* previous = nullptr;
+    while (current != nullptr){
+        Node* left = leftOf(current);
+        Node* right = rightOf(current);
+        Node* parent = current->parent;
+        if (previous == parent && left != nullptr){
+            previous = current;
+            current = left;
+        } else if ((previous == parent || previous == left) && right != nullptr){
+            previous = current;
+            current = right;
+        } else {
+            retire(current);
+            previous = current;
+            current = parent;
+        }
+    }
+    finishWrite();
+}
+
+/**
+* Checks links, balances, key order and the item count under the writer
+* lock, in one iterative postorder pass. Meant for tests and debugging.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::isValid() const
+{
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (version_.load(std::memory_order_relaxed) & 1) return false;
+    const Node* current = root_.load(std::memory_order_relaxed);
+    if (current != nullptr && current->parent != nullptr) return false;
+    std::vector<int> heights;    // finished subtrees awaiting their parent
+    const Node* previous = nullptr;
+    const Node* last = nullptr;    // the last node visited in order
+    std::size_t count = 0;
+    while (current != nullptr){
+        const Node* left = leftOf(current);
+        const Node* right = rightOf(current);
+        const Node* parent = current->parent;
+        if (previous == parent && left != nullptr){
+            if (left->parent != current) return false;
+            previous = current;
+            current = left;
+            continue;
+        }
+        if (previous == parent || previous == left){
+            if (last != nullptr && !comp_(last->item.first, current->item.first)) return false;
+            last = current;
+            if (right != nullptr){
+                if (right->parent != current) return false;
+                previous = current;
+                current = right;
+                continue;
+            }
+        }
+        int rightHeight = 0;
+        int leftHeight = 0;
+        if (right != nullptr){
+            rightHeight = heights.back();
+            heights.pop_back();
+        }
+        if (left != nullptr){
+            leftHeight = heights.back();
+            heights.pop_back();
+        }
+        if (current->balance != rightHeight - leftHeight) return false;
+        heights.push_back((leftHeight > rightHeight ? leftHeight : rightHeight) + 1);
+        ++count;
+        previous = current;
+        current = parent;
+    }
+    return count == size_.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Returns the number of items, as of some recent write.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ConcurrentAVLTree<Key, Value, Compare, Alloc>::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+/**
+* Copies the value stored with key into value and returns true, or
+* returns false if the key is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::find(const Key& key, Value& value) const
+{
+    ReadSection section(*this);
+    const Node* node = findNode(key);
+    if (node == nullptr) return false;
+    value = node->item.second;
+    return true;
+}
+
+/**
+* Returns true iff key is present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::contains(const Key& key) const
+{
+    ReadSection section(*this);
+    return findNode(key) != nullptr;
+}
+
+/**
+* Copies the first item whose key is not less than key into item and
+* returns true, or returns false if there is none.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key, std::pair<Key, Value>& item) const
+{
+    ReadSection section(*this);
+    const Node* node = boundNode(&key, false);
+    if (node == nullptr) return false;
+    item = node->item;
+    return true;
+}
+
+/**
+* Calls f on every item in key order. Each step is a separate validated
+* lookup of the next larger key, so concurrent writes do not stall the
+* walk: f sees strictly increasing keys, each present when visited, and
+* an item inserted or removed during the walk may or may not be seen. The
+* walk holds back node reclamation until it ends, and f must not write to
+* the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename F>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::for_each(F f) const
+{
+    ReadSection section(*this);
+    const Node* node = boundNode(nullptr, false);
+    while (node != nullptr){
+        f(node->item);
+        node = boundNode(&node->item.first, true);
+    }
+}
+
+/**
+* Maps the calling thread to a reader stripe, round robin on first use.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ConcurrentAVLTree<Key, Value, Compare, Alloc>::readerStripe()
+{
+    static std::atomic<std::size_t> nextStripe(0);
+    static thread_local std::size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % readerStripes;
+    return stripe;
+}
+
+/**
+* The writer's view of a node's left child.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::leftOf(const Node* node)
+{
+    return node->left.load(std::memory_order_relaxed);
+}
+
+/**
+* The writer's view of a node's right child.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::rightOf(const Node* node)
+{
+    return node->right.load(std::memory_order_relaxed);
+}
+
+/**
+* One walk from the root setting bound to the first node whose key is not
+* less than key (greater than key if strict), or the smallest node if key
+* is nullptr. Returns false if the walk ran past maxPathLength, which only
+* a concurrent rebalance can cause.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ConcurrentAVLTree<Key, Value, Compare, Alloc>::descend(const Key* key, bool strict, const Node*& bound) const
+{
+    bound = nullptr;
+    const Node* current = root_.load(std::memory_order_acquire);
+    for (int steps = 0; current != nullptr; ++steps){
+        if (steps == maxPathLength) return false;
+        bool right = key != nullptr && (strict ? !comp_(*key, current->item.first) : comp_(current->item.first, *key));
+        if (right){
+            current = current->right.load(std::memory_order_acquire);
+        } else {
+            bound = current;
+            current = current->left.load(std::memory_order_acquire);
+        }
+    }
+    return true;
+}
+
+/**
+* The node holding key, or nullptr, inside a read section. A match needs no
+* validation, since the node was reachable during the walk; a miss is
+* trusted only if no rebalance overlapped the walk.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::findNode(const Key& key) const
+{
+    const Node* bound;
+    for (int attempt = 0; attempt < optimisticTries; ++attempt){
+        unsigned version = version_.load(std::memory_order_acquire);
+        if (version & 1){
+            std::this_thread::yield();
+            continue;
+        }
+        bool complete = descend(&key, false, bound);
+        if (bound != nullptr && !comp_(key, bound->item.first)) return bound;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (complete && version_.load(std::memory_order_relaxed) == version) return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    descend(&key, false, bound);
+    if (bound != nullptr && !comp_(key, bound->item.first)) return bound;
+    return nullptr;
+}
+
+/**
+* The result of descend() inside a read section, retried until no
+* rebalance overlapped the walk, and taken under the writer lock if that
+* keeps failing.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::boundNode(const Key* key, bool strict) const
+{
+    const Node* bound;
+    for (int attempt = 0; attempt < optimisticTries; ++attempt){
+        unsigned version = version_.load(std::memory_order_acquire);
+        if (version & 1){
+            std::this_thread::yield();
+            continue;
+        }
+        bool complete = descend(key, strict, bound);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (complete && version_.load(std::memory_order_relaxed) == version) return bound;
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    descend(key, strict, bound);
+    return bound;
+}
+
+/**
+* The link that points at child: its parent's left or right, or the root.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::atomic<typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*>&
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::childLink(Node* parent, Node* child)
+{
+    if (parent == nullptr) return root_;
+    return leftOf(parent) == child ? parent->left : parent->right;
+}
+
+/**
+* Swaps in a new node holding keyValuePair for old, with the same links and
+* balance, and retires old. Readers see either node whole.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::replaceNode(Node* old, const std::pair<const Key, Value>& keyValuePair)
+{
+    Node* node = createNode(keyValuePair, old->parent);
+    Node* left = leftOf(old);
+    Node* right = rightOf(old);
+    node->left.store(left, std::memory_order_relaxed);
+    node->right.store(right, std::memory_order_relaxed);
+    node->balance = old->balance;
+    if (left != nullptr) left->parent = node;
+    if (right != nullptr) right->parent = node;
+    childLink(old->parent, old).store(node, std::memory_order_release);
+    retire(old);
+}
+
+/**
+* Rotates the right child of node up into its place. Balances are left to
+* the caller.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::leftRotate(Node* node)
+{
+    beginRestructure();
+    Node* pivot = rightOf(node);
+    Node* inner = leftOf(pivot);
+    Node* parent = node->parent;
+    std::atomic<Node*>& link = childLink(parent, node);
+    node->right.store(inner, std::memory_order_release);
+    if (inner != nullptr) inner->parent = node;
+    pivot->left.store(node, std::memory_order_release);
+    pivot->parent = parent;
+    node->parent = pivot;
+    link.store(pivot, std::memory_order_release);
+}
+
+/**
+* Rotates the left child of node up into its place. Balances are left to
+* the caller.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::rightRotate(Node* node)
+{
+    beginRestructure();
+    Node* pivot = leftOf(node);
+    Node* inner = rightOf(pivot);
+    Node* parent = node->parent;
+    std::atomic<Node*>& link = childLink(parent, node);
+    node->left.store(inner, std::memory_order_release);
+    if (inner != nullptr) inner->parent = node;
+    pivot->right.store(node, std::memory_order_release);
+    pivot->parent = parent;
+    node->parent = pivot;
+    link.store(pivot, std::memory_order_release);
+}
+
+/**
+* Walks up from a new leaf, updating balances while subtrees grow taller,
+* and makes the single or double rotation that ends the walk if a node
+* tips to +/-2.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::insertFix(Node* node)
+{
+    Node* child = node;
+    Node* parent = child->parent;
+    while (parent != nullptr){
+        int balance = parent->balance + (leftOf(parent) == child ? -1 : 1);
+        if (balance == 0){
+            parent->balance = 0;
+            return;
+        }
+        if (balance == -1 || balance == 1){
+            parent->balance = static_cast<signed char>(balance);
+            child = parent;
+            parent = parent->parent;
+            continue;
+        }
+        if (balance == -2 && child->balance == -1){ // Zig-zig
+            rightRotate(parent);
+            parent->balance = 0;
+            child->balance = 0;
+        } else if (balance == 2 && child->balance == 1){ // Zig-zig
+            leftRotate(parent);
+            parent->balance = 0;
+            child->balance = 0;
+        } else { // Zig-zag
+            Node* grandChild = balance == -2 ? rightOf(child) : leftOf(child);
+            int grandBalance = grandChild->balance;
+            if (balance == -2){
+                leftRotate(child);
+                rightRotate(parent);
+                parent->balance = grandBalance == -1 ? 1 : 0;
+                child->balance = grandBalance == 1 ? -1 : 0;
+            } else {
+                rightRotate(child);
+                leftRotate(parent);
+                parent->balance = grandBalance == 1 ? -1 : 0;
+                child->balance = grandBalance == -1 ? 1 : 0;
+            }
+            grandChild->balance = 0;
+        }
+        return;
+    }
+}
+
+/**
+* Walks up from the parent of a removed node, whose left or right subtree
+* just got shorter, rotating where a node tips to +/-2, until a subtree
+* keeps its height.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::removeFix(Node* node, bool leftShorter)
+{
+    while (node != nullptr){
+        Node* parent = node->parent;
+        bool parentLeftShorter = parent != nullptr && leftOf(parent) == node;
+        int balance = node->balance + (leftShorter ? 1 : -1);
+        if (balance == -1 || balance == 1){
+            node->balance = static_cast<signed char>(balance);
+            return;
+        }
+        if (balance == 0){
+            node->balance = 0;
+        } else {
+            Node* child = balance == 2 ? rightOf(node) : leftOf(node);
+            int childBalance = child->balance;
+            if (childBalance == 0){ // Zig-zig, and the height is unchanged
+                if (balance == 2) leftRotate(node);
+                else rightRotate(node);
+                node->balance = static_cast<signed char>(balance / 2);
+                child->balance = static_cast<signed char>(-balance / 2);
+                return;
+            }
+            if (childBalance * balance > 0){ // Zig-zig
+                if (balance == 2) leftRotate(node);
+                else rightRotate(node);
+                node->balance = 0;
+                child->balance = 0;
+            } else { // Zig-zag
+                Node* grandChild = balance == 2 ? leftOf(child) : rightOf(child);
+                int grandBalance = grandChild->balance;
+                if (balance == 2){
+                    rightRotate(child);
+                    leftRotate(node);
+                    node->balance = grandBalance == 1 ? -1 : 0;
+                    child->balance = grandBalance == -1 ? 1 : 0;
+                } else {
+                    leftRotate(child);
+                    rightRotate(node);
+                    node->balance = grandBalance == -1 ? 1 : 0;
+                    child->balance = grandBalance == 1 ? -1 : 0;
+                }
+                grandChild->balance = 0;
+            }
+        }
+        node = parent;
+        leftShorter = parentLeftShorter;
+    }
+}
+
+/**
+* Makes the version odd before the first link change of a write that can
+* misdirect a reader, so that lookups overlapping it retry.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::beginRestructure()
+{
+    if (restructuring_) return;
+    restructuring_ = true;
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+* Ends a write: makes the version even again if it was bumped, and frees
+* what retired nodes it can.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::finishWrite()
+{
+    if (restructuring_){
+        restructuring_ = false;
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    reclaim();
+}
+
+/**
+* Queues an unlinked node to be freed once no reader can reach it. Its
+* left and right links stay as they were for readers still on it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::retire(Node* node)
+{
+    unsigned parity = epoch_.load(std::memory_order_relaxed) & 1;
+    node->parent = retired_[parity];
+    retired_[parity] = node;
+}
+
+/**
+* Frees the nodes retired in the previous epoch if no reader that entered
+* it is still inside, and moves the epoch on. Readers of earlier epochs of
+* the same parity were drained before the previous move, and readers of
+* the current epoch entered after those nodes were unlinked.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::reclaim()
+{
+    unsigned epoch = epoch_.load(std::memory_order_relaxed);
+    unsigned previous = (epoch + 1) & 1;
+    for (unsigned i = 0; i < readerStripes; ++i){
+        if (readers_[i].count[previous].load() != 0) return;
+    }
+    Node* list = retired_[previous];
+    retired_[previous] = nullptr;
+    destroyRetired(list);
+    epoch_.store(epoch + 1);
+}
+
+/**
+* Returns a new leaf holding keyValuePair from the allocator.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ConcurrentAVLTree<Key, Value, Compare, Alloc>::Node*
+ConcurrentAVLTree<Key, Value, Compare, Alloc>::createNode(const std::pair<const Key, Value>& keyValuePair, Node* parent)
+{
+    void* storage = alloc_.allocate(sizeof(Node), alignof(Node));
+    try {
+        return new (storage) Node(keyValuePair, parent);
+    } catch (...) {
+        alloc_.deallocate(storage, sizeof(Node));
+        throw;
+    }
+}
+
+/**
+* Destroys a node's item and returns its storage.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::destroyNode(Node* node)
+{
+    node->~Node();
+    alloc_.deallocate(node, sizeof(Node));
+}
+
+/**
+* Destroys a list of retired nodes, chained through parent.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ConcurrentAVLTree<Key, Value, Compare, Alloc>::destroyRetired(Node* list)
+{
+    while (list != nullptr){
+        Node* next = list->parent;
+        destroyNode(list);
+        list = next;
+    }
+}
+
+/*
+------------------------------------------------
+End implementations for the ConcurrentAVLTree class.
+------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,706 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "simd_search.h"
+
+/**
+* An immutable snapshot of a search tree, made by BinarySearchTree::freeze()
+* for read-heavy phases. The keys sit in one contiguous array in Eytzinger
+* (breadth-first) order: the children of position k are 2k and 2k + 1,
+* counting from 1, so the first levels of every search share a few cache
+* lines and each descent is a loop of loads with no pointers to chase. The
+* values live in a parallel array that searches never touch.
+*
+* Snapshots of 32- and 64-bit integer keys in their natural order are laid
+* out for the kernels in simd_search.h instead: the keys stay sorted, with
+* a small implicit B+ tree of cache-line blocks above them, so that each
+* level of a search compares a whole line of keys at once.
+*
+* Iteration is in key order, stepping between positions arithmetically.
+* Dereferencing gives a pair of references into the two arrays rather than
+* a reference to a stored pair.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    FrozenTree();
+    explicit FrozenTree(const Compare& comp);
+    template<typename Iter>
+    FrozenTree(Iter first, Iter last, const Compare& comp = Compare());
+
+    bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+
+    /**
+    * A bidirectional iterator over the snapshot in key order.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key&, const Value&> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef std::pair<const Key&, const Value&> reference;
+
+        const_iterator();
+
+        std::pair<const Key&, const Value&> operator*() const;
+        const Key& key() const;
+        const Value& value() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    private:
+        friend class FrozenTree<Key, Value, Compare>;
+        const_iterator(std::size_t index, const FrozenTree<Key, Value, Compare>* tree);
+        std::size_t index_;    // Eytzinger position counting from 1; 0 is end()
+        const FrozenTree<Key, Value, Compare>* tree_;
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator lower_bound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator upper_bound(const K& key) const;
+    template<typename InIter, typename OutIter>
+    OutIter find_batch(InIter first, InIter last, OutIter out) const;
+
+private:
+    /**
+    * Whether the keys are laid out for the block search kernels. If so,
+    * position k holds the k-th smallest key; otherwise positions are in
+    * Eytzinger order.
+    */
+    static const bool blocked = BlockSearchable<Key, Compare>::value;
+    typedef std::integral_constant<bool, blocked> BlockedTag;
+
+    /**
+    * How many keys find_batch() gathers before searching for them together.
+    */
+    static const std::size_t batchSize = 256;
+
+    /**
+    * Whether Compare takes keys of other types, which find_batch() then
+    * searches for as they are rather than converting them to Key.
+    */
+    template<typename C>
+    static std::true_type isTransparent(typename C::is_transparent*);
+    template<typename C>
+    static std::false_type isTransparent(...);
+    static const bool transparent = decltype(isTransparent<Compare>(0))::value;
+
+    static std::size_t firstIndex(std::size_t size);
+    static std::size_t lastIndex(std::size_t size);
+    static std::size_t nextIndex(std::size_t index, std::size_t size);
+    static std::size_t previousIndex(std::size_t index, std::size_t size);
+    void buildIndex(std::true_type);
+    void buildIndex(std::false_type);
+    template<typename K>
+    std::size_t findIndex(const K& key) const;
+    template<typename K>
+    std::size_t lowerBoundIndex(const K& key) const;
+    template<typename K>
+    std::size_t upperBoundIndex(const K& key) const;
+    template<typename K>
+    std::size_t lowerBoundIndex(const K& key, std::true_type) const;
+    template<typename K>
+    std::size_t lowerBoundIndex(const K& key, std::false_type) const;
+    template<typename K>
+    std::size_t upperBoundIndex(const K& key, std::true_type) const;
+    template<typename K>
+    std::size_t upperBoundIndex(const K& key, std::false_type) const;
+    void findIndices(const Key* keys, std::size_t count, std::size_t* found, std::true_type) const;
+    template<typename K>
+    void findIndices(const K* keys, std::size_t count, std::size_t* found, std::false_type) const;
+    static std::size_t trailingOnes(std::size_t index);
+    void prefetch(std::size_t index) const;
+
+    /**
+    * How many positions ahead of the current one the descent prefetches:
+    * the first of the 16 great-great-grandchildren, four levels down.
+    */
+    static const std::size_t prefetchStride = 16;
+
+    std::vector<Key> keys_;       // keys_[k - 1] holds position k; blocked keys are padded to whole blocks
+    std::vector<Value> values_;   // parallel to keys_
+    std::vector<Key> index_;      // the blocks above keys_, root first
+    std::vector<std::size_t> offsets_;    // where each layer of index_ starts
+    int depth_;                   // the number of layers in index_
+    Compare comp_;
+};
+
+/*
+  ---------------------------------------------------------------
+  Begin implementations for the FrozenTree::const_iterator class.
+  ---------------------------------------------------------------
+*/
+
+/**
+* Default constructor, for an iterator that points nowhere.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    index_(0),
+    tree_(nullptr)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::const_iterator::const_iterator(std::size_t index, const FrozenTree<Key, Value, Compare>* tree) :
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+std::pair<const Key&, const Value&> FrozenTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return std::pair<const Key&, const Value&>(key(), value());
+}
+
+template<typename Key, typename Value, typename Compare>
+const Key& FrozenTree<Key, Value, Compare>::const_iterator::key() const
+{
+    return tree_->keys_[index_ - 1];
+}
+
+template<typename Key, typename Value, typename Compare>
+const Value& FrozenTree<Key, Value, Compare>::const_iterator::value() const
+{
+    return tree_->values_[index_ - 1];
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+/**
+* Advances to the next key in order.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator&
+FrozenTree<Key, Value, Compare>::const_iterator::operator++()
+{
+    index_ = nextIndex(index_, tree_->size());
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++*this;
+    return old;
+}
+
+/**
+* Steps back to the previous key in order; end() steps back to the largest.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator&
+FrozenTree<Key, Value, Compare>::const_iterator::operator--()
+{
+    std::size_t size = tree_->size();
+    index_ = index_ == 0 ? lastIndex(size) : previousIndex(index_, size);
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -------------------------------------------------------------
+  End implementations for the FrozenTree::const_iterator class.
+  -------------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the FrozenTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty snapshot.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree() :
+    depth_(0)
+{
+    buildIndex(BlockedTag());
+
+}
+
+/**
+* Constructs an empty snapshot ordered by the given comparator.
+*/
+template<typename Key, typename Value, typename Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree(const Compare& comp) :
+    depth_(0),
+    comp_(comp)
+{
+    buildIndex(BlockedTag());
+
+}
+
+/**
+* Lays out the items in [first, last), whose keys must be strictly
+* increasing under comp, in O(n). Walking the positions in key order
+* alongside the items says which item each position gets; the arrays are
+* then filled in position order.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Iter>
+FrozenTree<Key, Value, Compare>::FrozenTree(Iter first, Iter last, const Compare& comp) :
+    depth_(0),
+    comp_(comp)
+{
+    std::size_t size = std::distance(first, last);
+    std::vector<Iter> items(size + 1);
+    for (std::size_t k = firstIndex(size); k != 0; k = nextIndex(k, size), ++first){
+        items[k] = first;
+    }
+    keys_.reserve(size);
+    values_.reserve(size);
+    for (std::size_t k = 1; k <= size; ++k){
+        keys_.push_back((*items[k]).first);
+        values_.push_back((*items[k]).second);
+    }
+    buildIndex(BlockedTag());
+}
+
+/**
+* Pads the sorted keys to whole blocks with the largest key value, which
+* no search counts as less, and builds the layers above them from the
+* bottom up until one block covers everything. Slot i of block k in a
+* layer holds the smallest key under child i + 1, which is the first key
+* of the leftmost leaf block below it.
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::buildIndex(std::true_type)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    const Key padding = std::numeric_limits<Key>::max();
+    std::size_t size = values_.size();
+    std::size_t leafBlocks = size == 0 ? 1 : (size + width - 1) / width;
+    keys_.resize(leafBlocks * width, padding);
+    std::vector<std::size_t> blocks;    // per layer, bottom up
+    for (std::size_t b = leafBlocks; b > 1; ){
+        b = (b + width) / (width + 1);
+        blocks.push_back(b);
+    }
+    depth_ = static_cast<int>(blocks.size());
+    offsets_.assign(depth_, 0);
+    std::size_t total = 0;
+    for (int h = 0; h < depth_; ++h){
+        offsets_[h] = total;
+        total += blocks[depth_ - 1 - h] * width;
+    }
+    index_.assign(total, padding);
+    for (int h = 0; h < depth_; ++h){
+        int above = depth_ - h;    // layers between this one and the keys, counting itself
+        for (std::size_t k = 0; k < blocks[above - 1]; ++k){
+            for (std::size_t i = 0; i < width; ++i){
+                std::size_t child = k * (width + 1) + i + 1;
+                for (int down = 1; down < above; ++down) child *= width + 1;
+                std::size_t leaf = child * width;
+                if (leaf < size) index_[offsets_[h] + k * width + i] = keys_[leaf];
+            }
+        }
+    }
+}
+
+/**
+* Nothing to build: Eytzinger order needs no index.
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::buildIndex(std::false_type)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return values_.empty();
+}
+
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return values_.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+Compare FrozenTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::begin() const
+{
+    return const_iterator(firstIndex(size()), this);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::end() const
+{
+    return const_iterator(0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if there
+* is none. When Compare is transparent, key may be of any type it can
+* compare with Key.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return const_iterator(findIndex(key), this);
+}
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::find(const K& key) const
+{
+    return const_iterator(findIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return const_iterator(lowerBoundIndex(key), this);
+}
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::lower_bound(const K& key) const
+{
+    return const_iterator(lowerBoundIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return const_iterator(upperBoundIndex(key), this);
+}
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+typename FrozenTree<Key, Value, Compare>::const_iterator
+FrozenTree<Key, Value, Compare>::upper_bound(const K& key) const
+{
+    return const_iterator(upperBoundIndex(key), this);
+}
+
+/**
+* Looks up every key in [first, last) and writes an iterator to its item,
+* or end(), to out for each, in order; returns out past the last one. The
+* keys are searched for in batches, with several descents in flight at
+* once so that their cache misses overlap.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename InIter, typename OutIter>
+OutIter FrozenTree<Key, Value, Compare>::find_batch(InIter first, InIter last, OutIter out) const
+{
+    typedef typename std::conditional<!blocked && transparent, typename std::iterator_traits<InIter>::value_type, Key>::type K;
+    std::vector<K> keys;
+    keys.reserve(batchSize);
+    std::size_t found[batchSize];
+    while (first != last){
+        keys.clear();
+        for (; first != last && keys.size() < batchSize; ++first){
+            keys.push_back(*first);
+        }
+        findIndices(keys.data(), keys.size(), found, BlockedTag());
+        for (std::size_t j = 0; j < keys.size(); ++j){
+            *out = const_iterator(found[j], this);
+            ++out;
+        }
+    }
+    return out;
+}
+
+/**
+* The position of the smallest key: the end of the leftmost path.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::firstIndex(std::size_t size)
+{
+    if (size == 0) return 0;
+    if (blocked) return 1;
+    std::size_t k = 1;
+    while (2 * k <= size) k *= 2;
+    return k;
+}
+
+/**
+* The position of the largest key: the end of the rightmost path.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::lastIndex(std::size_t size)
+{
+    if (size == 0) return 0;
+    if (blocked) return size;
+    std::size_t k = 1;
+    while (2 * k + 1 <= size) k = 2 * k + 1;
+    return k;
+}
+
+/**
+* The in-order successor of a position: for Eytzinger order, the leftmost
+* position in its right subtree if it has one, otherwise the nearest
+* ancestor it is a left descendant of, found by dropping the trailing right
+* turns. 0 past the end.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::nextIndex(std::size_t index, std::size_t size)
+{
+    if (blocked) return index < size ? index + 1 : 0;
+    if (2 * index + 1 <= size){
+        index = 2 * index + 1;
+        while (2 * index <= size) index *= 2;
+        return index;
+    }
+    return index >> (trailingOnes(index) + 1);
+}
+
+/**
+* The in-order predecessor of a position, mirroring nextIndex().
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::previousIndex(std::size_t index, std::size_t size)
+{
+    if (blocked) return index - 1;
+    if (2 * index <= size){
+        index = 2 * index;
+        while (2 * index + 1 <= size) index = 2 * index + 1;
+        return index;
+    }
+    return index >> (trailingOnes(~index) + 1);
+}
+
+/**
+* The position of the item with key, or 0 if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::findIndex(const K& key) const
+{
+    std::size_t k = lowerBoundIndex(key);
+    if (k != 0 && comp_(key, keys_[k - 1])) k = 0;
+    return k;
+}
+
+/**
+* The position of the first key not less than key, or 0 if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const K& key) const
+{
+    return lowerBoundIndex(key, BlockedTag());
+}
+
+/**
+* The position of the first key greater than key, or 0 if there is none.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::upperBoundIndex(const K& key) const
+{
+    return upperBoundIndex(key, BlockedTag());
+}
+
+/**
+* Searches the blocks for the number of keys less than key, which is one
+* short of the answer's position.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const K& key, std::true_type) const
+{
+    std::size_t rank = blockRank(index_.data(), offsets_.data(), depth_, keys_.data(), static_cast<Key>(key));
+    return rank < size() ? rank + 1 : 0;
+}
+
+/**
+* For integers, the first key greater than key is the first key not less
+* than key + 1.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::upperBoundIndex(const K& key, std::true_type) const
+{
+    const Key target = key;
+    if (target == std::numeric_limits<Key>::max()) return 0;
+    return lowerBoundIndex(static_cast<Key>(target + 1), std::true_type());
+}
+
+/**
+* Descends to a leaf, going right whenever the key at the current
+* position is less than key. The path taken is the bits of the final
+* position, and the answer is the last place it went left: drop the
+* trailing right turns and the left turn before them. Each step is a
+* load and an add with no branch on the comparison, and the keys four
+* levels down are prefetched so that their line is on the way by the
+* time the descent gets there.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const K& key, std::false_type) const
+{
+    std::size_t size = keys_.size();
+    std::size_t k = 1;
+    while (k <= size){
+        prefetch(prefetchStride * k);
+        k = 2 * k + (comp_(keys_[k - 1], key) ? 1 : 0);
+    }
+    return k >> (trailingOnes(k) + 1);
+}
+
+/**
+* As lowerBoundIndex(), going right whenever key is not less than the key
+* at the current position.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+std::size_t FrozenTree<Key, Value, Compare>::upperBoundIndex(const K& key, std::false_type) const
+{
+    std::size_t size = keys_.size();
+    std::size_t k = 1;
+    while (k <= size){
+        prefetch(prefetchStride * k);
+        k = 2 * k + (comp_(key, keys_[k - 1]) ? 0 : 1);
+    }
+    return k >> (trailingOnes(k) + 1);
+}
+
+/**
+* Finds the positions of count keys at once with the block search kernels,
+* writing 0 for each key that is absent.
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::findIndices(const Key* keys, std::size_t count, std::size_t* found, std::true_type) const
+{
+    blockSearch(index_.data(), offsets_.data(), depth_, keys_.data(), keys, count, found);
+    for (std::size_t j = 0; j < count; ++j){
+        found[j] = found[j] < size() && !comp_(keys[j], keys_[found[j]]) ? found[j] + 1 : 0;
+    }
+}
+
+/**
+* Finds the positions of count keys at once in Eytzinger order, advancing
+* a group of descents one level at a time so that each one's prefetch has
+* the others' steps to hide behind.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+void FrozenTree<Key, Value, Compare>::findIndices(const K* keys, std::size_t count, std::size_t* found, std::false_type) const
+{
+    std::size_t size = keys_.size();
+    for (std::size_t base = 0; base < count; base += blockSearchGroup){
+        std::size_t group = count - base < blockSearchGroup ? count - base : blockSearchGroup;
+        std::size_t* k = found + base;
+        for (std::size_t j = 0; j < group; ++j) k[j] = 1;
+        for (bool descending = size != 0; descending; ){
+            descending = false;
+            for (std::size_t j = 0; j < group; ++j){
+                if (k[j] > size) continue;
+                prefetch(prefetchStride * k[j]);
+                k[j] = 2 * k[j] + (comp_(keys_[k[j] - 1], keys[base + j]) ? 1 : 0);
+                descending = true;
+            }
+        }
+        for (std::size_t j = 0; j < group; ++j){
+            k[j] >>= trailingOnes(k[j]) + 1;
+            if (k[j] != 0 && comp_(keys[base + j], keys_[k[j] - 1])) k[j] = 0;
+        }
+    }
+}
+
+/**
+* The number of consecutive one bits at the bottom of index.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenTree<Key, Value, Compare>::trailingOnes(std::size_t index)
+{
+#if defined(__GNUC__)
+    return ~index == 0 ? sizeof(index) * 8 : __builtin_ctzll(~static_cast<unsigned long long>(index));
+#else
+    std::size_t ones = 0;
+    for (; index & 1; index >>= 1) ++ones;
+    return ones;
+#endif
+}
+
+/**
+* Hints that the key at the given position will be read soon. Positions
+* past the end are skipped rather than computing an address outside the
+* array.
+*/
+template<typename Key, typename Value, typename Compare>
+void FrozenTree<Key, Value, Compare>::prefetch(std::size_t index) const
+{
+#if defined(__GNUC__)
+    if (index <= size()) __builtin_prefetch(&keys_[index - 1]);
+#endif
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the FrozenTree class.
+  ---------------------------------------------
+*/
+
+#endif
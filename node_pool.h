@@ -0,0 +1,295 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+* The default node allocator for the search trees. Nodes are carved out of
+* contiguous blocks, removed nodes are recycled through an intrusive free list,
+* and release() hands every block back at once so a tree can be cleared
+* without visiting its nodes.
+*
+* The blocks live in an arena that pools can merge(), which is how nodes
+* move between trees (AVLTree::split and join): once merged, every pool can
+* free any node of the other, and the blocks are returned to the heap when
+* the last pool using them lets go. A pool serves a single slot size, fixed
+* by the first call to allocate().
+*/
+class NodePool
+{
+public:
+    NodePool();
+
+    void* allocate(std::size_t size, std::size_t align);
+    void deallocate(void* p, std::size_t size);
+    bool releasesAll() const;
+    void release();
+    void merge(NodePool& other);
+    void swap(NodePool& other);
+
+private:
+    // A pool owns its blocks, so it cannot be copied.
+    NodePool(const NodePool& other);
+    NodePool& operator=(const NodePool& other);
+
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    /**
+    * The blocks shared by every pool merged together. An arena that has
+    * been merged into another forwards to it and owns no blocks itself.
+    */
+    struct Arena
+    {
+        Arena();
+        ~Arena();
+
+        std::vector<char*> blocks;
+        FreeSlot* freeList;
+        std::vector<FreeSlot*> spareLists;    // free lists taken over from merged arenas
+        char* next;    // bump pointer into the newest block
+        char* end;
+        std::size_t slotSize;
+        std::size_t nextBlockSlots;
+        std::shared_ptr<Arena> forward;
+    };
+
+    Arena& arena();
+
+    static const std::size_t firstBlockSlots = 32;
+    static const std::size_t maxBlockSlots = 8192;
+
+    std::shared_ptr<Arena> arena_;
+};
+
+/**
+* The plain heap allocator: one operator new per node. Kept for comparison
+* against the pool and for callers that want nodes freed as they are removed.
+*/
+class HeapNodeAllocator
+{
+public:
+    void* allocate(std::size_t size, std::size_t align);
+    void deallocate(void* p, std::size_t size);
+    bool releasesAll() const;
+    void release();
+    void merge(HeapNodeAllocator& other);
+    void swap(HeapNodeAllocator& other);
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+/**
+* Constructor for an empty arena.
+*/
+inline NodePool::Arena::Arena() :
+    freeList(nullptr),
+    next(nullptr),
+    end(nullptr),
+    slotSize(0),
+    nextBlockSlots(firstBlockSlots)
+{
+
+}
+
+/**
+* Destructor, which returns every block to the heap once no pool uses them.
+*/
+inline NodePool::Arena::~Arena()
+{
+    for (std::size_t i = 0; i < blocks.size(); ++i){
+        ::operator delete(blocks[i]);
+    }
+}
+
+/**
+* Default constructor. No memory is reserved until the first allocation.
+*/
+inline NodePool::NodePool() :
+    arena_(std::make_shared<Arena>())
+{
+
+}
+
+/**
+* Returns the arena this pool currently allocates from, following (and
+* shortening) the chain left behind by merge().
+*/
+inline NodePool::Arena& NodePool::arena()
+{
+    while (arena_->forward){
+        arena_ = arena_->forward;
+    }
+    return *arena_;
+}
+
+/**
+* Returns storage for one node, preferring recycled slots, then the unused
+* tail of the newest block, and only then a fresh block. Blocks double in
+* size up to maxBlockSlots so small trees stay small.
+*/
+inline void* NodePool::allocate(std::size_t size, std::size_t align)
+{
+    Arena& a = arena();
+    if (a.slotSize == 0){
+        if (align > alignof(std::max_align_t)) throw std::bad_alloc();
+        std::size_t slot = size < sizeof(FreeSlot) ? sizeof(FreeSlot) : size;
+        if (align < alignof(FreeSlot)) align = alignof(FreeSlot);
+        a.slotSize = (slot + align - 1) / align * align;
+    } else if (size > a.slotSize){
+        throw std::bad_alloc();
+    }
+    if (a.freeList == nullptr && !a.spareLists.empty()){
+        a.freeList = a.spareLists.back();
+        a.spareLists.pop_back();
+    }
+    if (a.freeList != nullptr){
+        FreeSlot* slot = a.freeList;
+        a.freeList = slot->next;
+        return slot;
+    }
+    if (a.next == a.end){
+        char* block = static_cast<char*>(::operator new(a.slotSize * a.nextBlockSlots));
+        a.blocks.push_back(block);
+        a.next = block;
+        a.end = block + a.slotSize * a.nextBlockSlots;
+        if (a.nextBlockSlots < maxBlockSlots) a.nextBlockSlots *= 2;
+    }
+    void* slot = a.next;
+    a.next += a.slotSize;
+    return slot;
+}
+
+/**
+* Pushes a slot onto the free list for the next allocate().
+*/
+inline void NodePool::deallocate(void* p, std::size_t size)
+{
+    Arena& a = arena();
+    FreeSlot* slot = static_cast<FreeSlot*>(p);
+    slot->next = a.freeList;
+    a.freeList = slot;
+}
+
+/**
+* Returns true iff no other pool shares this pool's blocks, so release()
+* frees every node this pool ever handed out.
+*/
+inline bool NodePool::releasesAll() const
+{
+    return arena_.use_count() == 1 && !arena_->forward;
+}
+
+/**
+* Frees every block at once if no other pool shares them; otherwise lets
+* go of the shared blocks and starts a fresh arena. Any node still living in
+* the pool is gone afterwards, so callers must have run the destructors they
+* need (and, when shared, returned their nodes with deallocate()).
+*/
+inline void NodePool::release()
+{
+    arena_ = std::make_shared<Arena>();
+}
+
+/**
+* Joins the two pools' arenas so that each can free the other's nodes.
+* The arena with fewer blocks is folded into the other, which keeps its
+* free list and hands the smaller one's recycled slots out afterwards. The
+* unused tail of the smaller arena's newest block is abandoned until the
+* arena is freed, so the cost does not depend on the size of either tree.
+*/
+inline void NodePool::merge(NodePool& other)
+{
+    arena();
+    other.arena();
+    std::shared_ptr<Arena> big = arena_;
+    std::shared_ptr<Arena> small = other.arena_;
+    if (big == small) return;
+    if (big->blocks.size() < small->blocks.size()) big.swap(small);
+    big->blocks.insert(big->blocks.end(), small->blocks.begin(), small->blocks.end());
+    small->blocks.clear();
+    if (big->slotSize == 0) big->slotSize = small->slotSize;
+    if (small->freeList != nullptr) big->spareLists.push_back(small->freeList);
+    big->spareLists.insert(big->spareLists.end(), small->spareLists.begin(), small->spareLists.end());
+    small->freeList = nullptr;
+    small->spareLists.clear();
+    small->next = small->end = nullptr;
+    small->forward = big;
+    arena_ = big;
+    other.arena_ = big;
+}
+
+/**
+* Exchanges the two pools' arenas, so every node each pool handed out now
+* belongs to the other. This is how a tree moves its nodes without touching
+* them.
+*/
+inline void NodePool::swap(NodePool& other)
+{
+    arena_.swap(other.arena_);
+}
+
+/*
+  -------------------------------------------
+  End implementations for the NodePool class.
+  -------------------------------------------
+*/
+
+/**
+* Allocates a single node from the heap.
+*/
+inline void* HeapNodeAllocator::allocate(std::size_t size, std::size_t align)
+{
+    return ::operator new(size);
+}
+
+/**
+* Frees a single node back to the heap.
+*/
+inline void HeapNodeAllocator::deallocate(void* p, std::size_t size)
+{
+    ::operator delete(p);
+}
+
+/**
+* Always false: nodes must be freed one at a time.
+*/
+inline bool HeapNodeAllocator::releasesAll() const
+{
+    return false;
+}
+
+/**
+* Nothing to do: every node has already been freed individually.
+*/
+inline void HeapNodeAllocator::release()
+{
+
+}
+
+/**
+* Nothing to do: any heap allocator can free any other's nodes.
+*/
+inline void HeapNodeAllocator::merge(HeapNodeAllocator& other)
+{
+
+}
+
+/**
+* Nothing to do: heap allocators hold no state.
+*/
+inline void HeapNodeAllocator::swap(HeapNodeAllocator& other)
+{
+
+}
+
+#endif
@@ -0,0 +1,1082 @@
+#ifndef PERSISTENT_AVL_H
+#define PERSISTENT_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "node_pool.h"
+
+/**
+* A persistent AVL tree: copying one, or calling snapshot(), is O(1) and
+* shares every node, and later writes to either copy leave the other as it
+* was. Nodes are reference counted. An insert or remove updates the top of
+* its path in place as far as no other version holds it, and builds a new
+* copy of the rest, O(log n) nodes sharing the subtrees off it. A tree no
+* one has copied is therefore written in place, as an AVLTree is. Every
+* comparison, and every copy or allocation that can throw, comes before
+* the first change, so a write that throws leaves the tree as it was.
+*
+* Node counts are atomic, so versions may be handed to, read and dropped
+* on other threads, but one version must not be read and written at once.
+* A version dropped on another thread frees nodes there, so Alloc must let
+* any instance free nodes from any thread: HeapNodeAllocator does, and
+* NodePool does not. Keys and values are copied along a write's path.
+*
+* Nodes have no parent links, since a node may sit in many trees. The
+* iterators keep the path from the root instead, in a fixed array so that
+* lookups allocate nothing, and stay valid while the version they came from
+* is alive and unchanged.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = HeapNodeAllocator>
+class PersistentAVLTree
+{
+public:
+    PersistentAVLTree();
+    explicit PersistentAVLTree(const Compare& comp);
+    template<typename Iter>
+    PersistentAVLTree(Iter first, Iter last, const Compare& comp = Compare());
+    PersistentAVLTree(const PersistentAVLTree& other);
+    PersistentAVLTree(PersistentAVLTree&& other);
+    ~PersistentAVLTree();
+    PersistentAVLTree& operator=(const PersistentAVLTree& other);
+    PersistentAVLTree& operator=(PersistentAVLTree&& other);
+    void swap(PersistentAVLTree& other);
+    PersistentAVLTree snapshot() const;
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isValid() const;
+    bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+
+private:
+    struct Node;
+
+    // Room for the longest path: an AVL tree of n items is less than
+    // 1.45 log2(n + 2) high, so 92 levels for any n a size_t can count.
+    static const std::size_t maxDepth = 96;
+
+public:
+    /**
+    * A read-only bidirectional iterator: the path from the root to the
+    * current node, empty at end(). Stepping back from end() gives the
+    * largest item.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const const_iterator& other);
+        const_iterator& operator=(const const_iterator& other);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    private:
+        friend class PersistentAVLTree<Key, Value, Compare, Alloc>;
+        explicit const_iterator(const Node* root);
+        void pushLeftmost(const Node* node);
+        void pushRightmost(const Node* node);
+
+        const Node* path_[maxDepth];
+        std::size_t depth_;
+        const Node* root_;
+    };
+
+    typedef const_iterator iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+private:
+    /**
+    * A node, immutable while more than one tree or node refers to it.
+    */
+    struct Node
+    {
+        Node(const Key& key, const Value& value, Node* leftChild, Node* rightChild, int nodeHeight) :
+            item(key, value), left(leftChild), right(rightChild), refs(1), height(static_cast<std::uint8_t>(nodeHeight)) { }
+
+        std::pair<const Key, Value> item;
+        Node* left;
+        Node* right;
+        std::atomic<std::uint32_t> refs;
+        std::uint8_t height;
+    };
+
+    static int heightOf(const Node* node);
+    static void updateHeight(Node* node);
+    static Node* retain(Node* node);
+    static bool heldAlone(const Node* node);
+    static bool rotatable(const Node* node);
+    void release(Node* node);
+    Node* unshare(Node* node);
+    Node* rotateLeft(Node* node);
+    Node* rotateRight(Node* node);
+    Node* rebalance(Node* node);
+    void rebalancePath(Node* const* path, Node** const* links, std::size_t top);
+    Node* insertAt(Node* node, const std::pair<const Key, Value>& keyValuePair, bool& added);
+    Node* removeAt(Node* node, const Key& key);
+    Node* removeMin(Node* node);
+    int checkSubtree(const Node* node, const Key* low, const Key* high, std::size_t& count) const;
+    Node* createNode(const Key& key, const Value& value, Node* left, Node* right, int height);
+    void destroyNode(Node* node);
+
+    Node* root_;
+    std::size_t size_;
+    Compare comp_;
+    Alloc alloc_;
+};
+
+/*
+------------------------------------------------------------------
+Begin implementations for the PersistentAVLTree::const_iterator class.
+------------------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator() :
+    depth_(0),
+    root_(nullptr)
+{
+
+}
+
+/**
+* Copy constructor, copying only the part of the path in use.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(const const_iterator& other) :
+    depth_(other.depth_),
+    root_(other.root_)
+{
+    std::copy(other.path_, other.path_ + depth_, path_);
+}
+
+/**
+* Copy assignment, copying only the part of the path in use.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator&
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator=(const const_iterator& other)
+{
+    depth_ = other.depth_;
+    root_ = other.root_;
+    std::copy(other.path_, other.path_ + depth_, path_);
+    return *this;
+}
+
+/**
+* Constructor for end() of the tree at root; the caller fills in the path.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(const Node* root) :
+    depth_(0),
+    root_(root)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>& PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator*() const
+{
+    return path_[depth_ - 1]->item;
+}
+
+/**
+* Provides read-only access to the address of the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>* PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator->() const
+{
+    return &path_[depth_ - 1]->item;
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    if (depth_ == 0 || rhs.depth_ == 0) return depth_ == 0 && rhs.depth_ == 0;
+    return path_[depth_ - 1] == rhs.path_[rhs.depth_ - 1];
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances the iterator's location using an in-order sequencing: down to
+* the smallest key of the right subtree, or else up past every ancestor
+* whose right subtree this was.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator&
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator++()
+{
+    const Node* current = path_[depth_ - 1];
+    if (current->right != nullptr){
+        pushLeftmost(current->right);
+        return *this;
+    }
+    --depth_;
+    while (depth_ != 0 && path_[depth_ - 1]->right == current){
+        current = path_[--depth_];
+    }
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator back one item in order. Stepping back from end()
+* gives the largest item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator&
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator--()
+{
+    if (depth_ == 0){
+        pushRightmost(root_);
+        return *this;
+    }
+    const Node* current = path_[depth_ - 1];
+    if (current->left != nullptr){
+        pushRightmost(current->left);
+        return *this;
+    }
+    --depth_;
+    while (depth_ != 0 && path_[depth_ - 1]->left == current){
+        current = path_[--depth_];
+    }
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/**
+* Extends the path down the left spine from node.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::pushLeftmost(const Node* node)
+{
+    for (; node != nullptr; node = node->left){
+        path_[depth_++] = node;
+    }
+}
+
+/**
+* Extends the path down the right spine from node.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator::pushRightmost(const Node* node)
+{
+    for (; node != nullptr; node = node->right){
+        path_[depth_++] = node;
+    }
+}
+
+/*
+----------------------------------------------------------------
+End implementations for the PersistentAVLTree::const_iterator class.
+----------------------------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the PersistentAVLTree class.
+--------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::PersistentAVLTree() :
+    root_(nullptr),
+    size_(0),
+    comp_()
+{
+
+}
+
+/**
+* Constructor for an empty tree ordered by comp.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::PersistentAVLTree(const Compare& comp) :
+    root_(nullptr),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Constructor from a range of key/value pairs, later duplicates
+* overwriting earlier ones.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename Iter>
+PersistentAVLTree<Key, Value, Compare, Alloc>::PersistentAVLTree(Iter first, Iter last, const Compare& comp) :
+    root_(nullptr),
+    size_(0),
+    comp_(comp)
+{
+    try {
+        for (; first != last; ++first){
+            insert(*first);
+        }
+    } catch (...) {
+        release(root_);
+        throw;
+    }
+}
+
+/**
+* Copy constructor: shares other's nodes in O(1).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::PersistentAVLTree(const PersistentAVLTree& other) :
+    root_(retain(other.root_)),
+    size_(other.size_),
+    comp_(other.comp_),
+    alloc_(other.alloc_)
+{
+
+}
+
+/**
+* Move constructor. other is left empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::PersistentAVLTree(PersistentAVLTree&& other) :
+    root_(other.root_),
+    size_(other.size_),
+    comp_(other.comp_),
+    alloc_(other.alloc_)
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+}
+
+/**
+* Destructor, which frees the nodes no other version holds.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>::~PersistentAVLTree()
+{
+    release(root_);
+}
+
+/**
+* Copy assignment: drops this version and shares other's nodes.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>& PersistentAVLTree<Key, Value, Compare, Alloc>::operator=(const PersistentAVLTree& other)
+{
+    PersistentAVLTree copy(other);
+    swap(copy);
+    return *this;
+}
+
+/**
+* Move assignment: drops this version and takes over other's.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc>& PersistentAVLTree<Key, Value, Compare, Alloc>::operator=(PersistentAVLTree&& other)
+{
+    if (this != &other){
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+/**
+* Exchanges the contents of two trees in O(1).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::swap(PersistentAVLTree& other)
+{
+    using std::swap;
+    swap(root_, other.root_);
+    swap(size_, other.size_);
+    swap(comp_, other.comp_);
+    swap(alloc_, other.alloc_);
+}
+
+/**
+* Exchanges the contents of two trees, as lhs.swap(rhs).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void swap(PersistentAVLTree<Key, Value, Compare, Alloc>& lhs, PersistentAVLTree<Key, Value, Compare, Alloc>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+/**
+* Returns a version with the current contents in O(1), unaffected by later
+* writes to this one. The same as copying the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+PersistentAVLTree<Key, Value, Compare, Alloc> PersistentAVLTree<Key, Value, Compare, Alloc>::snapshot() const
+{
+    return *this;
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is already present.
+* The descent records the path and where it first meets a node another
+* version holds. Below that point the path is copied by insertAt(); above
+* it, or everywhere in a tree no one has copied, the only thing made is
+* the new leaf, or a node with the new value in place of the old one.
+* Once that is built nothing can throw: it is linked in, and the nodes
+* above are rebalanced in place, stopping where the height stays the same.
+* If a comparison, copy or allocation throws, the tree is left unchanged.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Node* path[maxDepth];
+    Node** links[maxDepth + 1];    // links[i] points at path[i], from its parent or root_
+    std::size_t depth = 0;
+    std::size_t shared = maxDepth;    // first position held by another version
+    Node** link = &root_;
+    Node* match = nullptr;
+    while (*link != nullptr){
+        Node* node = *link;
+        if (shared == maxDepth && !heldAlone(node)) shared = depth;
+        path[depth] = node;
+        links[depth++] = link;
+        if (comp_(keyValuePair.first, node->item.first)) link = &node->left;
+        else if (comp_(node->item.first, keyValuePair.first)) link = &node->right;
+        else {
+            match = node;
+            break;
+        }
+    }
+    links[depth] = link;
+
+    bool added = false;
+    std::size_t top;    // the position the new subtree takes
+    Node* subtree;
+    if (shared < depth){
+        top = shared;
+        subtree = insertAt(path[top], keyValuePair, added);
+    } else if (match != nullptr){
+        top = depth - 1;
+        subtree = createNode(match->item.first, keyValuePair.second, nullptr, nullptr, match->height);
+    } else {
+        top = depth;
+        subtree = createNode(keyValuePair.first, keyValuePair.second, nullptr, nullptr, 1);
+        added = true;
+    }
+
+    *links[top] = subtree;
+    if (shared < depth){
+        release(path[top]);
+    } else if (match != nullptr){
+        subtree->left = match->left;
+        subtree->right = match->right;
+        destroyNode(match);
+    }
+    rebalancePath(path, links, top);
+    if (added) ++size_;
+}
+
+/**
+* Removes the item with the given key, if any. The descent records the
+* path to the item, and on to its successor if it has two children, and
+* finds where it first meets a node another version holds, or one whose
+* rebalancing could rotate such a node. Below that point the path is
+* copied by removeAt() before anything changes; above it, or everywhere in
+* a tree no one has copied, nothing is made at all. The item is unlinked,
+* its successor taking its place, and the nodes above are rebalanced in
+* place. A missing key copies nothing. If a comparison, copy or allocation
+* throws, the tree is left unchanged.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    Node* path[maxDepth];
+    Node** links[maxDepth];    // links[i] points at path[i], from its parent or root_
+    std::size_t depth = 0;
+    Node** link = &root_;
+    while (*link != nullptr){
+        Node* node = *link;
+        bool less = comp_(key, node->item.first);
+        if (!less && !comp_(node->item.first, key)) break;
+        path[depth] = node;
+        links[depth++] = link;
+        link = less ? &node->left : &node->right;
+    }
+    if (*link == nullptr) return;
+    std::size_t found = depth;
+    Node* victim = *link;
+    path[depth] = victim;
+    links[depth++] = link;
+    if (victim->left != nullptr && victim->right != nullptr){
+        for (link = &victim->right; *link != nullptr; link = &(*link)->left){
+            path[depth] = *link;
+            links[depth++] = link;
+        }
+    }
+
+    // Rebalancing position i may rotate its other child and that child's
+    // children, so they must be held alone too.
+    std::size_t shared = depth;    // first position that must be copied
+    for (std::size_t i = 0; i < depth; ++i){
+        Node* other = i + 1 == depth ? nullptr : path[i]->left == path[i + 1] ? path[i]->right : path[i]->left;
+        if (!heldAlone(path[i]) || !rotatable(other)){
+            shared = i;
+            break;
+        }
+    }
+    if (shared > found && shared < depth) shared = found;
+
+    std::size_t top;
+    if (shared < depth){
+        top = shared;
+        Node* subtree = removeAt(path[top], key);
+        *links[top] = subtree;
+        release(path[top]);
+    } else {
+        top = depth - 1;
+        Node* last = path[top];
+        *links[top] = last->left != nullptr ? last->left : last->right;
+        if (last != victim){
+            last->left = victim->left;
+            last->right = victim->right;
+            last->height = victim->height;
+            *links[found] = last;
+            path[found] = last;
+            if (found + 1 < top) links[found + 1] = &last->right;
+        }
+        destroyNode(victim);
+    }
+    rebalancePath(path, links, top);
+    --size_;
+}
+
+/**
+* Drops this version's items, freeing the nodes no other version holds.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::clear()
+{
+    release(root_);
+    root_ = nullptr;
+    size_ = 0;
+}
+
+/**
+* Checks heights, key order, reference counts and the item count. Meant
+* for tests and debugging.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::isValid() const
+{
+    std::size_t count = 0;
+    return checkSubtree(root_, nullptr, nullptr, count) >= 0 && count == size_;
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Returns the number of items in this version.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t PersistentAVLTree<Key, Value, Compare, Alloc>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns a copy of the comparison object that orders the keys.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Compare PersistentAVLTree<Key, Value, Compare, Alloc>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an iterator to the smallest item in the tree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::begin() const
+{
+    const_iterator it(root_);
+    it.pushLeftmost(root_);
+    return it;
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::end() const
+{
+    return const_iterator(root_);
+}
+
+/**
+* Same as begin().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::cbegin() const
+{
+    return begin();
+}
+
+/**
+* Same as end().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::find(const Key& key) const
+{
+    const_iterator it = lower_bound(key);
+    if (it != end() && comp_(key, it->first)) return end();
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none. The path keeps the whole descent and is then
+* cut back to the bound.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key) const
+{
+    const_iterator it(root_);
+    std::size_t depth = 0;    // path length up to and including the bound
+    for (const Node* current = root_; current != nullptr; ){
+        it.path_[it.depth_++] = current;
+        if (comp_(current->item.first, key)){
+            current = current->right;
+        } else {
+            depth = it.depth_;
+            current = current->left;
+        }
+    }
+    it.depth_ = depth;
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::const_iterator
+PersistentAVLTree<Key, Value, Compare, Alloc>::upper_bound(const Key& key) const
+{
+    const_iterator it(root_);
+    std::size_t depth = 0;
+    for (const Node* current = root_; current != nullptr; ){
+        it.path_[it.depth_++] = current;
+        if (comp_(key, current->item.first)){
+            depth = it.depth_;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+    it.depth_ = depth;
+    return it;
+}
+
+/**
+* Returns the value stored with key, throwing std::out_of_range if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Value const & PersistentAVLTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    const Node* current = root_;
+    while (current != nullptr){
+        if (comp_(key, current->item.first)) current = current->left;
+        else if (comp_(current->item.first, key)) current = current->right;
+        else return current->item.second;
+    }
+    throw std::out_of_range("Invalid key");
+}
+
+/**
+* The height of a subtree, 0 when empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int PersistentAVLTree<Key, Value, Compare, Alloc>::heightOf(const Node* node)
+{
+    return node == nullptr ? 0 : node->height;
+}
+
+/**
+* Recomputes a node's height from its children's.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::updateHeight(Node* node)
+{
+    int left = heightOf(node->left);
+    int right = heightOf(node->right);
+    node->height = static_cast<std::uint8_t>((left > right ? left : right) + 1);
+}
+
+/**
+* Takes one more reference to node, if any, and returns it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::retain(Node* node)
+{
+    if (node != nullptr) node->refs.fetch_add(1, std::memory_order_relaxed);
+    return node;
+}
+
+/**
+* Whether no other tree or node holds node. An empty subtree counts as
+* held alone.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::heldAlone(const Node* node)
+{
+    return node == nullptr || node->refs.load(std::memory_order_acquire) == 1;
+}
+
+/**
+* Whether a rotation could move node and its children, if any, without
+* copying them: all three are held alone.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool PersistentAVLTree<Key, Value, Compare, Alloc>::rotatable(const Node* node)
+{
+    return node == nullptr || (heldAlone(node) && heldAlone(node->left) && heldAlone(node->right));
+}
+
+/**
+* Drops one reference to node, freeing it and releasing its children when
+* it was the last.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::release(Node* node)
+{
+    while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        Node* left = node->left;
+        Node* right = node->right;
+        destroyNode(node);
+        release(left);
+        node = right;
+    }
+}
+
+/**
+* Returns a node held alone with the contents of node, whose reference it
+* takes over: node itself if no one else holds it, or else a copy sharing
+* its children. A copy that throws leaves the caller's reference alone.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::unshare(Node* node)
+{
+    if (node->refs.load(std::memory_order_acquire) == 1) return node;
+    Node* copy = createNode(node->item.first, node->item.second, retain(node->left), retain(node->right), node->height);
+    release(node);
+    return copy;
+}
+
+/**
+* Rotates the right child of node, which is held alone, up into its place
+* and returns it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::rotateLeft(Node* node)
+{
+    Node* pivot = unshare(node->right);
+    node->right = pivot->left;
+    pivot->left = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+/**
+* Rotates the left child of node, which is held alone, up into its place
+* and returns it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::rotateRight(Node* node)
+{
+    Node* pivot = unshare(node->left);
+    node->left = pivot->right;
+    pivot->right = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+/**
+* Restores the AVL condition at node, a node held alone whose subtrees
+* differ in height by at most two, and returns the new subtree root. Takes
+* over the caller's reference, releasing node if it throws. Each unshared
+* child is linked in before the next copy is made, so node is always whole
+* when released. When the nodes a rotation moves are held alone too,
+* nothing is copied and nothing can throw.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::rebalance(Node* node)
+{
+    try {
+        int balance = heightOf(node->right) - heightOf(node->left);
+        if (balance > 1){
+            if (heightOf(node->right->left) > heightOf(node->right->right)){
+                node->right = unshare(node->right);
+                node->right = rotateRight(node->right);
+            }
+            return rotateLeft(node);
+        }
+        if (balance < -1){
+            if (heightOf(node->left->right) > heightOf(node->left->left)){
+                node->left = unshare(node->left);
+                node->left = rotateLeft(node->left);
+            }
+            return rotateRight(node);
+        }
+    } catch (...) {
+        release(node);
+        throw;
+    }
+    updateHeight(node);
+    return node;
+}
+
+/**
+* Rebalances path[top - 1] up to the root in place after the subtree at
+* path[top] changed height, linking each new subtree root through links,
+* and stops once a subtree is as high as before. Every node rebalanced,
+* and every node its rotation moves, must be held alone, so nothing here
+* copies or throws.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::rebalancePath(Node* const* path, Node** const* links, std::size_t top)
+{
+    while (top-- != 0){
+        int height = path[top]->height;
+        Node* subtree = rebalance(path[top]);
+        *links[top] = subtree;
+        if (subtree->height == height) break;
+    }
+}
+
+/**
+* Returns a new subtree root for the subtree at node with the pair
+* inserted, leaving node's subtree as it was. The nodes on the path are
+* copied bottom up, so a throw frees only the copies made so far. Sets
+* added if the key was not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::insertAt(Node* node, const std::pair<const Key, Value>& keyValuePair, bool& added)
+{
+    if (node == nullptr){
+        added = true;
+        return createNode(keyValuePair.first, keyValuePair.second, nullptr, nullptr, 1);
+    }
+    if (comp_(keyValuePair.first, node->item.first)){
+        Node* left = insertAt(node->left, keyValuePair, added);
+        return rebalance(createNode(node->item.first, node->item.second, left, retain(node->right), node->height));
+    }
+    if (comp_(node->item.first, keyValuePair.first)){
+        Node* right = insertAt(node->right, keyValuePair, added);
+        return rebalance(createNode(node->item.first, node->item.second, retain(node->left), right, node->height));
+    }
+    return createNode(node->item.first, keyValuePair.second, retain(node->left), retain(node->right), node->height);
+}
+
+/**
+* Returns a new subtree root for the subtree at node with key, which must
+* be present, removed, leaving node's subtree as it was. A node with two
+* children is replaced by a copy of the smallest item of its right subtree.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::removeAt(Node* node, const Key& key)
+{
+    if (comp_(key, node->item.first)){
+        Node* left = removeAt(node->left, key);
+        return rebalance(createNode(node->item.first, node->item.second, left, retain(node->right), node->height));
+    }
+    if (comp_(node->item.first, key)){
+        Node* right = removeAt(node->right, key);
+        return rebalance(createNode(node->item.first, node->item.second, retain(node->left), right, node->height));
+    }
+    if (node->left == nullptr) return retain(node->right);
+    if (node->right == nullptr) return retain(node->left);
+    const Node* min = node->right;
+    while (min->left != nullptr){
+        min = min->left;
+    }
+    Node* right = removeMin(node->right);
+    return rebalance(createNode(min->item.first, min->item.second, retain(node->left), right, node->height));
+}
+
+/**
+* Returns a new subtree root for the subtree at node without its smallest
+* item, leaving node's subtree as it was.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::removeMin(Node* node)
+{
+    if (node->left == nullptr) return retain(node->right);
+    Node* left = removeMin(node->left);
+    return rebalance(createNode(node->item.first, node->item.second, left, retain(node->right), node->height));
+}
+
+/**
+* Checks the subtree at node, whose keys must lie strictly between low and
+* high where given, adding its size to count. Returns its height, or -1 if
+* anything is wrong.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int PersistentAVLTree<Key, Value, Compare, Alloc>::checkSubtree(const Node* node, const Key* low, const Key* high, std::size_t& count) const
+{
+    if (node == nullptr) return 0;
+    if (node->refs.load(std::memory_order_relaxed) == 0) return -1;
+    if (low != nullptr && !comp_(*low, node->item.first)) return -1;
+    if (high != nullptr && !comp_(node->item.first, *high)) return -1;
+    int left = checkSubtree(node->left, low, &node->item.first, count);
+    if (left < 0) return -1;
+    int right = checkSubtree(node->right, &node->item.first, high, count);
+    if (right < 0 || left - right > 1 || right - left > 1) return -1;
+    int height = (left > right ? left : right) + 1;
+    if (node->height != height) return -1;
+    ++count;
+    return height;
+}
+
+/**
+* Returns a node held once, from the allocator, taking over the caller's
+* references to left and right. If it throws, they are released instead.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename PersistentAVLTree<Key, Value, Compare, Alloc>::Node*
+PersistentAVLTree<Key, Value, Compare, Alloc>::createNode(const Key& key, const Value& value, Node* left, Node* right, int height)
+{
+    void* storage = nullptr;
+    try {
+        storage = alloc_.allocate(sizeof(Node), alignof(Node));
+        return new (storage) Node(key, value, left, right, height);
+    } catch (...) {
+        if (storage != nullptr) alloc_.deallocate(storage, sizeof(Node));
+        release(left);
+        release(right);
+        throw;
+    }
+}
+
+/**
+* Destroys a node's item and returns its storage. The children are left
+* alone.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void PersistentAVLTree<Key, Value, Compare, Alloc>::destroyNode(Node* node)
+{
+    node->~Node();
+    alloc_.deallocate(node, sizeof(Node));
+}
+
+/*
+------------------------------------------------
+End implementations for the PersistentAVLTree::class.
+------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,970 @@
+#ifndef SHARDED_TREE_H
+#define SHARDED_TREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A map of up to N AVLTree shards, each owning a contiguous key range,
+* built for several threads writing at once. An operation locks only the
+* shard its key falls in, so writers to different ranges never meet on
+* one root.
+*
+* Shard i holds the keys from bounds[i - 1] up to, but not including,
+* bounds[i]. Until there is data to split, every key goes to shard 0.
+* When an insert leaves a shard half again larger than the average,
+* rebalance() moves the boundaries so that the shards are even again.
+* Items move only between neighbouring shards, with AVLTree::split and
+* AVLTree::join, so the cost is the number of items moved plus
+* O(N log n). Moved items are copied into a fresh tree before the join,
+* so that no two shards share a NodePool arena under different locks.
+*
+* insert(), remove(), find(key, value) and size() may be called from any
+* number of threads at once. Every operation first takes the routing
+* mutex of its thread's stripe, and rebalance() takes all of them before
+* it moves a boundary, which stops operations while boundaries change.
+* The iterator API, operator[] and the iterator-returning find() and
+* lower_bound() are for phases with no concurrent writer, as with any
+* standard container. The iterator visits the shards in order, so it
+* walks all the items in key order.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = NodePool>
+class ShardedTree
+{
+public:
+    typedef AVLTree<Key, Value, Compare, Alloc> ShardType;
+
+    explicit ShardedTree(std::size_t shards = defaultShards, const Compare& comp = Compare());
+    template<typename Iter>
+    ShardedTree(Iter first, Iter last, std::size_t shards = defaultShards, const Compare& comp = Compare());
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    void clear();
+    void rebalance();
+    bool isValid() const;
+    bool empty() const;
+    std::size_t size() const;
+    std::size_t shardCount() const;
+    std::size_t shardSize(std::size_t shard) const;
+    Compare key_comp() const;
+
+    class const_iterator;
+
+    /**
+    * A bidirectional iterator over every shard in turn: a shard number and
+    * a position in that shard, with end() one past the last shard.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    private:
+        friend class ShardedTree<Key, Value, Compare, Alloc>;
+        friend class const_iterator;
+        iterator(std::size_t shard, typename ShardType::iterator it, ShardedTree<Key, Value, Compare, Alloc>* tree);
+        std::size_t shard_;
+        typename ShardType::iterator it_;
+        ShardedTree<Key, Value, Compare, Alloc>* tree_;
+    };
+
+    /**
+    * The read-only counterpart of iterator, handed out by const trees.
+    * Any iterator converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    private:
+        friend class ShardedTree<Key, Value, Compare, Alloc>;
+        const_iterator(std::size_t shard, typename ShardType::const_iterator it, const ShardedTree<Key, Value, Compare, Alloc>* tree);
+        std::size_t shard_;
+        typename ShardType::const_iterator it_;
+        const ShardedTree<Key, Value, Compare, Alloc>* tree_;
+    };
+
+    iterator begin();
+    const_iterator begin() const;
+    iterator end();
+    const_iterator end() const;
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    /**
+    * The shard count when none is given.
+    */
+    static const std::size_t defaultShards = 16;
+
+private:
+    // Shards hold mutexes, so the container is shared in place, not copied.
+    ShardedTree(const ShardedTree& other);
+    ShardedTree& operator=(const ShardedTree& other);
+
+    /**
+    * One key range: its tree, the lock writers take on it, and its size,
+    * readable without the lock when deciding whether to rebalance.
+    */
+    struct Shard
+    {
+        Shard() : count(0) { }
+
+        std::mutex lock;
+        ShardType tree;
+        std::atomic<std::size_t> count;
+    };
+
+    /**
+    * A routing mutex, padded to its own cache line.
+    */
+    struct Stripe
+    {
+        std::mutex lock;
+        char padding[64 - sizeof(std::mutex) % 64];
+    };
+
+    /**
+    * Routing stripes, and the smallest shard that may trigger a rebalance,
+    * so small trees are not reshuffled on every insert.
+    */
+    static const std::size_t stripeCount = 64;
+    static const std::size_t rebalanceFloor = 1024;
+
+    static std::size_t threadStripe();
+    std::size_t shardFor(const Key& key) const;
+    bool skewed(std::size_t largest, std::size_t total) const;
+    void rebalanceLocked();
+    void moveRight(std::size_t shard, std::size_t count);
+    void moveLeft(std::size_t shard, std::size_t count);
+    void setBound(std::size_t shard, const Key& key);
+    void lockAll();
+    void unlockAll();
+
+    std::unique_ptr<Shard[]> shards_;
+    std::size_t shardCount_;
+    std::vector<Key> bounds_;    // first key of shards 1 .. bounds_.size(); later shards are empty
+    mutable std::unique_ptr<Stripe[]> stripes_;
+    Compare comp_;
+};
+
+/*
+------------------------------------------------------
+Begin implementations for the ShardedTree::iterator class.
+------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for position it in shard, or end() for shard ==
+* shardCount().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::iterator::iterator(std::size_t shard, typename ShardType::iterator it,
+                                                           ShardedTree<Key, Value, Compare, Alloc>* tree) :
+    shard_(shard),
+    it_(it),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::iterator::iterator() :
+    shard_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<const Key, Value>& ShardedTree<Key, Value, Compare, Alloc>::iterator::operator*() const
+{
+    return *it_;
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<const Key, Value>* ShardedTree<Key, Value, Compare, Alloc>::iterator::operator->() const
+{
+    return &*it_;
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::iterator::operator==(const iterator& rhs) const
+{
+    return shard_ == rhs.shard_ && it_ == rhs.it_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the first item of the next
+* non-empty shard at the end of one.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator&
+ShardedTree<Key, Value, Compare, Alloc>::iterator::operator++()
+{
+    ++it_;
+    while (it_ == tree_->shards_[shard_].tree.end()){
+        if (++shard_ == tree_->shardCount_){
+            it_ = typename ShardType::iterator();
+            break;
+        }
+        it_ = tree_->shards_[shard_].tree.begin();
+    }
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves back one item, to the last item of the previous non-empty shard at
+* the start of one. Stepping back from end() gives the largest item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator&
+ShardedTree<Key, Value, Compare, Alloc>::iterator::operator--()
+{
+    if (shard_ < tree_->shardCount_ && it_ != tree_->shards_[shard_].tree.begin()){
+        --it_;
+        return *this;
+    }
+    do {
+        --shard_;
+    } while (tree_->shards_[shard_].tree.empty());
+    it_ = tree_->shards_[shard_].tree.end();
+    --it_;
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+----------------------------------------------------
+End implementations for the ShardedTree::iterator class.
+----------------------------------------------------
+*/
+
+/*
+------------------------------------------------------------
+Begin implementations for the ShardedTree::const_iterator class.
+------------------------------------------------------------
+*/
+
+/**
+* Explicit constructor for position it in shard, or end() for shard ==
+* shardCount().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(std::size_t shard, typename ShardType::const_iterator it,
+                                                                       const ShardedTree<Key, Value, Compare, Alloc>* tree) :
+    shard_(shard),
+    it_(it),
+    tree_(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator() :
+    shard_(0),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Converts an iterator to a const_iterator at the same position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(const iterator& it) :
+    shard_(it.shard_),
+    it_(it.it_),
+    tree_(it.tree_)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>& ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator*() const
+{
+    return *it_;
+}
+
+/**
+* Provides read-only access to the address of the item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>* ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator->() const
+{
+    return &*it_;
+}
+
+/**
+* Checks if 'this' iterator's internals have the same value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return shard_ == rhs.shard_ && it_ == rhs.it_;
+}
+
+/**
+* Checks if 'this' iterator's internals have a different value
+* as 'rhs'
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the first item of the next
+* non-empty shard at the end of one.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator&
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator++()
+{
+    ++it_;
+    while (it_ == tree_->shards_[shard_].tree.end()){
+        if (++shard_ == tree_->shardCount_){
+            it_ = typename ShardType::const_iterator();
+            break;
+        }
+        it_ = tree_->shards_[shard_].tree.begin();
+    }
+    return *this;
+}
+
+/**
+* Post-increment: advances the iterator and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves back one item, to the last item of the previous non-empty shard at
+* the start of one. Stepping back from end() gives the largest item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator&
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator--()
+{
+    if (shard_ < tree_->shardCount_ && it_ != tree_->shards_[shard_].tree.begin()){
+        --it_;
+        return *this;
+    }
+    do {
+        --shard_;
+    } while (tree_->shards_[shard_].tree.empty());
+    it_ = tree_->shards_[shard_].tree.end();
+    --it_;
+    return *this;
+}
+
+/**
+* Post-decrement: moves the iterator back and returns its old position.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+----------------------------------------------------------
+End implementations for the ShardedTree::const_iterator class.
+----------------------------------------------------------
+*/
+
+/*
+--------------------------------------------
+Begin implementations for the ShardedTree class.
+--------------------------------------------
+*/
+
+/**
+* Constructor for an empty map of the given number of shards, at least one,
+* ordered by comp.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+ShardedTree<Key, Value, Compare, Alloc>::ShardedTree(std::size_t shards, const Compare& comp) :
+    shards_(new Shard[shards == 0 ? 1 : shards]),
+    shardCount_(shards == 0 ? 1 : shards),
+    stripes_(new Stripe[stripeCount]),
+    comp_(comp)
+{
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        shards_[i].tree = ShardType(comp);
+    }
+}
+
+/**
+* Constructor from a range of key/value pairs, later duplicates
+* overwriting earlier ones, with the shards evened out afterwards.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename Iter>
+ShardedTree<Key, Value, Compare, Alloc>::ShardedTree(Iter first, Iter last, std::size_t shards, const Compare& comp) :
+    shards_(new Shard[shards == 0 ? 1 : shards]),
+    shardCount_(shards == 0 ? 1 : shards),
+    stripes_(new Stripe[stripeCount]),
+    comp_(comp)
+{
+    shards_[0].tree = ShardType(first, last, comp);
+    shards_[0].count = shards_[0].tree.size();
+    for (std::size_t i = 1; i < shardCount_; ++i){
+        shards_[i].tree = ShardType(comp);
+    }
+    rebalanceLocked();
+}
+
+/**
+* Inserts the pair into its shard, overwriting the value if the key is
+* already present, and rebalances if that shard has grown too large.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::size_t count;
+    {
+        std::lock_guard<std::mutex> route(stripes_[threadStripe()].lock);
+        Shard& shard = shards_[shardFor(keyValuePair.first)];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        shard.tree.insert(keyValuePair);
+        count = shard.tree.size();
+        shard.count.store(count, std::memory_order_relaxed);
+    }
+    // Only every 256th size is checked, to keep the shared counts off the
+    // common path.
+    if (count >= rebalanceFloor && count % 256 == 0 && skewed(count, size())) rebalance();
+}
+
+/**
+* Removes the item with the given key from its shard, if any.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> route(stripes_[threadStripe()].lock);
+    Shard& shard = shards_[shardFor(key)];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.tree.remove(key);
+    shard.count.store(shard.tree.size(), std::memory_order_relaxed);
+}
+
+/**
+* Copies the value stored with key into value and returns true, or
+* returns false if the key is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::find(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> route(stripes_[threadStripe()].lock);
+    Shard& shard = shards_[shardFor(key)];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    typename ShardType::const_iterator it = static_cast<const ShardType&>(shard.tree).find(key);
+    if (it == static_cast<const ShardType&>(shard.tree).end()) return false;
+    value = it->second;
+    return true;
+}
+
+/**
+* Deletes every item. The boundaries are dropped too, so the next items
+* all go to shard 0 until the next rebalance.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::clear()
+{
+    lockAll();
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        shards_[i].tree.clear();
+        shards_[i].count.store(0, std::memory_order_relaxed);
+    }
+    bounds_.clear();
+    unlockAll();
+}
+
+/**
+* Stops every operation and moves the shard boundaries so that the shards
+* hold equal numbers of items, give or take one. Does nothing unless some
+* shard holds at least rebalanceFloor items and half again its share.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::rebalance()
+{
+    lockAll();
+    try {
+        rebalanceLocked();
+    } catch (...) {
+        unlockAll();
+        throw;
+    }
+    unlockAll();
+}
+
+/**
+* Checks every shard and that each holds only keys of its range. Meant for
+* tests and debugging, with no concurrent writer.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::isValid() const
+{
+    for (std::size_t i = 1; i < bounds_.size(); ++i){
+        if (!comp_(bounds_[i - 1], bounds_[i])) return false;
+    }
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        const ShardType& tree = shards_[i].tree;
+        if (!tree.isValid() || tree.size() != shards_[i].count.load()) return false;
+        if (tree.empty()) continue;
+        if (i > bounds_.size()) return false;
+        if (i > 0 && comp_(tree.begin()->first, bounds_[i - 1])) return false;
+        typename ShardType::const_iterator last = tree.end();
+        --last;
+        if (i < bounds_.size() && !comp_(last->first, bounds_[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Returns the number of items, summed over the shards. Under concurrent
+* writes it is only a snapshot of each shard at slightly different times.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ShardedTree<Key, Value, Compare, Alloc>::size() const
+{
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        total += shards_[i].count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+* Returns the number of shards.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ShardedTree<Key, Value, Compare, Alloc>::shardCount() const
+{
+    return shardCount_;
+}
+
+/**
+* Returns the number of items in one shard.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ShardedTree<Key, Value, Compare, Alloc>::shardSize(std::size_t shard) const
+{
+    return shards_[shard].count.load(std::memory_order_relaxed);
+}
+
+/**
+* Returns a copy of the comparison object that orders the keys.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Compare ShardedTree<Key, Value, Compare, Alloc>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::begin()
+{
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        if (!shards_[i].tree.empty()) return iterator(i, shards_[i].tree.begin(), this);
+    }
+    return end();
+}
+
+/**
+* Returns a const_iterator to the smallest item.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::begin() const
+{
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        const ShardType& tree = shards_[i].tree;
+        if (!tree.empty()) return const_iterator(i, tree.begin(), this);
+    }
+    return end();
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::end()
+{
+    return iterator(shardCount_, typename ShardType::iterator(), this);
+}
+
+/**
+* Returns a const_iterator whose value means INVALID
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::end() const
+{
+    return const_iterator(shardCount_, typename ShardType::const_iterator(), this);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::find(const Key& key)
+{
+    std::size_t shard = shardFor(key);
+    typename ShardType::iterator it = shards_[shard].tree.find(key);
+    if (it == shards_[shard].tree.end()) return end();
+    return iterator(shard, it, this);
+}
+
+/**
+* Const overload of find().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::find(const Key& key) const
+{
+    std::size_t shard = shardFor(key);
+    const ShardType& tree = shards_[shard].tree;
+    typename ShardType::const_iterator it = tree.find(key);
+    if (it == tree.end()) return end();
+    return const_iterator(shard, it, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none: in key's shard, or else the first item of a
+* later one.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::iterator
+ShardedTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key)
+{
+    std::size_t shard = shardFor(key);
+    typename ShardType::iterator it = shards_[shard].tree.lower_bound(key);
+    if (it != shards_[shard].tree.end()) return iterator(shard, it, this);
+    for (++shard; shard < shardCount_; ++shard){
+        if (!shards_[shard].tree.empty()) return iterator(shard, shards_[shard].tree.begin(), this);
+    }
+    return end();
+}
+
+/**
+* Const overload of lower_bound().
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+typename ShardedTree<Key, Value, Compare, Alloc>::const_iterator
+ShardedTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key) const
+{
+    std::size_t shard = shardFor(key);
+    const ShardType& tree = shards_[shard].tree;
+    typename ShardType::const_iterator it = tree.lower_bound(key);
+    if (it != tree.end()) return const_iterator(shard, it, this);
+    for (++shard; shard < shardCount_; ++shard){
+        const ShardType& next = shards_[shard].tree;
+        if (!next.empty()) return const_iterator(shard, next.begin(), this);
+    }
+    return end();
+}
+
+/**
+* Returns the value stored with key, throwing std::out_of_range if the key
+* is not present.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Value& ShardedTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    return shards_[shardFor(key)].tree[key];
+}
+
+/**
+* Const overload of operator[].
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Value const & ShardedTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    return static_cast<const ShardType&>(shards_[shardFor(key)].tree)[key];
+}
+
+/**
+* Maps the calling thread to a routing stripe, round robin on first use.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ShardedTree<Key, Value, Compare, Alloc>::threadStripe()
+{
+    static std::atomic<std::size_t> nextStripe(0);
+    static thread_local std::size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % stripeCount;
+    return stripe;
+}
+
+/**
+* The shard whose range holds key: the number of bounds not greater than
+* it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::size_t ShardedTree<Key, Value, Compare, Alloc>::shardFor(const Key& key) const
+{
+    return std::upper_bound(bounds_.begin(), bounds_.end(), key, comp_) - bounds_.begin();
+}
+
+/**
+* Whether a shard of the given size, out of total items, is worth a
+* rebalance.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool ShardedTree<Key, Value, Compare, Alloc>::skewed(std::size_t largest, std::size_t total) const
+{
+    return largest >= rebalanceFloor && 2 * largest * shardCount_ > 3 * total;
+}
+
+/**
+* rebalance() with every routing stripe held, or before the tree is
+* shared. The boundary between shards i and i + 1 has to carry the
+* difference between the items now left of it and the items that should
+* be. The rightward flows run left to right and then the leftward ones run
+* right to left, so every shard holds enough items whenever it gives some
+* up.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::rebalanceLocked()
+{
+    std::size_t total = 0;
+    std::size_t largest = 0;
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        std::size_t count = shards_[i].tree.size();
+        total += count;
+        if (count > largest) largest = count;
+    }
+    if (!skewed(largest, total) || total < shardCount_) return;
+    // flow[i] > 0 moves items from shard i to shard i + 1, < 0 the other way.
+    std::vector<long long> flow(shardCount_ - 1);
+    std::size_t prefix = 0;
+    for (std::size_t i = 0; i + 1 < shardCount_; ++i){
+        prefix += shards_[i].tree.size();
+        std::size_t target = total * (i + 1) / shardCount_;
+        flow[i] = static_cast<long long>(prefix) - static_cast<long long>(target);
+    }
+    for (std::size_t i = 0; i + 1 < shardCount_; ++i){
+        if (flow[i] > 0) moveRight(i, static_cast<std::size_t>(flow[i]));
+    }
+    for (std::size_t i = shardCount_ - 1; i-- > 0; ){
+        if (flow[i] < 0) moveLeft(i, static_cast<std::size_t>(-flow[i]));
+    }
+    for (std::size_t i = 0; i < shardCount_; ++i){
+        shards_[i].count.store(shards_[i].tree.size(), std::memory_order_relaxed);
+    }
+}
+
+/**
+* Moves the largest count items of shard into the next shard and sets the
+* boundary between them to the smallest key moved.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::moveRight(std::size_t shard, std::size_t count)
+{
+    ShardType& from = shards_[shard].tree;
+    ShardType& to = shards_[shard + 1].tree;
+    Key bound = from.select(from.size() - count)->first;
+    ShardType moved(comp_);
+    {
+        // The split-off tree shares from's arena, so copy its items into a
+        // tree of their own before they join another shard.
+        ShardType tail(comp_);
+        from.split(bound, tail);
+        moved.assign(tail.begin(), tail.end());
+    }
+    moved.join(to);
+    to.swap(moved);
+    setBound(shard, bound);
+}
+
+/**
+* Moves the smallest count items of the shard after shard into it, which
+* must leave that shard at least one item, and sets the boundary between
+* them to the smallest key left behind.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::moveLeft(std::size_t shard, std::size_t count)
+{
+    ShardType& to = shards_[shard].tree;
+    ShardType& from = shards_[shard + 1].tree;
+    Key bound = from.select(count)->first;
+    ShardType moved(comp_);
+    {
+        ShardType rest(comp_);
+        from.split(bound, rest);
+        moved.assign(from.begin(), from.end());
+        from.swap(rest);
+    }
+    to.join(moved);
+    setBound(shard, bound);
+}
+
+/**
+* Sets the boundary after shard, adding it if shard is the last one with
+* a boundary so far.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::setBound(std::size_t shard, const Key& key)
+{
+    if (shard < bounds_.size()) bounds_[shard] = key;
+    else bounds_.push_back(key);
+}
+
+/**
+* Takes every routing stripe, in order so that two callers cannot deadlock.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::lockAll()
+{
+    for (std::size_t i = 0; i < stripeCount; ++i){
+        stripes_[i].lock.lock();
+    }
+}
+
+/**
+* Releases every routing stripe.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void ShardedTree<Key, Value, Compare, Alloc>::unlockAll()
+{
+    for (std::size_t i = stripeCount; i-- > 0; ){
+        stripes_[i].lock.unlock();
+    }
+}
+
+/*
+------------------------------------------
+End implementations for the ShardedTree class.
+------------------------------------------
+*/
+
+#endif
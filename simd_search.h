@@ -0,0 +1,380 @@
+#ifndef SIMD_SEARCH_H
+#define SIMD_SEARCH_H
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+* Search kernels for FrozenTree snapshots of integer keys. The keys are
+* cut into blocks of one 64-byte cache line each (8 keys of 64 bits or 16
+* of 32) and stacked into an implicit B+ tree: the sorted keys themselves
+* form the bottom layer, and block k of every layer above has its children
+* at blocks k * (width + 1) through k * (width + 1) + width of the layer
+* below. At every level a search counts how many keys of one block are
+* less than the key, which picks the child, and in the bottom layer gives
+* the rank of the lower bound directly.
+*
+* Counting is done a whole block at a time with AVX2 or SSE2 compares when
+* the processor has them, and with a plain loop otherwise. The choice is
+* made once at run time and can be narrowed with setBlockSearchIsa() to
+* compare the kernels.
+*/
+
+/**
+* True for the key types the kernels handle: 32- and 64-bit integers in
+* their natural order.
+*/
+template<typename Key, typename Compare>
+struct BlockSearchable : std::integral_constant<bool,
+    std::is_integral<Key>::value && !std::is_same<Key, bool>::value
+    && (sizeof(Key) == 4 || sizeof(Key) == 8)
+    && std::is_same<Compare, std::less<Key> >::value>
+{
+};
+
+/**
+* The instruction sets a kernel can be written for, weakest first.
+*/
+enum BlockSearchIsa
+{
+    blockSearchPortable,
+    blockSearchSse2,
+    blockSearchAvx2
+};
+
+/**
+* How many searches a kernel advances in lockstep, so that the cache
+* misses of one overlap the work of the others.
+*/
+static const std::size_t blockSearchGroup = 8;
+
+/**
+* The most capable instruction set the processor supports.
+*/
+inline BlockSearchIsa detectBlockSearchIsa()
+{
+#if defined(SIMD_SEARCH_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return blockSearchAvx2;
+    if (__builtin_cpu_supports("sse2")) return blockSearchSse2;
+#endif
+    return blockSearchPortable;
+}
+
+/**
+* The instruction set the kernels currently use.
+*/
+inline BlockSearchIsa& blockSearchIsaSetting()
+{
+    static BlockSearchIsa isa = detectBlockSearchIsa();
+    return isa;
+}
+
+inline BlockSearchIsa blockSearchIsa()
+{
+    return blockSearchIsaSetting();
+}
+
+/**
+* Restricts the kernels to the given instruction set, or to the best one
+* available if the processor lacks it. Returns the one now in use.
+*/
+inline BlockSearchIsa setBlockSearchIsa(BlockSearchIsa isa)
+{
+    BlockSearchIsa best = detectBlockSearchIsa();
+    blockSearchIsaSetting() = isa < best ? isa : best;
+    return blockSearchIsaSetting();
+}
+
+/**
+* Runs count searches through the blocks in portable C++: layer h of the
+* depth layers above the bottom one starts at index + offsets[h], and the
+* bottom layer is leaves. Each rank written is the number of keys less
+* than the corresponding key.
+*/
+template<typename Key>
+void blockSearchPortableKernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves,
+                               const Key* keys, std::size_t count, std::size_t* ranks)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    for (std::size_t base = 0; base < count; base += blockSearchGroup){
+        std::size_t group = count - base < blockSearchGroup ? count - base : blockSearchGroup;
+        std::size_t* block = ranks + base;    // each search's block in the current layer
+        for (int h = 0; h <= depth; ++h){
+            const Key* layer = h < depth ? index + offsets[h] : leaves;
+            for (std::size_t j = 0; j < group; ++j){
+                std::size_t current = h == 0 ? 0 : block[j];
+                const Key* keysInBlock = layer + current * width;
+                std::size_t less = 0;
+                for (std::size_t i = 0; i < width; ++i){
+                    less += keysInBlock[i] < keys[base + j] ? 1 : 0;
+                }
+                block[j] = h < depth ? current * (width + 1) + less : current * width + less;
+            }
+        }
+    }
+}
+
+/**
+* Returns the number of keys less than key, descending the blocks alone;
+* see blockSearchPortableKernel for the arguments. A single search gains
+* nothing from the group bookkeeping, so each kernel has a plain form too.
+*/
+template<typename Key>
+std::size_t blockRankPortableKernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves, Key key)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    std::size_t block = 0;
+    for (int h = 0; h <= depth; ++h){
+        const Key* keysInBlock = (h < depth ? index + offsets[h] : leaves) + block * width;
+        std::size_t less = 0;
+        for (std::size_t i = 0; i < width; ++i){
+            less += keysInBlock[i] < key ? 1 : 0;
+        }
+        block = h < depth ? block * (width + 1) + less : block * width + less;
+    }
+    return block;
+}
+
+#if defined(SIMD_SEARCH_X86)
+
+/**
+* The SSE2 and AVX2 kernels compare signed lanes, so unsigned keys have
+* their top bit flipped on the way in, which maps their order onto the
+* signed one. The mask fills a 64-bit lane either way.
+*/
+template<typename Key>
+long long blockSearchFlip()
+{
+    if (std::is_signed<Key>::value) return 0;
+    return static_cast<long long>(sizeof(Key) == 8 ? 0x8000000000000000ULL : 0x8000000080000000ULL);
+}
+
+/**
+* Counts the lanes of a 64-bit block (already in signed order, as x is)
+* that are less than x.
+*/
+__attribute__((target("avx2")))
+inline std::size_t countLessAvx2(const void* block, __m256i x, __m256i flip, std::integral_constant<std::size_t, 8>)
+{
+    const __m256i* lanes = static_cast<const __m256i*>(block);
+    __m256i low = _mm256_xor_si256(_mm256_loadu_si256(lanes), flip);
+    __m256i high = _mm256_xor_si256(_mm256_loadu_si256(lanes + 1), flip);
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, low)))
+        | _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, high))) << 4;
+    return __builtin_ctz(~mask);
+}
+
+/**
+* As above for a block of sixteen 32-bit keys.
+*/
+__attribute__((target("avx2")))
+inline std::size_t countLessAvx2(const void* block, __m256i x, __m256i flip, std::integral_constant<std::size_t, 4>)
+{
+    const __m256i* lanes = static_cast<const __m256i*>(block);
+    __m256i low = _mm256_xor_si256(_mm256_loadu_si256(lanes), flip);
+    __m256i high = _mm256_xor_si256(_mm256_loadu_si256(lanes + 1), flip);
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, low)))
+        | _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, high))) << 8;
+    return __builtin_ctz(~mask);
+}
+
+/**
+* blockSearchPortableKernel with AVX2 block counts and a prefetch of every
+* block the group will read next.
+*/
+template<typename Key>
+__attribute__((target("avx2")))
+void blockSearchAvx2Kernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves,
+                           const Key* keys, std::size_t count, std::size_t* ranks)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    const std::integral_constant<std::size_t, sizeof(Key)> keySize;
+    const __m256i flip = _mm256_set1_epi64x(blockSearchFlip<Key>());
+    for (std::size_t base = 0; base < count; base += blockSearchGroup){
+        std::size_t group = count - base < blockSearchGroup ? count - base : blockSearchGroup;
+        std::size_t* block = ranks + base;    // each search's block in the current layer
+        __m256i x[blockSearchGroup];
+        for (std::size_t j = 0; j < group; ++j){
+            x[j] = _mm256_xor_si256(sizeof(Key) == 8 ? _mm256_set1_epi64x(keys[base + j])
+                                                     : _mm256_set1_epi32(keys[base + j]), flip);
+        }
+        for (int h = 0; h <= depth; ++h){
+            const Key* layer = h < depth ? index + offsets[h] : leaves;
+            const Key* below = h + 1 < depth ? index + offsets[h + 1] : leaves;
+            for (std::size_t j = 0; j < group; ++j){
+                std::size_t current = h == 0 ? 0 : block[j];
+                std::size_t less = countLessAvx2(layer + current * width, x[j], flip, keySize);
+                if (h < depth){
+                    block[j] = current * (width + 1) + less;
+                    _mm_prefetch(reinterpret_cast<const char*>(below + block[j] * width), _MM_HINT_T0);
+                } else {
+                    block[j] = current * width + less;
+                }
+            }
+        }
+    }
+}
+
+/**
+* blockRankPortableKernel with AVX2 block counts.
+*/
+template<typename Key>
+__attribute__((target("avx2")))
+std::size_t blockRankAvx2Kernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves, Key key)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    const std::integral_constant<std::size_t, sizeof(Key)> keySize;
+    const __m256i flip = _mm256_set1_epi64x(blockSearchFlip<Key>());
+    const __m256i x = _mm256_xor_si256(sizeof(Key) == 8 ? _mm256_set1_epi64x(key) : _mm256_set1_epi32(key), flip);
+    std::size_t block = 0;
+    for (int h = 0; h < depth; ++h){
+        block = block * (width + 1) + countLessAvx2(index + offsets[h] + block * width, x, flip, keySize);
+    }
+    return block * width + countLessAvx2(leaves + block * width, x, flip, keySize);
+}
+
+/**
+* Counts the lanes of a 64-bit block that are less than x with SSE2, which
+* has no 64-bit compare: a lane is less when its high half is less, or the
+* high halves are equal and its low half is less as an unsigned number.
+*/
+__attribute__((target("sse2")))
+inline std::size_t countLessSse2(const void* block, __m128i x, __m128i flip, std::integral_constant<std::size_t, 8>)
+{
+    const __m128i* lanes = static_cast<const __m128i*>(block);
+    const __m128i lowFlip = _mm_set1_epi32(static_cast<int>(0x80000000U));
+    __m128i xLow = _mm_xor_si128(x, lowFlip);
+    int mask = 0;
+    for (int i = 0; i < 4; ++i){
+        __m128i lane = _mm_xor_si128(_mm_loadu_si128(lanes + i), flip);
+        __m128i greater = _mm_cmpgt_epi32(x, lane);
+        __m128i equal = _mm_cmpeq_epi32(x, lane);
+        __m128i lowGreater = _mm_shuffle_epi32(_mm_cmpgt_epi32(xLow, _mm_xor_si128(lane, lowFlip)), _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i less = _mm_or_si128(greater, _mm_and_si128(equal, lowGreater));
+        mask |= _mm_movemask_pd(_mm_castsi128_pd(less)) << (2 * i);
+    }
+    return __builtin_ctz(~mask);
+}
+
+/**
+* As above for a block of sixteen 32-bit keys.
+*/
+__attribute__((target("sse2")))
+inline std::size_t countLessSse2(const void* block, __m128i x, __m128i flip, std::integral_constant<std::size_t, 4>)
+{
+    const __m128i* lanes = static_cast<const __m128i*>(block);
+    int mask = 0;
+    for (int i = 0; i < 4; ++i){
+        __m128i lane = _mm_xor_si128(_mm_loadu_si128(lanes + i), flip);
+        mask |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, lane))) << (4 * i);
+    }
+    return __builtin_ctz(~mask);
+}
+
+/**
+* blockSearchAvx2Kernel with SSE2 block counts.
+*/
+template<typename Key>
+__attribute__((target("sse2")))
+void blockSearchSse2Kernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves,
+                           const Key* keys, std::size_t count, std::size_t* ranks)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    const std::integral_constant<std::size_t, sizeof(Key)> keySize;
+    const __m128i flip = _mm_set1_epi64x(blockSearchFlip<Key>());
+    for (std::size_t base = 0; base < count; base += blockSearchGroup){
+        std::size_t group = count - base < blockSearchGroup ? count - base : blockSearchGroup;
+        std::size_t* block = ranks + base;    // each search's block in the current layer
+        __m128i x[blockSearchGroup];
+        for (std::size_t j = 0; j < group; ++j){
+            x[j] = _mm_xor_si128(sizeof(Key) == 8 ? _mm_set1_epi64x(keys[base + j])
+                                                  : _mm_set1_epi32(keys[base + j]), flip);
+        }
+        for (int h = 0; h <= depth; ++h){
+            const Key* layer = h < depth ? index + offsets[h] : leaves;
+            const Key* below = h + 1 < depth ? index + offsets[h + 1] : leaves;
+            for (std::size_t j = 0; j < group; ++j){
+                std::size_t current = h == 0 ? 0 : block[j];
+                std::size_t less = countLessSse2(layer + current * width, x[j], flip, keySize);
+                if (h < depth){
+                    block[j] = current * (width + 1) + less;
+                    _mm_prefetch(reinterpret_cast<const char*>(below + block[j] * width), _MM_HINT_T0);
+                } else {
+                    block[j] = current * width + less;
+                }
+            }
+        }
+    }
+}
+
+/**
+* blockRankPortableKernel with SSE2 block counts.
+*/
+template<typename Key>
+__attribute__((target("sse2")))
+std::size_t blockRankSse2Kernel(const Key* index, const std::size_t* offsets, int depth, const Key* leaves, Key key)
+{
+    const std::size_t width = 64 / sizeof(Key);
+    const std::integral_constant<std::size_t, sizeof(Key)> keySize;
+    const __m128i flip = _mm_set1_epi64x(blockSearchFlip<Key>());
+    const __m128i x = _mm_xor_si128(sizeof(Key) == 8 ? _mm_set1_epi64x(key) : _mm_set1_epi32(key), flip);
+    std::size_t block = 0;
+    for (int h = 0; h < depth; ++h){
+        block = block * (width + 1) + countLessSse2(index + offsets[h] + block * width, x, flip, keySize);
+    }
+    return block * width + countLessSse2(leaves + block * width, x, flip, keySize);
+}
+
+#endif
+
+/**
+* Returns the number of keys less than key with the best kernel allowed;
+* see blockSearchPortableKernel for the arguments.
+*/
+template<typename Key>
+std::size_t blockRank(const Key* index, const std::size_t* offsets, int depth, const Key* leaves, Key key)
+{
+#if defined(SIMD_SEARCH_X86)
+    switch (blockSearchIsa()){
+    case blockSearchAvx2:
+        return blockRankAvx2Kernel(index, offsets, depth, leaves, key);
+    case blockSearchSse2:
+        return blockRankSse2Kernel(index, offsets, depth, leaves, key);
+    default:
+        break;
+    }
+#endif
+    return blockRankPortableKernel(index, offsets, depth, leaves, key);
+}
+
+/**
+* Runs count searches through the blocks with the best kernel allowed;
+* see blockSearchPortableKernel for the arguments.
+*/
+template<typename Key>
+void blockSearch(const Key* index, const std::size_t* offsets, int depth, const Key* leaves,
+                 const Key* keys, std::size_t count, std::size_t* ranks)
+{
+#if defined(SIMD_SEARCH_X86)
+    switch (blockSearchIsa()){
+    case blockSearchAvx2:
+        blockSearchAvx2Kernel(index, offsets, depth, leaves, keys, count, ranks);
+        return;
+    case blockSearchSse2:
+        blockSearchSse2Kernel(index, offsets, depth, leaves, keys, count, ranks);
+        return;
+    default:
+        break;
+    }
+#endif
+    blockSearchPortableKernel(index, offsets, depth, leaves, keys, count, ranks);
+}
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+* A fork-join thread pool for the trees' parallel operations
+* (AVLTree::parallel_assign, parallel_for_each, parallel_reduce).
+*
+* invoke(f, g) runs f on the calling thread and offers g to the pool: g goes
+* on the back of the caller's deque, an idle thread steals it from the front,
+* and if nobody has by the time f returns the caller runs g itself. A caller
+* waiting for a stolen g runs stolen work of its own meanwhile, so nested
+* invokes never leave a thread blocked while tasks are queued. Recursive
+* divide-and-conquer therefore spreads the largest pieces first, since the
+* oldest, biggest task sits at the front of each deque.
+*
+* A pool of n threads starts n - 1 workers and counts the calling thread
+* as the nth. A pool of one thread runs everything serially. Threads outside
+* the pool share one deque, so several of them may use the pool at once.
+*/
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    template<typename F, typename G>
+    void invoke(F&& f, G&& g);
+    unsigned size() const;
+
+private:
+    // A pool owns its threads, so it cannot be copied.
+    WorkStealingPool(const WorkStealingPool& other);
+    WorkStealingPool& operator=(const WorkStealingPool& other);
+
+    /**
+    * One offered call, living on the stack of the invoke() that made it.
+    */
+    struct Task
+    {
+        Task(void (*call)(void*), void* body) : call(call), body(body), done(false) { }
+
+        void (*call)(void*);
+        void* body;
+        std::atomic<bool> done;
+        std::exception_ptr error;
+    };
+
+    /**
+    * A thread's deque: the owner pushes and takes at the back, thieves
+    * take from the front.
+    */
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task*> tasks;
+    };
+
+    template<typename Body>
+    static void callBody(void* body);
+    static WorkStealingPool*& currentPool();
+    static std::size_t& currentQueue();
+
+    std::size_t ownQueue() const;
+    void push(std::size_t queue, Task* task);
+    bool take(std::size_t queue, Task* task);
+    Task* steal(std::size_t from);
+    void execute(Task* task);
+    void wait(std::size_t queue, Task& task);
+    void workerLoop(std::size_t queue);
+
+    std::vector<std::unique_ptr<Queue> > queues_;    // one per worker, then one for outside threads
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> queued_;
+    std::atomic<std::size_t> sleepers_;
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the WorkStealingPool class.
+  ----------------------------------------------------
+*/
+
+/**
+* Constructor, which starts threads - 1 workers. A count of 0, as
+* hardware_concurrency() may report, is taken as 1.
+*/
+inline WorkStealingPool::WorkStealingPool(unsigned threads) :
+    queued_(0),
+    sleepers_(0),
+    stopping_(false)
+{
+    std::size_t workers = threads > 1 ? threads - 1 : 0;
+    for (std::size_t i = 0; i <= workers; ++i){
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (std::size_t i = 0; i < workers; ++i){
+        threads_.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+/**
+* Destructor, which stops and joins the workers. No invoke() may still be
+* running.
+*/
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::size_t i = 0; i < threads_.size(); ++i){
+        threads_[i].join();
+    }
+}
+
+/**
+* Runs f() and g(), possibly in parallel, and returns once both have
+* finished. If either throws, the exception is rethrown here after both
+* are done, f's first.
+*/
+template<typename F, typename G>
+void WorkStealingPool::invoke(F&& f, G&& g)
+{
+    if (threads_.empty()){
+        f();
+        g();
+        return;
+    }
+    typedef typename std::remove_reference<G>::type Body;
+    Task task(&callBody<Body>, const_cast<void*>(static_cast<const void*>(std::addressof(g))));
+    std::size_t queue = ownQueue();
+    push(queue, &task);
+    std::exception_ptr error;
+    try {
+        f();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (take(queue, &task)) execute(&task);
+    else wait(queue, task);
+    if (error) std::rethrow_exception(error);
+    if (task.error) std::rethrow_exception(task.error);
+}
+
+/**
+* Returns the number of threads the pool runs work on, the caller's included.
+*/
+inline unsigned WorkStealingPool::size() const
+{
+    return static_cast<unsigned>(threads_.size() + 1);
+}
+
+/**
+* Calls the body of an offered task.
+*/
+template<typename Body>
+void WorkStealingPool::callBody(void* body)
+{
+    (*static_cast<Body*>(body))();
+}
+
+/**
+* The pool the calling thread works for, if any.
+*/
+inline WorkStealingPool*& WorkStealingPool::currentPool()
+{
+    static thread_local WorkStealingPool* pool = nullptr;
+    return pool;
+}
+
+/**
+* The deque of the calling worker thread, meaningful when currentPool() is set.
+*/
+inline std::size_t& WorkStealingPool::currentQueue()
+{
+    static thread_local std::size_t queue = 0;
+    return queue;
+}
+
+/**
+* Returns the deque the calling thread pushes to: its own for a worker of
+* this pool, else the one outside threads share.
+*/
+inline std::size_t WorkStealingPool::ownQueue() const
+{
+    return currentPool() == this ? currentQueue() : queues_.size() - 1;
+}
+
+/**
+* Offers a task on the back of a deque and wakes a worker if any sleep.
+* queued_ and sleepers_ are both sequentially consistent, so either this
+* thread sees the sleeper or the sleeper sees the task.
+*/
+inline void WorkStealingPool::push(std::size_t queue, Task* task)
+{
+    queued_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> guard(queues_[queue]->lock);
+        queues_[queue]->tasks.push_back(task);
+    }
+    if (sleepers_.load() != 0){
+        std::lock_guard<std::mutex> guard(sleepLock_);
+        wake_.notify_one();
+    }
+}
+
+/**
+* Takes the given task back off a deque if it is still there. It is
+* normally at the back, but outside threads share their deque, so the
+* search goes on from there.
+*/
+inline bool WorkStealingPool::take(std::size_t queue, Task* task)
+{
+    std::lock_guard<std::mutex> guard(queues_[queue]->lock);
+    std::deque<Task*>& tasks = queues_[queue]->tasks;
+    for (std::size_t i = tasks.size(); i-- != 0; ){
+        if (tasks[i] == task){
+            tasks.erase(tasks.begin() + i);
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Takes the oldest task from the first non-empty deque, looking at from
+* first and then at the others in turn. Returns nullptr if all are empty.
+*/
+inline WorkStealingPool::Task* WorkStealingPool::steal(std::size_t from)
+{
+    for (std::size_t i = 0; i < queues_.size(); ++i){
+        Queue& queue = *queues_[(from + i) % queues_.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.tasks.empty()){
+            Task* task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+/**
+* Runs a task, keeping any exception for its invoke(), and marks it done.
+*/
+inline void WorkStealingPool::execute(Task* task)
+{
+    try {
+        task->call(task->body);
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    task->done.store(true, std::memory_order_release);
+}
+
+/**
+* Waits for a stolen task to finish, running other queued work meanwhile.
+*/
+inline void WorkStealingPool::wait(std::size_t queue, Task& task)
+{
+    while (!task.done.load(std::memory_order_acquire)){
+        Task* other = steal(queue + 1);
+        if (other != nullptr) execute(other);
+        else std::this_thread::yield();
+    }
+}
+
+/**
+* The body of a worker thread: steal the oldest task of any deque, else
+* sleep until a push or the destructor wakes it. Between tasks a worker's
+* own deque is empty, since only invokes running on it push there.
+*/
+inline void WorkStealingPool::workerLoop(std::size_t queue)
+{
+    currentPool() = this;
+    currentQueue() = queue;
+    while (true){
+        Task* task = steal(queue + 1);
+        if (task != nullptr){
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock_);
+        if (stopping_) return;
+        sleepers_.fetch_add(1);
+        if (queued_.load() == 0) wake_.wait(guard);
+        sleepers_.fetch_sub(1);
+    }
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the WorkStealingPool class.
+  --------------------------------------------------
+*/
+
+#endif